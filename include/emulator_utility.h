@@ -1,11 +1,105 @@
+#ifndef EMULATOR_UTILITY_H_INCLUDED
+#define EMULATOR_UTILITY_H_INCLUDED
+
+#include <cstddef>
 #include <cstdint>
 
+/*ROM image file formats*/
+enum rom_format_t
+{
+    ROM_FORMAT_AUTO,    /* Guess from the file name, then from the contents */
+    ROM_FORMAT_RAW,     /* Binary dump loaded at the given address */
+    ROM_FORMAT_IHEX,    /* Intel HEX */
+    ROM_FORMAT_SREC,    /* Motorola S-record */
+    ROM_FORMAT_PRG,     /* Commodore PRG, load address in the first two bytes */
+};
+
+/*Loader errors*/
+enum rom_error_t
+{
+    ROM_OK,
+    ROM_ERROR_OPEN,     /* File cannot be opened or mapped */
+    ROM_ERROR_FORMAT,   /* Malformed record or header */
+    ROM_ERROR_CHECKSUM, /* Record checksum mismatch */
+    ROM_ERROR_RANGE,    /* Data outside the memory space */
+};
+
+/*Why and where loading failed*/
+typedef struct
+{
+    rom_error_t error;
+    unsigned int line;          /* Line of the faulty record, 0 if not line based */
+    char message[160];          /* Human readable description, with file name and line */
+} rom_status_t;
+
+/*What an image put in memory*/
+typedef struct
+{
+    rom_format_t format;        /* Format actually parsed */
+    uint32_t bytes;             /* Data bytes written */
+    uint16_t lowest;            /* Lowest address written */
+    uint16_t highest;           /* Highest address written */
+    uint8_t has_start;          /* Image gives a start address */
+    uint16_t start;             /* Start address */
+} rom_info_t;
+
+/*Image file mapped read-only. Opening the same file again shares the
+  mapping, so instances loading the same ROM read it once*/
+typedef struct rom_image_s
+{
+    const uint8_t* data;        /* File contents */
+    size_t size;                /* File size in bytes */
+    char* filename;             /* File name, for messages */
+    uint64_t device;            /* File identity */
+    uint64_t inode;
+    int64_t modified;
+    unsigned int refs;          /* Openers still using the mapping */
+    uint8_t mapped;             /* data is a mapping, not a heap copy */
+    struct rom_image_s* next;   /* Open images */
+} rom_image_t;
+
+/**
+ * @brief Open an image file read-only. Thread safe.
+ * @param filename Image file name
+ * @param status Error description, may be NULL
+ * @returns Image to release with rom_image_close(), NULL on error
+ */
+rom_image_t* rom_image_open(const char* filename, rom_status_t* status);
+
+/**
+ * @brief Release an image. The mapping goes away with its last user.
+ *        Raw images mapped as ROM with Z6502::map_memory() must stay open.
+ * @param image Image, may be NULL
+ */
+void rom_image_close(rom_image_t* image);
+
+/**
+ * @brief Parse an image into a memory space in a single pass
+ * @param image Image
+ * @param format Image format, ROM_FORMAT_AUTO to detect it
+ * @param load_address Address of raw images, ignored by formats carrying their own addresses
+ * @param memory_ptr Memory space to load into
+ * @param memory_size Memory space size
+ * @param info What the image put in memory, may be NULL
+ * @param status Error description, may be NULL
+ * @returns Number of bytes loaded. -1 if error
+ */
+int rom_image_load(const rom_image_t* image, rom_format_t format, uint16_t load_address,
+                   uint8_t* memory_ptr, uint32_t memory_size, rom_info_t* info, rom_status_t* status);
+
 /**
- * @brief Load memory from dumpfile
- * @param filename Dumpfile file name
- * @param address Memory start address
- * @param memory_ptr Load target
- * @param memory_size Max memory size
+ * @brief Open, load and close an image file, see rom_image_load()
  * @returns Number of bytes loaded. -1 if error
  */
-int memory_load(char* filename, uint16_t start_address, uint8_t* memory_ptr, uint16_t memory_size);
\ No newline at end of file
+int rom_load(const char* filename, rom_format_t format, uint16_t load_address,
+             uint8_t* memory_ptr, uint32_t memory_size, rom_info_t* info, rom_status_t* status);
+
+/**
+ * @brief Parse a format name (auto, raw, ihex, srec or prg)
+ * @param name Format name
+ * @param format Parsed format
+ * @returns 0 on success, -1 if the name is unknown
+ */
+int rom_parse_format(const char* name, rom_format_t* format);
+
+#endif // EMULATOR_UTILITY_H_INCLUDED
\ No newline at end of file
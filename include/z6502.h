@@ -17,16 +17,55 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstdio>
 
 #define Z6502_MAX_MEMORY_SIZE_BYTES 65536U
+#define Z6502_PAGE_SIZE_BYTES 256U
+#define Z6502_PAGE_COUNT 256U
+
+/*Value read from pages mapped to nothing*/
+#define Z6502_OPEN_BUS_VALUE 0xFFU
 
 #define FALSE 0U
 #define TRUE 1U
 
 #define Z6502_STACK_BASE_ADDRESS 0x0100U
+#define Z6502_NMI_VECTOR_ADDRESS 0xFFFAU
 #define Z6502_RESET_VECTOR_ADDRESS 0xFFFCU
 #define Z6502_IRQ_VECTOR_ADDRESS 0xFFFEU
 
+/*Clock cycles taken to enter an IRQ or NMI handler*/
+#define Z6502_INTERRUPT_CYCLES 7U
+
+/*Events pending at once on one Z6502, see Z6502::schedule_event()*/
+#define Z6502_MAX_EVENTS 64U
+
+/*IRQ lines, see Z6502::assert_irq()*/
+#define Z6502_IRQ_LINES 32U
+
+/*Cycles run between two idle loop checks, see Z6502::set_idle_skip(). The
+  interval doubles after each failed check and restarts from the minimum
+  once an idle loop was skipped*/
+#define Z6502_IDLE_CHECK_MIN_CYCLES 64U
+#define Z6502_IDLE_CHECK_MAX_CYCLES 65536U
+
+/*Longest idle loop recognized, in instructions*/
+#define Z6502_IDLE_MAX_INSTRUCTIONS 8U
+
+/*Watchpoint accesses, see Z6502::set_watchpoint()*/
+#define Z6502_WATCH_READ 0x01U
+#define Z6502_WATCH_WRITE 0x02U
+
+/*Code map, one byte of flags per address, built by the disassembler (see
+  z6502_disasm.h) and used by Z6502::prewarm()*/
+#define Z6502_CODE_INSTRUCTION 0x01U    /* First byte of an instruction */
+#define Z6502_CODE_OPERAND 0x02U        /* Operand byte of an instruction */
+#define Z6502_CODE_BLOCK 0x04U          /* First instruction of a basic block */
+#define Z6502_CODE_TARGET 0x08U         /* Target of a branch, jump or call */
+#define Z6502_CODE_ENTRY 0x10U          /* Entry point: interrupt vector or given address */
+#define Z6502_CODE_DATA 0x20U           /* Data referenced by an operand, pointer or vector */
+#define Z6502_CODE_INVALID 0x40U        /* Code flow reaches an unhandled opcode or a byte decoded otherwise */
+
 /*Status indicator flags structure*/
 typedef struct
 {
@@ -50,6 +89,170 @@ typedef struct
     flag_t processor_status;
 } register_set_t;
 
+/*Processor status as kept by the interpreter. N and Z are evaluated
+  lazily from the last result bytes, see Z6502::dump_register()*/
+typedef struct
+{
+    uint8_t carry;
+    uint8_t irq_disable;
+    uint8_t decimal_mode;
+    uint8_t overflow;
+    uint8_t zero_result;        /* Z is set when this byte is 0 */
+    uint8_t negative_result;    /* N is bit 7 of this byte */
+} status_t;
+
+/*Register set as kept by the interpreter*/
+typedef struct
+{
+    uint16_t program_counter;
+    uint16_t stack_pointer;
+    uint8_t accumulator;
+    uint8_t x;
+    uint8_t y;
+    status_t processor_status;
+} cpu_state_t;
+
+struct memory_s;
+struct jit_s;
+struct replay_s;
+struct debug_s;
+struct snapshot_page_s;
+class Z6502;
+class Z6502Tracer;
+class Z6502Profiler;
+class Z6502Replay;
+class Z6502Fuzzer;
+
+/*Handler for a predecoded instruction*/
+typedef void (*decoded_handler_t)(struct memory_s* mem, cpu_state_t* reg, uint16_t operand);
+
+/*Predecoded instruction*/
+typedef struct
+{
+    decoded_handler_t handler;  /* NULL if not decoded yet */
+    uint16_t operand;           /* Raw operand bytes */
+    uint8_t length;             /* Instruction length in bytes */
+    uint8_t cycles;             /* Base cycle count */
+    uint8_t opcode;
+} decoded_instruction_t;
+
+/*Event callback, see Z6502::schedule_event()*/
+typedef void (*event_handler_t)(Z6502* cpu, void* context, uint64_t deadline);
+
+/*Pending event*/
+typedef struct
+{
+    uint64_t deadline;          /* Cycle count the event is due at */
+    uint32_t id;                /* Order of scheduling, breaks deadline ties */
+    event_handler_t handler;
+    void* context;
+} event_t;
+
+/*Register tested by a breakpoint condition*/
+typedef enum
+{
+    CONDITION_A,
+    CONDITION_X,
+    CONDITION_Y,
+    CONDITION_SP,
+    CONDITION_P                 /* Packed NV1BDIZC, as returned by Z6502::get_status() */
+} condition_register_t;
+
+/*Comparison of a breakpoint condition*/
+typedef enum
+{
+    CONDITION_EQUAL,
+    CONDITION_NOT_EQUAL,
+    CONDITION_LESS,
+    CONDITION_GREATER
+} condition_test_t;
+
+/*Breakpoint condition: (register & mask) compared to value*/
+typedef struct
+{
+    condition_register_t reg;
+    condition_test_t test;
+    uint8_t mask;
+    uint8_t value;
+} breakpoint_condition_t;
+
+/*What stopped the last run() or step(), see Z6502::get_break()*/
+typedef enum
+{
+    BREAK_NONE,
+    BREAK_EXECUTE,              /* Breakpoint, the instruction did not run */
+    BREAK_READ,                 /* Read watchpoint, the instruction ran */
+    BREAK_WRITE                 /* Write watchpoint, the instruction ran */
+} break_kind_t;
+
+/*Breakpoint or watchpoint hit*/
+typedef struct
+{
+    break_kind_t kind;
+    uint16_t program_counter;   /* Instruction that hit */
+    uint16_t address;           /* Address watched, program_counter for breakpoints */
+    uint8_t value;              /* Value read or written, 0 for breakpoints */
+} break_info_t;
+
+/*Memory mapped device. Handlers get the full 16 bit address*/
+typedef struct
+{
+    uint8_t (*read)(void* context, uint16_t addr);              /* NULL reads Z6502_OPEN_BUS_VALUE */
+    void (*write)(void* context, uint16_t addr, uint8_t value); /* NULL ignores writes */
+    void* context;
+} device_t;
+
+/*What a page of the memory space is mapped to*/
+typedef struct
+{
+    uint8_t* base;              /* 256 bytes of memory, NULL for devices and unmapped pages */
+    const device_t* device;     /* Device, NULL for memory and unmapped pages */
+    uint8_t read_only;          /* Writes to memory are ignored */
+} page_map_t;
+
+/*Memory space as seen by the interpreter*/
+typedef struct memory_s
+{
+    uint8_t* read_page[Z6502_PAGE_COUNT];   /* Direct read pointer per page, NULL for devices and unmapped pages */
+    uint8_t* write_page[Z6502_PAGE_COUNT];  /* Direct write pointer per page, NULL for ROM, devices, unmapped and code pages */
+    page_map_t page_map[Z6502_PAGE_COUNT];  /* Mapping used when there is no direct pointer */
+    uint8_t code_page[Z6502_PAGE_COUNT];    /* Page holds predecoded instructions or translated blocks */
+    decoded_instruction_t* decoded;         /* Predecoded instruction per address, allocated on first use */
+    struct jit_s* jit;                      /* Translated blocks, allocated on first use of the JIT core */
+    struct snapshot_page_s* shared[Z6502_PAGE_COUNT];   /* Snapshot page a memory page still matches, NULL once written */
+    uint8_t* owned;                         /* Backing of pages copied on write that have no memory of their own */
+    struct replay_s* replay;                /* Log of device reads and interrupts, NULL when not recording or replaying */
+    uint8_t replaying;                      /* Device reads come from the log and device writes are dropped */
+    struct debug_s* debug;                  /* Breakpoints and watchpoints, NULL when none is set */
+} memory_t;
+
+/*Saved registers and memory of a Z6502, see Z6502::snapshot()*/
+typedef struct z6502_snapshot_s z6502_snapshot_t;
+
+/*Save-state stream header: magic, format version, then Z6502_STATE_* flags, see Z6502::save_state()*/
+#define Z6502_STATE_MAGIC "Z6502STA"
+#define Z6502_STATE_VERSION 1U
+#define Z6502_STATE_HEADER_BYTES 16U
+
+/*Save-state flags*/
+#define Z6502_STATE_COMPRESSED 0x01U    /* Pages are stored as run-length coded deltas when smaller */
+
+/*Interpreter cores selectable with Z6502::set_core()*/
+enum core_t
+{
+    CORE_TABLE,     /* Function pointer table */
+    CORE_SWITCH,    /* Switch over all opcodes */
+    CORE_CACHE,     /* Predecoded instruction cache */
+    CORE_JIT,       /* x86-64 translation of hot blocks, CORE_CACHE elsewhere */
+};
+
+/*Cycle counting selectable with Z6502::set_timing()*/
+enum timing_t
+{
+    TIMING_FAST,        /* Base cycle count of instruction_cycles[] */
+    TIMING_ACCURATE,    /* Plus taken branches, branches to another page and indexed reads crossing a page */
+};
+
 /*Instruction set opcodes*/
 
 
@@ -72,103 +275,67 @@ enum addressing_mode_t
     INY, /* Indirect, Y-indexed	- aka (Indirect),Y */
 };
 
-/*Instruction function prototypes*/
-void _op_ADC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_AND(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_ASL(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BCC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BCS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BEQ(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BIT(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BMI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BNE(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BPL(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BRK(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BVC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_BVS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CLC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CLD(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CLI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CLV(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CMP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CPX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_CPY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_DEC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_DEX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_DEY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_EOR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_INC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_INX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_INY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_JMP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_JSR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_LDA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_LDX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_LDY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_LSR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_NOP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_ORA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_PHA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_PHP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_PLA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_PLP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_ROL(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_ROR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_RTI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_RTS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_SBC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_SEC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_SED(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_SEI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_STA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_STX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_STY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_TAX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_TAY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_TSX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_TXA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_TXS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-void _op_TYA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-
-
-typedef void (*instruction_t)(uint8_t* mem, register_set_t* reg, addressing_mode_t mode);
-
-static const instruction_t instruction_set[256] = {
+/*Instruction mnemonics*/
+enum instruction_id_t
+{
+    OP___, /* Undefined*/
+    OP_ADC, OP_AND, OP_ASL, OP_BCC, OP_BCS, OP_BEQ, OP_BIT, OP_BMI,
+    OP_BNE, OP_BPL, OP_BRK, OP_BVC, OP_BVS, OP_CLC, OP_CLD, OP_CLI,
+    OP_CLV, OP_CMP, OP_CPX, OP_CPY, OP_DEC, OP_DEX, OP_DEY, OP_EOR,
+    OP_INC, OP_INX, OP_INY, OP_JMP, OP_JSR, OP_LDA, OP_LDX, OP_LDY,
+    OP_LSR, OP_NOP, OP_ORA, OP_PHA, OP_PHP, OP_PLA, OP_PLP, OP_ROL,
+    OP_ROR, OP_RTI, OP_RTS, OP_SBC, OP_SEC, OP_SED, OP_SEI, OP_STA,
+    OP_STX, OP_STY, OP_TAX, OP_TAY, OP_TSX, OP_TXA, OP_TXS, OP_TYA,
+};
+
+/*Mnemonic per instruction_id_t*/
+static constexpr const char* instruction_mnemonic[] = {
+    "???",
+    "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI",
+    "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD", "CLI",
+    "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR",
+    "INC", "INX", "INY", "JMP", "JSR", "LDA", "LDX", "LDY",
+    "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL",
+    "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI", "STA",
+    "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+};
+
+static constexpr instruction_id_t instruction_id[256] = {
     /* 0x00 - 0x0F */
-    &_op_BRK,   &_op_ORA,   NULL,       NULL,       NULL,       &_op_ORA,   &_op_ASL,   NULL,   &_op_PHP,   &_op_ORA,   &_op_ASL,   NULL,   NULL,       &_op_ORA,   &_op_ASL,   NULL,
+    OP_BRK, OP_ORA, OP___, OP___, OP___, OP_ORA, OP_ASL, OP___, OP_PHP, OP_ORA, OP_ASL, OP___, OP___, OP_ORA, OP_ASL, OP___,
     /* 0x10 - 0x1F */
-    &_op_BPL,   &_op_ORA,   NULL,       NULL,       NULL,       &_op_ORA,   &_op_ASL,   NULL,   &_op_CLC,   &_op_ORA,   NULL,       NULL,   NULL,       &_op_ORA,   &_op_ASL,   NULL,
+    OP_BPL, OP_ORA, OP___, OP___, OP___, OP_ORA, OP_ASL, OP___, OP_CLC, OP_ORA, OP___, OP___, OP___, OP_ORA, OP_ASL, OP___,
     /* 0x20 - 0x2F */
-    &_op_JSR,   &_op_AND,   NULL,       NULL,       &_op_BIT,   &_op_AND,   &_op_ROL,   NULL,   &_op_PLP,   &_op_AND,   &_op_ROL,   NULL,   &_op_BIT,   &_op_AND,   &_op_ROL,   NULL,
+    OP_JSR, OP_AND, OP___, OP___, OP_BIT, OP_AND, OP_ROL, OP___, OP_PLP, OP_AND, OP_ROL, OP___, OP_BIT, OP_AND, OP_ROL, OP___,
     /* 0x30 - 0x3F */
-    &_op_BMI,   &_op_AND,   NULL,       NULL,       NULL,       &_op_AND,   &_op_ROL,   NULL,   &_op_SEC,   &_op_AND,   NULL,       NULL,   NULL,       &_op_AND,   &_op_ROL,   NULL,
+    OP_BMI, OP_AND, OP___, OP___, OP___, OP_AND, OP_ROL, OP___, OP_SEC, OP_AND, OP___, OP___, OP___, OP_AND, OP_ROL, OP___,
     /* 0x40 - 0x4F */
-    &_op_RTI,   &_op_EOR,   NULL,	    NULL,       NULL,       &_op_EOR,   &_op_LSR,   NULL,   &_op_PHA,   &_op_EOR,   &_op_LSR,   NULL,	&_op_JMP,   &_op_EOR,   &_op_LSR,   NULL,
+    OP_RTI, OP_EOR, OP___, OP___, OP___, OP_EOR, OP_LSR, OP___, OP_PHA, OP_EOR, OP_LSR, OP___, OP_JMP, OP_EOR, OP_LSR, OP___,
     /* 0x50 - 0x5F */
-    &_op_BVC,	&_op_EOR,   NULL,	    NULL,	    NULL,       &_op_EOR,   &_op_LSR,   NULL,   &_op_CLI,	&_op_EOR,   NULL,	    NULL,	NULL,	    &_op_EOR,   &_op_LSR,   NULL,
+    OP_BVC, OP_EOR, OP___, OP___, OP___, OP_EOR, OP_LSR, OP___, OP_CLI, OP_EOR, OP___, OP___, OP___, OP_EOR, OP_LSR, OP___,
     /* 0x60 - 0x6F */
-    &_op_RTS,	&_op_ADC,   NULL,	    NULL,	    NULL,	    &_op_ADC,   &_op_ROR,   NULL,   &_op_PLA,	&_op_ADC,   &_op_ROR,   NULL,	&_op_JMP,   &_op_ADC,   &_op_ROR,   NULL,
+    OP_RTS, OP_ADC, OP___, OP___, OP___, OP_ADC, OP_ROR, OP___, OP_PLA, OP_ADC, OP_ROR, OP___, OP_JMP, OP_ADC, OP_ROR, OP___,
     /* 0x70 - 0x7F */
-    &_op_BVC,   &_op_ADC,   NULL,	    NULL,	    NULL,	    &_op_ADC,   &_op_ROR,   NULL,   &_op_SEI,	&_op_ADC,   NULL,	    NULL,   NULL,	    &_op_ADC,   &_op_ROR,   NULL,
+    OP_BVS, OP_ADC, OP___, OP___, OP___, OP_ADC, OP_ROR, OP___, OP_SEI, OP_ADC, OP___, OP___, OP___, OP_ADC, OP_ROR, OP___,
     /* 0x80 - 0x8F */
-    NULL,       &_op_STA,   NULL,	    NULL,	    &_op_STY,   &_op_STA,   &_op_STX,   NULL,   &_op_DEY,	NULL,	    &_op_TXA,   NULL,	&_op_STY,   &_op_STA,   &_op_STX,   NULL,
+    OP___, OP_STA, OP___, OP___, OP_STY, OP_STA, OP_STX, OP___, OP_DEY, OP___, OP_TXA, OP___, OP_STY, OP_STA, OP_STX, OP___,
     /* 0x90 - 0x9F */
-    &_op_BCC,	&_op_STA,   NULL,	    NULL,	    &_op_STY,   &_op_STA,   &_op_STX,   NULL,   &_op_TYA,	&_op_STA,   &_op_TXS,   NULL,	NULL,	    &_op_STA,   NULL,       NULL,
+    OP_BCC, OP_STA, OP___, OP___, OP_STY, OP_STA, OP_STX, OP___, OP_TYA, OP_STA, OP_TXS, OP___, OP___, OP_STA, OP___, OP___,
     /* 0xA0 - 0xAF */
-    &_op_LDY,   &_op_LDA,   &_op_LDX,   NULL,	    &_op_LDY,   &_op_LDA,   &_op_LDX,   NULL,   &_op_TAY,	&_op_LDA,   &_op_TAX,   NULL,	&_op_LDY,   &_op_LDA,   &_op_LDX,   NULL,
+    OP_LDY, OP_LDA, OP_LDX, OP___, OP_LDY, OP_LDA, OP_LDX, OP___, OP_TAY, OP_LDA, OP_TAX, OP___, OP_LDY, OP_LDA, OP_LDX, OP___,
     /* 0xB0 - 0xBF */
-    &_op_BCS,   &_op_LDA,   NULL,	    NULL,	    &_op_LDY,   &_op_LDA,   &_op_LDX,   NULL,   &_op_CLV,	&_op_LDA,   &_op_TSX,   NULL,	&_op_LDY,   &_op_LDA,   &_op_LDX,   NULL,
+    OP_BCS, OP_LDA, OP___, OP___, OP_LDY, OP_LDA, OP_LDX, OP___, OP_CLV, OP_LDA, OP_TSX, OP___, OP_LDY, OP_LDA, OP_LDX, OP___,
     /* 0xC0 - 0xCF */
-    &_op_CPY,   &_op_CMP,   NULL,	    NULL,	    &_op_CPY,   &_op_CMP,   &_op_DEC,   NULL,   &_op_INY,	&_op_CMP,   &_op_DEX,   NULL,	&_op_CPY,   &_op_CMP,   &_op_DEC,   NULL,
+    OP_CPY, OP_CMP, OP___, OP___, OP_CPY, OP_CMP, OP_DEC, OP___, OP_INY, OP_CMP, OP_DEX, OP___, OP_CPY, OP_CMP, OP_DEC, OP___,
     /* 0xD0 - 0xDF */
-    &_op_BNE,	&_op_CMP,   NULL,	    NULL,	    NULL,	    &_op_CMP,   &_op_DEC,   NULL,   &_op_CLD,	&_op_CMP,   NULL,	    NULL,	NULL,	    &_op_CMP,   &_op_DEC,   NULL,
+    OP_BNE, OP_CMP, OP___, OP___, OP___, OP_CMP, OP_DEC, OP___, OP_CLD, OP_CMP, OP___, OP___, OP___, OP_CMP, OP_DEC, OP___,
     /* 0xE0 - 0xEF */
-    &_op_CPX,   &_op_SBC,   NULL,	    NULL,	    &_op_CPX,   &_op_SBC,   &_op_INC,   NULL,   &_op_INX,	&_op_SBC,   &_op_NOP,   NULL,	&_op_CPX,   &_op_SBC,   &_op_INC,   NULL,
+    OP_CPX, OP_SBC, OP___, OP___, OP_CPX, OP_SBC, OP_INC, OP___, OP_INX, OP_SBC, OP_NOP, OP___, OP_CPX, OP_SBC, OP_INC, OP___,
     /* 0xF0 - 0xFF */
-    &_op_BEQ,	&_op_SBC,   NULL,	    NULL,	    NULL,	    &_op_SBC,   &_op_INC,   NULL,   &_op_SED,	&_op_SBC,   NULL,	    NULL,	NULL,	    &_op_SBC,   &_op_INC,   NULL,
+    OP_BEQ, OP_SBC, OP___, OP___, OP___, OP_SBC, OP_INC, OP___, OP_SED, OP_SBC, OP___, OP___, OP___, OP_SBC, OP_INC, OP___,
 };
 
-static const int instruction_cycles[256] = {
+static constexpr int instruction_cycles[256] = {
     /* 0x00 - 0x0F */
     7, 6, 0, 0, 0, 3, 5, 0, 3, 2, 2, 0, 0, 4, 6, 0,
     /* 0x10 - 0x1F */
@@ -198,12 +365,12 @@ static const int instruction_cycles[256] = {
     /* 0xD0 - 0xDF */
     2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
     /* 0xE0 - 0xEF */
-    2, 6, 0, 0, 3, 3, 5, 0, 2, 2, 2, 2, 4, 4, 6, 0,
+    2, 6, 0, 0, 3, 3, 5, 0, 2, 2, 2, 0, 4, 4, 6, 0,
     /* 0xF0 - 0xFF */
     2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
 };
 
-static const addressing_mode_t instruction_mode[256] = {
+static constexpr addressing_mode_t instruction_mode[256] = {
     /* 0x00 - 0x0F */
     IMP, INX, ___, ___, ___, ZP,  ZP,  ___, IMP, IMM, ACC, ___, ___, ABS, ABS, ___,
     /* 0x10 - 0x1F */
@@ -233,49 +400,541 @@ static const addressing_mode_t instruction_mode[256] = {
     /* 0xD0 - 0xDF */
     REL, INY, ___, ___, ___, ZPX, ZPX, ___, IMP, ABY, ___, ___, ___, ABX, ABX, ___,
     /* 0xE0 - 0xEF */
-    IMM, INX, ___, ___, ZP,  ZP,  ZP,  ___, IMM, IMM, IMP, ___, ABS, ABS, ABS, ___,
+    IMM, INX, ___, ___, ZP,  ZP,  ZP,  ___, IMP, IMM, IMP, ___, ABS, ABS, ABS, ___,
     /* 0xF0 - 0xFF */
     REL, INY, ___, ___, ___, ZPX, ZPX, ___, IMP, ABY, ___, ___, ___, ABX, ABX, ___,
 };
 
 class Z6502
 {
+    /*Attaches the log and drives interrupts while replaying*/
+    friend class Z6502Replay;
+
+    /*Restores the starting state and reads the coverage while fuzzing*/
+    friend class Z6502Fuzzer;
+
 private:
     /*Registers*/
-    register_set_t _reg;
+    cpu_state_t _reg;
     
     /*Memory*/
-    uint8_t* _memory_space;
+    memory_t _memory;
+
+    /*Total number of clock cycles and instructions executed since creation*/
+    uint64_t _cycles;
+    uint64_t _instructions;
+
+    /*Execution stopped on an unhandled opcode*/
+    uint8_t _halted;
+
+    /*Stop requested from outside the run loop*/
+    uint8_t _stop_requested;
+
+    /*Stop requested with stop(), not to service an event or an interrupt*/
+    uint8_t _stop_by_user;
+
+    /*Pending events, a binary min-heap on deadline then id*/
+    event_t _event[Z6502_MAX_EVENTS];
+    unsigned int _event_count;
+    uint32_t _event_serial;
+
+    /*Asserted IRQ lines, one bit per line, and NMI edge not serviced yet*/
+    uint32_t _irq_lines;
+    uint8_t _nmi_pending;
+
+    /*Idle loops are fast-forwarded, cycles skipped that way and cycles to run before the next check*/
+    uint8_t _idle_skip;
+    uint64_t _idle_cycles;
+    uint32_t _idle_interval;
+
+    /*Core used by run()*/
+    core_t _core;
+
+    /*Cycle counting of run() and step()*/
+    timing_t _timing;
+
+    /*Tracer fed by run() and step(), NULL when not tracing*/
+    Z6502Tracer* _tracer;
+
+    /*Profiler fed by run() and step(), NULL when not profiling*/
+    Z6502Profiler* _profiler;
+
+    /*Breakpoint or watchpoint the last run() or step() stopped on*/
+    break_info_t _break;
+
+    /*Edge coverage bitmap of Z6502_FUZZ_MAP_ENTRIES bits, NULL when not
+      fuzzing, previous instruction address hash and entries newly hit*/
+    uint8_t* _coverage;
+    uint16_t _coverage_previous;
+    uint32_t _coverage_new;
+
+    /**
+     * @brief Instruction by instruction interpretation is needed: tracing,
+     *        profiling, fuzzing or breakpoints and watchpoints set
+     */
+    uint8_t _is_instrumented(void){
+        return (_tracer != NULL || _profiler != NULL || _memory.debug != NULL || _coverage != NULL) ? TRUE : FALSE;
+    }
+
+    /**
+     * @brief Breakpoint at the current instruction stops it
+     * @param reg Registers
+     * @param cycles Cycle count at the instruction
+     */
+    uint8_t _break_at(const cpu_state_t* reg, uint64_t cycles);
+
+    /**
+     * @brief Free the breakpoint state once nothing is set and refresh the
+     *        direct pointers of a range of pages (see z6502_debug.cpp)
+     * @param first_page First page
+     * @param page_count Number of pages
+     */
+    void _update_debug(unsigned int first_page, unsigned int page_count);
+
+    /**
+     * @brief run() implementation dispatching through instruction_set[]
+     * @tparam TIMING timing_fast_t or timing_accurate_t (see z6502_private.h)
+     */
+    template<typename TIMING>
+    uint64_t _run_table(uint64_t cycle_budget);
+
+    /**
+     * @brief run() implementation dispatching with a switch over all opcodes
+     * @tparam TIMING timing_fast_t or timing_accurate_t (see z6502_private.h)
+     */
+    template<typename TIMING>
+    uint64_t _run_switch(uint64_t cycle_budget);
+
+    /**
+     * @brief run() implementation executing from the predecoded instruction cache
+     * @tparam TIMING timing_fast_t or timing_accurate_t (see z6502_private.h)
+     */
+    template<typename TIMING>
+    uint64_t _run_cached(uint64_t cycle_budget);
+
+    /**
+     * @brief run() implementation executing translated blocks of native code
+     */
+    uint64_t _run_jit(uint64_t cycle_budget);
+
+    /**
+     * @brief run() implementation feeding the tracer and the profiler with every instruction
+     */
+    uint64_t _run_instrumented(uint64_t cycle_budget);
+
+    /**
+     * @brief Run the selected core, or the instrumented loop, for a cycle budget
+     */
+    uint64_t _dispatch(uint64_t cycle_budget);
+
+    /**
+     * @brief run() implementation executing the core up to each event
+     *        deadline and servicing events and interrupts in between
+     */
+    uint64_t _run_scheduled(uint64_t cycle_budget);
+
+    /**
+     * @brief Enter an interrupt handler, between two instructions
+     * @param vector Z6502_IRQ_VECTOR_ADDRESS or Z6502_NMI_VECTOR_ADDRESS
+     */
+    void _take_interrupt(uint16_t vector);
+
+    /**
+     * @brief Fast-forward the idle loop at program counter, if there is one,
+     *        by as many whole iterations as fit in the cycle budget
+     * @returns Cycles skipped, 0 if not in an idle loop
+     */
+    uint64_t _skip_idle(uint64_t cycle_budget);
+
+    /**
+     * @brief Something is due between two instructions: an event, an NMI or an IRQ line
+     */
+    uint8_t _is_scheduled(void){
+        return (_event_count > 0U || _irq_lines != 0U || _nmi_pending == TRUE) ? TRUE : FALSE;
+    }
+
+    /**
+     * @brief Drop a request to end the slice before running the next one.
+     *        stop() sets _stop_by_user first, a request it makes meanwhile
+     *        is either kept or seen here.
+     * @returns TRUE if stop() was called and run() must return
+     */
+    uint8_t _begin_slice(void){
+        _stop_requested = FALSE;
+        return _stop_by_user;
+    }
 public:
     /**
      * @brief Create Z6502 CPU
-     * @param memory_space pointer to memory space
-     * @param io_space pointer to io space
+     * @param memory_space pointer to a 64 KiB memory space mapped as RAM,
+     *        NULL to leave every page unmapped
      */
     Z6502(uint8_t* memory_space);
 
+    /**
+     * @brief Map memory over a range of pages. Reads and writes to it are
+     *        direct loads and stores.
+     * @param first_page First page (address >> 8)
+     * @param page_count Number of pages
+     * @param memory Backing memory of page_count * 256 bytes, NULL to unmap
+     * @param read_only TRUE to ignore writes (ROM)
+     * @returns 0 on success, -1 if the range is out of the memory space
+     */
+    int map_memory(uint8_t first_page, unsigned int page_count, uint8_t* memory, uint8_t read_only);
+
+    /**
+     * @brief Map a device over a range of pages. Every access to the range
+     *        calls the device handlers.
+     * @param first_page First page (address >> 8)
+     * @param page_count Number of pages
+     * @param device Device, must outlive the mapping
+     * @returns 0 on success, -1 if the range is out of the memory space
+     */
+    int map_device(uint8_t first_page, unsigned int page_count, const device_t* device);
+
     /**
      * @brief Reset CPU register
      */
     void reset(void);
 
     /**
-     * @brief execute one instruction from memory at program counter
+     * @brief execute one instruction from memory at program counter. A
+     *        pending stop() does not prevent it and stays pending for run().
      * @returns number of clock cycles spent
      */
     int step(void);
 
     /**
-     * @brief 
+     * @brief execute instructions until the cycle budget is spent or a stop condition is hit
+     * @param cycle_budget number of clock cycles to execute. The last instruction
+     *        may overshoot the budget by a few cycles. A stop() made before
+     *        the call returns at once, the stop request is cleared on return.
+     * @returns number of clock cycles spent
+     */
+    uint64_t run(uint64_t cycle_budget);
+
+    /**
+     * @brief Select the core used by run(). The default is set at build time
+     *        with Z6502_DISPATCH. All cores give the same results.
+     * @param core Interpreter core
+     */
+    void set_core(core_t core){
+        _core = core;
+    }
+
+    /**
+     * @brief Get the core used by run()
+     */
+    core_t get_core(void){
+        return _core;
+    }
+
+    /**
+     * @brief Select how run() and step() count cycles. TIMING_FAST, the
+     *        default, counts the base cycles of each instruction.
+     *        TIMING_ACCURATE adds the 6502 penalties: one cycle for a taken
+     *        branch, one more when it lands in another page, and one for an
+     *        indexed read (abs,X abs,Y (zp),Y) crossing a page. Each core is
+     *        compiled once per timing so the fast one pays nothing for it;
+     *        CORE_JIT runs CORE_CACHE under accurate timing.
+     * @param timing Cycle counting
+     */
+    void set_timing(timing_t timing){
+        _timing = timing;
+    }
+
+    /**
+     * @brief Get how run() and step() count cycles
+     */
+    timing_t get_timing(void){
+        return _timing;
+    }
+
+    /**
+     * @brief Record every instruction executed by run() and step(). While a
+     *        tracer is attached run() interprets instruction by instruction
+     *        whatever the core, the cores themselves are left untouched.
+     * @param tracer Open tracer, used by this instance only. NULL to stop tracing.
+     */
+    void set_tracer(Z6502Tracer* tracer){
+        _tracer = tracer;
+    }
+
+    /**
+     * @brief Count executions and cycles per opcode and per address of every
+     *        instruction executed by run() and step(). Like tracing, profiling
+     *        interprets instruction by instruction whatever the core.
+     * @param profiler Profiler, may be shared by instances run one after the other. NULL to stop profiling.
+     */
+    void set_profiler(Z6502Profiler* profiler){
+        _profiler = profiler;
+    }
+
+    /**
+     * @brief Request the current run() batch to return after the current
+     *        instruction, or the next run() to return at once when none is
+     *        running. Safe from a device, an event handler or a signal handler.
+     */
+    void stop(void){
+        _stop_by_user = TRUE;
+        _stop_requested = TRUE;
+    }
+
+    /**
+     * @brief Call a handler once the cycle counter reaches a deadline. run()
+     *        executes uninterrupted up to the earliest deadline, then calls
+     *        the handlers due in deadline order, before the next instruction.
+     *        The last instruction may overshoot the deadline by a few cycles.
+     *        Handlers may schedule events and drive the interrupt lines.
+     *        Events are not copied by fork().
+     * @param deadline Cycle count, as returned by get_cycles(), the handler is due at
+     * @param handler Handler, gets the deadline it was scheduled for
+     * @param context Handler context
+     * @returns Event id for cancel_event(), -1 if Z6502_MAX_EVENTS are pending
+     */
+    int schedule_event(uint64_t deadline, event_handler_t handler, void* context);
+
+    /**
+     * @brief Drop a pending event
+     * @param id Event id returned by schedule_event()
+     * @returns 0 on success, -1 if the event already ran or was cancelled
+     */
+    int cancel_event(int id);
+
+    /**
+     * @brief Drive an IRQ line low. The CPU enters the IRQ handler between two
+     *        instructions while any line is asserted and interrupts are enabled.
+     * @param line Line, below Z6502_IRQ_LINES, one per device
+     * @returns 0 on success, -1 if the line does not exist
+     */
+    int assert_irq(unsigned int line);
+
+    /**
+     * @brief Release an IRQ line, usually when the handler acknowledges the device
+     * @param line Line, below Z6502_IRQ_LINES
+     * @returns 0 on success, -1 if the line does not exist
+     */
+    int release_irq(unsigned int line);
+
+    /**
+     * @brief Signal a falling edge on the NMI input. The CPU enters the NMI
+     *        handler before the next instruction.
+     */
+    void trigger_nmi(void);
+
+    /**
+     * @brief Fast-forward idle loops. run() then executes in windows of
+     *        Z6502_IDLE_CHECK_MIN_CYCLES to Z6502_IDLE_CHECK_MAX_CYCLES and
+     *        looks for an idle loop between two: a loop of up to Z6502_IDLE_MAX_INSTRUCTIONS that neither stores
+     *        nor touches the stack or a device, and leaves every register as
+     *        it found it, e.g. JMP *, BNE *-2 or LDA flag / BEQ *-5. Only an
+     *        event or an interrupt can get the CPU out of it, so the cycle
+     *        counter jumps to the next deadline or to the end of the budget.
+     *        Registers and cycles end up exactly as if every iteration had
+     *        run. Ignored while tracing, profiling or debugging.
+     * @param enable TRUE to fast-forward, FALSE (default) to interpret every iteration
+     */
+    void set_idle_skip(uint8_t enable){
+        _idle_skip = enable;
+    }
+
+    /**
+     * @brief Get total number of clock cycles fast-forwarded in idle loops,
+     *        included in get_cycles()
+     */
+    uint64_t get_idle_cycles(void){
+        return _idle_cycles;
+    }
+
+    /**
+     * @brief Stop run() and step() before the instruction at an address.
+     *        Once any breakpoint or watchpoint is set run() interprets
+     *        instruction by instruction whatever the core, like tracing,
+     *        and goes back to the core once the last one is cleared.
+     *        Resuming from a breakpoint executes the instruction it stopped on.
+     * @param address Instruction address
+     * @param condition Stop only when the condition holds, NULL to always stop. Replaces the previous condition.
+     * @returns 0 on success, -1 if out of memory
+     */
+    int set_breakpoint(uint16_t address, const breakpoint_condition_t* condition = NULL);
+
+    /**
+     * @brief Remove a breakpoint
+     * @param address Instruction address
+     * @returns 0 on success, -1 if there is no breakpoint at the address
+     */
+    int clear_breakpoint(uint16_t address);
+
+    /**
+     * @brief Stop run() and step() after an instruction that reads or writes
+     *        a range of addresses. Pages holding a watched address lose their
+     *        direct pointers, accesses to other pages stay at full speed.
+     *        Instruction fetches do not count as reads.
+     * @param address First address
+     * @param length Number of addresses
+     * @param access Z6502_WATCH_READ, Z6502_WATCH_WRITE or both
+     * @returns 0 on success, -1 if the range or the access is invalid or out of memory
      */
-    register_set_t* dump_register(register_set_t* register_set){
-        return &_reg;
+    int set_watchpoint(uint16_t address, unsigned int length, uint8_t access);
+
+    /**
+     * @brief Stop watching a range of addresses
+     * @param address First address
+     * @param length Number of addresses
+     * @param access Z6502_WATCH_READ, Z6502_WATCH_WRITE or both
+     * @returns 0 on success, -1 if the range or the access is invalid
+     */
+    int clear_watchpoint(uint16_t address, unsigned int length, uint8_t access);
+
+    /**
+     * @brief Remove every breakpoint and watchpoint
+     */
+    void clear_debug(void);
+
+    /**
+     * @brief Get the breakpoint or watchpoint the last run() or step() stopped on
+     * @param info Hit, may be NULL
+     * @returns BREAK_NONE if it did not stop on one
+     */
+    break_kind_t get_break(break_info_t* info){
+        if(info != NULL){
+            *info = _break;
+        }
+        return _break.kind;
+    }
+
+    /**
+     * @brief Get total number of clock cycles executed
+     */
+    uint64_t get_cycles(void){
+        return _cycles;
     }
 
+    /**
+     * @brief Get total number of instructions executed, idle loop iterations
+     *        fast-forwarded included. Interrupt entries are not instructions.
+     */
+    uint64_t get_instructions(void){
+        return _instructions;
+    }
+
+    /**
+     * @brief CPU stopped on an unhandled opcode
+     * @returns TRUE if halted, FALSE otherwise
+     */
+    uint8_t is_halted(void){
+        return _halted;
+    }
+
+    /**
+     * @brief Drop all predecoded instructions and translated blocks. Needed after mapped memory
+     *        was modified from outside the CPU.
+     */
+    void invalidate_cache(void);
+
+    /**
+     * @brief Decode known code ahead of run(), instead of discovering it
+     *        while running: CORE_CACHE predecodes every instruction of the
+     *        map, CORE_JIT translates every block. The other cores have
+     *        nothing to prepare. Code is dropped on stores as usual.
+     * @param code_map Z6502_MAX_MEMORY_SIZE_BYTES flag bytes, Z6502_CODE_*
+     * @returns Number of instructions or blocks prepared, -1 if out of memory
+     */
+    int prewarm(const uint8_t* code_map);
+
+    /**
+     * @brief Save registers and memory. Memory pages are shared copy-on-write
+     *        with the snapshot, only pages written since the previous snapshot
+     *        are copied. ROM and devices are kept by reference.
+     * @returns Snapshot to release with snapshot_free(), NULL if out of memory
+     */
+    z6502_snapshot_t* snapshot(void);
+
+    /**
+     * @brief Return to a snapshot of this or another instance. Memory pages
+     *        mapped by the caller are refreshed in place, other pages are
+     *        shared copy-on-write with the snapshot.
+     * @param snapshot Snapshot
+     */
+    void restore(const z6502_snapshot_t* snapshot);
+
+    /**
+     * @brief Write a save-state: registers, cycle and instruction counters,
+     *        IRQ lines and pending NMI, and the RAM pages that differ from a
+     *        reference image, usually the ROM image as loaded. ROM, devices
+     *        and pending events are not saved. The stream ends with a
+     *        checksum, several states may follow each other in a file.
+     * @param file Output stream, binary
+     * @param reference Memory image the state is a delta against,
+     *        Z6502_MAX_MEMORY_SIZE_BYTES long. NULL for an all zero image.
+     * @param flags Z6502_STATE_COMPRESSED or 0
+     * @returns 0 on success, -1 if writing failed
+     */
+    int save_state(FILE* file, const uint8_t* reference, uint8_t flags = Z6502_STATE_COMPRESSED);
+
+    /**
+     * @brief Read a save-state written by save_state(). Nothing changes
+     *        unless the whole state reads and checks fine. RAM pages not in
+     *        the state are reset from the reference image, decoded code is
+     *        dropped and pending events are kept.
+     * @param file Input stream, binary, left after the state
+     * @param reference The memory image the state was saved against, NULL for an all zero image
+     * @returns 0 on success, -1 if the stream is not a state of this version,
+     *          is corrupt, was saved against another reference or
+     *          holds pages that are not RAM in this instance
+     */
+    int load_state(FILE* file, const uint8_t* reference);
+
+    /**
+     * @brief Create an instance in the same state, sharing every memory page
+     *        copy-on-write. The new instance copies a page on its first write to it.
+     * @returns Instance to be deleted by the caller, NULL if out of memory
+     */
+    Z6502* fork(void);
+
+    /**
+     * @brief Copy registers and flags to an architectural register set
+     * @param register_set Target register set
+     * @returns register_set
+     */
+    register_set_t* dump_register(register_set_t* register_set);
+
+    /**
+     * @brief Load registers and flags from an architectural register set
+     * @param register_set Source register set
+     */
+    void load_register(const register_set_t* register_set);
+
+    /**
+     * @brief Get processor status in packed P register form (NV1BDIZC)
+     */
+    uint8_t get_status(void);
+
     /**
      * @brief Z6502 destructor
      */
     ~Z6502();
 };
 
-#endif // Z6502_CORE_H_INCLUDED
\ No newline at end of file
+/**
+ * @brief Release a snapshot. Instances restored from it keep sharing its pages.
+ * @param snapshot Snapshot, may be NULL
+ */
+void snapshot_free(z6502_snapshot_t* snapshot);
+
+/**
+ * @brief Parse a core name (table, switch, cache or jit), case insensitive
+ * @param name Core name
+ * @param core Parsed core
+ * @returns 0 on success, -1 if the name is unknown
+ */
+int core_parse_name(const char* name, core_t* core);
+
+/**
+ * @brief Get the name of a core, as core_parse_name() reads it
+ * @param core Core
+ * @returns Name, "unknown" for a value that is not a core
+ */
+const char* core_get_name(core_t core);
+
+#endif // Z6502_CORE_H_INCLUDED
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_BATCH_H_INCLUDED
+#define Z6502_BATCH_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "z6502.h"
+
+/*Cycles run between two trap checks. Slices start small and double so that
+  short jobs do not spin long in their trap*/
+#define BATCH_MIN_SLICE_CYCLES 1024U
+#define BATCH_MAX_SLICE_CYCLES 1048576U
+
+/*Longest instruction. The trap check steps one instruction and only runs
+  while this many cycles are left, so jobs stay within their cycle limit*/
+#define BATCH_TRAP_CHECK_CYCLES 7U
+
+/*One ROM test job*/
+typedef struct
+{
+    std::string rom;            /* ROM file name: raw, Intel HEX, S-record or PRG image */
+    uint16_t load_address;      /* Address a raw ROM is loaded at, other formats carry their own */
+    uint16_t entry;             /* Program counter at start */
+    uint8_t reset_entry;        /* Start from the reset vector instead of entry */
+    uint64_t cycle_limit;       /* Cycles before the job times out */
+    uint8_t check_pc;           /* Compare the trap address with expected_pc */
+    uint16_t expected_pc;       /* Address the program is expected to trap at */
+} batch_job_t;
+
+/*Job outcome*/
+enum batch_status_t
+{
+    BATCH_PASS,     /* Trapped at the expected address, or no expectation */
+    BATCH_FAIL,     /* Trapped somewhere else */
+    BATCH_TIMEOUT,  /* Cycle limit reached without trapping */
+    BATCH_ERROR,    /* ROM could not be loaded */
+};
+
+/*Result of one job*/
+typedef struct
+{
+    batch_status_t status;
+    uint16_t final_pc;          /* Program counter when the job ended */
+    uint64_t cycles;            /* Cycles executed */
+    uint64_t instructions;      /* Instructions executed */
+    double seconds;             /* Wall clock time of the job */
+    std::string error;          /* Why the ROM could not be loaded */
+} batch_result_t;
+
+/**
+ * @brief Load a job manifest. One job per line:
+ *        ROM_file load_address entry|reset cycle_limit expected_pc|-
+ *        Addresses are hexadecimal, the cycle limit decimal. Empty lines
+ *        and lines starting with # are ignored.
+ * @param filename Manifest file name
+ * @param jobs Jobs read from the manifest are appended here
+ * @returns 0 on success, line number of the first bad line, -1 if the file cannot be read
+ */
+int batch_load_manifest(const char* filename, std::vector<batch_job_t>* jobs);
+
+/**
+ * @brief Run one job on its own Z6502 instance. A job ends when the CPU
+ *        halts, traps on a jump or branch to itself, or runs out of cycles.
+ * @param job Job
+ * @param core Interpreter core
+ * @param result Job result
+ */
+void batch_run_job(const batch_job_t* job, core_t core, batch_result_t* result);
+
+/**
+ * @brief Run jobs on a pool of worker threads. Each worker starts with an
+ *        equal share of the jobs and steals from the others once its own
+ *        queue is empty. Every ROM file is mapped once for the whole run.
+ * @param jobs Jobs
+ * @param results One result per job, in job order
+ * @param thread_count Number of workers, 0 for one per hardware thread
+ * @param core Interpreter core
+ */
+void batch_run(const std::vector<batch_job_t>& jobs, std::vector<batch_result_t>* results, unsigned int thread_count, core_t core);
+
+#endif // Z6502_BATCH_H_INCLUDED
@@ -0,0 +1,120 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_DISASM_H_INCLUDED
+#define Z6502_DISASM_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include "z6502.h"
+
+/*Code map file header: magic then format version, followed by the flags*/
+#define Z6502_CODE_MAP_MAGIC "Z6502MAP"
+#define Z6502_CODE_MAP_VERSION 1U
+#define Z6502_CODE_MAP_HEADER_BYTES 16U
+
+/*Longest disassembled instruction text, terminator included: "LDA ($12),Y"*/
+#define Z6502_DISASM_TEXT_BYTES 16U
+
+/*Code and data found by recursive traversal of a memory image*/
+typedef struct
+{
+    uint8_t flags[Z6502_MAX_MEMORY_SIZE_BYTES];     /* Z6502_CODE_* per address */
+} code_map_t;
+
+/*What a code map holds*/
+typedef struct
+{
+    uint32_t instructions;      /* Instructions found */
+    uint32_t code_bytes;        /* Instruction and operand bytes */
+    uint32_t data_bytes;        /* Data bytes referenced, code excluded */
+    uint32_t blocks;            /* Basic blocks */
+    uint32_t targets;           /* Branch, jump and call targets */
+    uint32_t invalid;           /* Addresses flow reached but could not decode */
+} code_map_stats_t;
+
+/**
+ * @brief Disassemble one instruction
+ * @param memory Memory image, Z6502_MAX_MEMORY_SIZE_BYTES long
+ * @param address Instruction address
+ * @param text Output, Z6502_DISASM_TEXT_BYTES long, e.g. "LDA $1234,X".
+ *        Branch targets are printed as absolute addresses, undefined opcodes as ".BYTE $xx".
+ * @returns Instruction length in bytes, 1 for undefined opcodes
+ */
+unsigned int disasm_instruction(const uint8_t* memory, uint16_t address, char* text);
+
+/**
+ * @brief Create an empty code map, everything unknown
+ * @returns Map to release with code_map_free(), NULL if out of memory
+ */
+code_map_t* code_map_create(void);
+
+/**
+ * @brief Release a code map
+ * @param map Map, may be NULL
+ */
+void code_map_free(code_map_t* map);
+
+/**
+ * @brief Follow the code flow from an entry point: both ways of branches,
+ *        jump and call targets and the return point of calls. Flow ends on
+ *        RTS, RTI, BRK, indirect jumps, unhandled opcodes and known code.
+ *        Operands of loads, stores and indirect jumps mark their target as data.
+ * @param map Map, completed
+ * @param memory Memory image, Z6502_MAX_MEMORY_SIZE_BYTES long
+ * @param entry Entry point
+ * @returns Number of instructions found
+ */
+uint32_t code_map_trace(code_map_t* map, const uint8_t* memory, uint16_t entry);
+
+/**
+ * @brief Trace from the NMI, reset and IRQ vectors, marked as data
+ * @returns Number of instructions found
+ */
+uint32_t code_map_trace_vectors(code_map_t* map, const uint8_t* memory);
+
+/**
+ * @brief Count what a map holds
+ */
+void code_map_get_stats(const code_map_t* map, code_map_stats_t* stats);
+
+/**
+ * @brief Print a listing of a range: instructions with their bytes, labels
+ *        on targets, a blank line between blocks, data and unknown bytes
+ *        as .BYTE lines of up to 8, one line per run of unknown bytes
+ * @param map Map
+ * @param memory Memory image
+ * @param first First address
+ * @param last Last address
+ * @param out Output stream
+ */
+void code_map_print(const code_map_t* map, const uint8_t* memory, uint16_t first, uint16_t last, FILE* out);
+
+/**
+ * @brief Save a map, see Z6502_CODE_MAP_MAGIC
+ * @param map Map
+ * @param filename Output file name
+ * @returns 0 on success, -1 if the file cannot be written
+ */
+int code_map_export(const code_map_t* map, const char* filename);
+
+/**
+ * @brief Load a map saved by code_map_export()
+ * @param map Map, replaced
+ * @param filename Input file name
+ * @returns 0 on success, -1 if the file cannot be read or is not a code map
+ */
+int code_map_import(code_map_t* map, const char* filename);
+
+#endif // Z6502_DISASM_H_INCLUDED
@@ -0,0 +1,201 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_FUZZ_H_INCLUDED
+#define Z6502_FUZZ_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "z6502.h"
+
+/*Edge coverage map size in entries, one bit each*/
+#define Z6502_FUZZ_MAP_ENTRIES 65536U
+
+/*Inputs kept for mutation at most*/
+#define Z6502_FUZZ_MAX_CORPUS 4096U
+
+/*How an iteration ended*/
+typedef enum
+{
+    FUZZ_EXIT,                  /* Reached an exit address */
+    FUZZ_TIMEOUT,               /* Ran out of cycles */
+    FUZZ_HALT,                  /* Unhandled opcode, a crash */
+    FUZZ_BREAK                  /* Stopped on a breakpoint or watchpoint set by the caller */
+} fuzz_result_t;
+
+/*Totals since attach()*/
+typedef struct
+{
+    uint64_t iterations;
+    uint64_t result[FUZZ_BREAK + 1];    /* Iterations per fuzz_result_t */
+    uint64_t cycles;                    /* Cycles executed */
+    uint64_t dirty_pages;               /* Pages restored between iterations */
+    uint32_t edges;                     /* Coverage map entries hit */
+    uint32_t corpus;                    /* Inputs kept for mutation */
+} fuzz_stats_t;
+
+/*Called for iterations ending in FUZZ_HALT or FUZZ_BREAK, see Z6502Fuzzer::set_finding_handler()*/
+typedef void (*fuzz_handler_t)(void* context, fuzz_result_t result, const uint8_t* input, size_t length);
+
+/*Coverage guided fuzzer running many short executions of a Z6502 from one
+  starting state. Each iteration restores the state saved by attach(),
+  which only copies back the memory pages the previous iteration wrote
+  (see Z6502::snapshot()), copies the input to a memory region and runs
+  until an exit address, a crash or a cycle limit. Coverage is recorded as
+  hashed (previous, current) instruction address pairs.
+  Events, IRQ lines and devices are not part of the starting state.*/
+class Z6502Fuzzer
+{
+private:
+    /*Instance fuzzed and its starting state*/
+    Z6502* _cpu;
+    z6502_snapshot_t* _start;
+
+    /*Input region and cycles per iteration*/
+    uint16_t _input_address;
+    uint16_t _input_size;
+    uint64_t _cycle_limit;
+
+    /*Addresses ending an iteration, set as breakpoints*/
+    std::vector<uint16_t> _exit;
+
+    /*Coverage bitmap, filled by the CPU*/
+    uint8_t* _coverage;
+
+    /*Inputs that found new coverage*/
+    std::vector<std::vector<uint8_t>> _corpus;
+
+    fuzz_handler_t _finding_handler;
+    void* _finding_context;
+    fuzz_stats_t _stats;
+    uint64_t _rng;
+
+    /**
+     * @brief Next pseudo-random number, xorshift64
+     */
+    uint64_t _random(void);
+
+    /**
+     * @brief Apply a few random mutations to an input
+     * @param input Input, resized within 1 to the input region size
+     */
+    void _mutate(std::vector<uint8_t>* input);
+
+    /**
+     * @brief Write the input to the input region, zero filled after it
+     */
+    void _load_input(const uint8_t* input, size_t length);
+
+public:
+    /**
+     * @brief Create a detached fuzzer
+     */
+    Z6502Fuzzer();
+
+    /**
+     * @brief Save the current state of an instance as the starting state of
+     *        every iteration, and start recording its coverage
+     * @param cpu Instance, its registers point at the code under test
+     * @param input_address First address of the input region, mapped to RAM
+     * @param input_size Input region size in bytes. Inputs are truncated to
+     *        it, A and X get the low and high bytes of the input length.
+     * @param cycle_limit Cycles an iteration may run
+     * @returns 0 on success, -1 if the region is not RAM, cycle_limit is 0 or out of memory
+     */
+    int attach(Z6502* cpu, uint16_t input_address, uint16_t input_size, uint64_t cycle_limit);
+
+    /**
+     * @brief Stop recording coverage and remove the exit breakpoints. Must be
+     *        called before the instance is deleted.
+     */
+    void detach(void);
+
+    /**
+     * @brief End iterations before the instruction at an address, e.g. the
+     *        return of the parser. Sets a breakpoint.
+     * @param address Instruction address
+     * @returns 0 on success, -1 if not attached or out of memory
+     */
+    int add_exit(uint16_t address);
+
+    /**
+     * @brief Add an input to the corpus mutated by fuzz()
+     * @returns 0 on success, -1 if not attached
+     */
+    int add_seed(const uint8_t* input, size_t length);
+
+    /**
+     * @brief Report crashes and breakpoint or watchpoint hits
+     * @param handler Handler, NULL for none
+     * @param context Handler context
+     */
+    void set_finding_handler(fuzz_handler_t handler, void* context){
+        _finding_handler = handler;
+        _finding_context = context;
+    }
+
+    /**
+     * @brief Seed the mutations of fuzz()
+     */
+    void set_seed(uint64_t seed){
+        _rng = (seed != 0U) ? seed : 1U;
+    }
+
+    /**
+     * @brief Run one input from the starting state. The instance is left
+     *        where the iteration ended until the next one.
+     * @param input Input bytes
+     * @param length Input length
+     * @param new_edges Coverage map entries hit for the first time, may be NULL
+     * @returns How the iteration ended
+     */
+    fuzz_result_t run_one(const uint8_t* input, size_t length, uint32_t* new_edges);
+
+    /**
+     * @brief Mutate corpus inputs and run them, keeping those that find new
+     *        coverage. An empty corpus starts from a zero byte.
+     * @param iterations Number of inputs to run
+     * @returns Number of inputs run, 0 if not attached
+     */
+    uint64_t fuzz(uint64_t iterations);
+
+    /**
+     * @brief Get totals since attach()
+     */
+    void get_stats(fuzz_stats_t* stats){
+        *stats = _stats;
+    }
+
+    /**
+     * @brief Get an input of the corpus
+     * @param index Index, below fuzz_stats_t::corpus
+     */
+    const std::vector<uint8_t>& get_input(size_t index){
+        return _corpus[index];
+    }
+
+    /**
+     * @brief Print iterations per outcome, coverage and corpus size
+     * @param out Output stream
+     */
+    void print_summary(FILE* out);
+
+    /**
+     * @brief Z6502Fuzzer destructor, detaches
+     */
+    ~Z6502Fuzzer();
+};
+
+#endif // Z6502_FUZZ_H_INCLUDED
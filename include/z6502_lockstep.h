@@ -0,0 +1,176 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_LOCKSTEP_H_INCLUDED
+#define Z6502_LOCKSTEP_H_INCLUDED
+
+#include <cstdint>
+#include "z6502.h"
+
+/*Lanes of a lockstep group, one byte per lane in a 256 bit vector*/
+#define Z6502_LOCKSTEP_LANES 32U
+
+/*Register set of a lockstep group, one array entry per lane. N and Z are
+  kept lazily like in cpu_state_t and the stack pointer is a single byte so
+  that every register fills exactly one vector*/
+typedef struct
+{
+    alignas(32) uint8_t stack_pointer[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t accumulator[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t x[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t y[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t carry[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t irq_disable[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t decimal_mode[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t overflow[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t zero_result[Z6502_LOCKSTEP_LANES];      /* Z is set when this byte is 0 */
+    alignas(32) uint8_t negative_result[Z6502_LOCKSTEP_LANES];  /* N is bit 7 of this byte */
+    uint16_t program_counter[Z6502_LOCKSTEP_LANES];             /* Only up to date between two runs */
+} register_set_soa_t;
+
+/*Up to Z6502_LOCKSTEP_LANES instances executing the same instruction stream*/
+typedef struct lockstep_group_s
+{
+    register_set_soa_t reg;
+    uint8_t (*memory)[Z6502_LOCKSTEP_LANES];    /* Interleaved memory spaces, memory[addr][lane] */
+    memory_t* lane_memory;                      /* View of one lane as a memory space, for instructions run lane by lane */
+    device_t lane_device[Z6502_LOCKSTEP_LANES]; /* Accessors backing lane_memory */
+    uint16_t program_counter;                   /* Shared by the lanes in lockstep */
+    uint32_t active;                            /* Lanes still in lockstep */
+    unsigned int lead;                          /* Lowest active lane, reference for the others */
+    uint64_t cycles;                            /* Cycles executed in lockstep */
+    uint8_t halted;                             /* Active lanes stopped on an unhandled opcode */
+} lockstep_group_t;
+
+/*Instance that left its lockstep group and runs on its own*/
+typedef struct
+{
+    Z6502* cpu;                 /* NULL while the lane runs in lockstep */
+    uint8_t* memory_space;      /* Memory of cpu */
+    uint64_t cycles;            /* Cycles executed in lockstep before leaving */
+} lockstep_lane_t;
+
+class Z6502Lockstep
+{
+private:
+    /*Groups of Z6502_LOCKSTEP_LANES instances*/
+    lockstep_group_t* _group;
+    unsigned int _group_count;
+
+    /*Instances*/
+    lockstep_lane_t* _lane;
+    unsigned int _lane_count;
+
+    /*Vector unit available, lanes run on scalar instances otherwise*/
+    uint8_t _simd;
+
+    /*Core of the scalar instances*/
+    core_t _core;
+
+    /**
+     * @brief Move a lane out of its group onto a scalar Z6502 instance
+     * @param lane Lane index
+     * @returns 0 on success, -1 if out of memory
+     */
+    int _leave(unsigned int lane);
+
+public:
+    /**
+     * @brief Create instances that all start from the same memory image
+     * @param lane_count Number of instances
+     * @param memory_image 64 KiB initial memory of every instance, NULL for zeros.
+     *        get_lane_count() is 0 if memory could not be allocated.
+     */
+    Z6502Lockstep(unsigned int lane_count, const uint8_t* memory_image);
+
+    /**
+     * @brief Get the number of instances
+     */
+    unsigned int get_lane_count(void){
+        return _lane_count;
+    }
+
+    /**
+     * @brief Select the core of instances that left lockstep
+     * @param core Interpreter core
+     */
+    void set_core(core_t core);
+
+    /**
+     * @brief Read a byte of an instance memory space
+     * @param lane Instance
+     * @param addr Address
+     */
+    uint8_t read_memory(unsigned int lane, uint16_t addr);
+
+    /**
+     * @brief Write a byte of an instance memory space, e.g. its input parameters
+     * @param lane Instance
+     * @param addr Address
+     * @param value Value
+     */
+    void write_memory(unsigned int lane, uint16_t addr, uint8_t value);
+
+    /**
+     * @brief Copy registers and flags of an instance to an architectural register set
+     * @param lane Instance
+     * @param register_set Target register set
+     * @returns register_set
+     */
+    register_set_t* dump_register(unsigned int lane, register_set_t* register_set);
+
+    /**
+     * @brief Load registers and flags of an instance. Instances whose program
+     *        counter differs from the rest of their group leave lockstep on the next run().
+     * @param lane Instance
+     * @param register_set Source register set
+     */
+    void load_register(unsigned int lane, const register_set_t* register_set);
+
+    /**
+     * @brief Run every instance for a cycle budget. Each instance executes
+     *        exactly what Z6502::run() would with the same budget under
+     *        TIMING_FAST, the only timing lockstep groups count.
+     * @param cycle_budget number of clock cycles to execute
+     * @returns number of instances still in lockstep
+     */
+    unsigned int run(uint64_t cycle_budget);
+
+    /**
+     * @brief Get total number of clock cycles executed by an instance
+     * @param lane Instance
+     */
+    uint64_t get_cycles(unsigned int lane);
+
+    /**
+     * @brief Instance stopped on an unhandled opcode
+     * @param lane Instance
+     * @returns TRUE if halted, FALSE otherwise
+     */
+    uint8_t is_halted(unsigned int lane);
+
+    /**
+     * @brief Instance still runs in lockstep with its group
+     * @param lane Instance
+     * @returns TRUE in lockstep, FALSE on its own Z6502
+     */
+    uint8_t in_lockstep(unsigned int lane);
+
+    /**
+     * @brief Z6502Lockstep destructor
+     */
+    ~Z6502Lockstep();
+};
+
+#endif // Z6502_LOCKSTEP_H_INCLUDED
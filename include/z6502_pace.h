@@ -0,0 +1,125 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_PACE_H_INCLUDED
+#define Z6502_PACE_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include "z6502.h"
+
+/*Default emulated time run between two clock checks*/
+#define Z6502_PACE_DEFAULT_SLICE_MICROSECONDS 1000U
+
+/*Falling further behind than this, the pacer stops trying to catch up*/
+#define Z6502_PACE_MAX_LAG_MICROSECONDS 100000U
+
+/*Totals since attach()*/
+typedef struct
+{
+    uint64_t cycles;            /* Cycles run by run() */
+    uint64_t slices;            /* Slices run */
+    double seconds;             /* Wall clock time spent in run() */
+    double achieved_frequency;  /* cycles / seconds, in Hz */
+    uint64_t overruns;          /* Slices that finished after their deadline */
+    uint64_t resyncs;           /* Times the schedule was moved forward, more than Z6502_PACE_MAX_LAG_MICROSECONDS behind */
+    int64_t drift_ns;           /* Wall clock ahead of emulated time when the last run() returned, negative if behind */
+    uint64_t jitter_max_ns;     /* Latest wake up after a deadline */
+    uint64_t jitter_mean_ns;    /* Mean wake up lateness over the slices that waited */
+} pace_stats_t;
+
+/*Runs a Z6502 at a real clock frequency. run() executes slices of emulated
+  time with Z6502::run() and waits after each one until the monotonic clock
+  reaches the time the slice ends at. Deadlines are absolute, counted from
+  the start of run(), so errors do not add up. Waits sleep until shortly
+  before the deadline and spin the rest; the margin follows how late the
+  sleeps of this host wake up.*/
+class Z6502Pacer
+{
+private:
+    Z6502* _cpu;
+    uint64_t _frequency;
+    uint64_t _slice_cycles;
+
+    /*Set by stop(), checked between slices*/
+    std::atomic<uint8_t> _stopping;
+
+    /*Sleeps end this long before a deadline, the rest is spun*/
+    int64_t _spin_ns;
+
+    pace_stats_t _stats;
+    uint64_t _waits;
+    uint64_t _jitter_total_ns;
+
+    /**
+     * @brief Emulated time of a number of cycles
+     */
+    int64_t _cycles_to_ns(uint64_t cycles);
+
+    /**
+     * @brief Wait until the monotonic clock reaches a time
+     * @param deadline Time, in steady_clock nanoseconds
+     * @returns Time the wait ended at
+     */
+    int64_t _wait_until(int64_t deadline);
+
+public:
+    /**
+     * @brief Create a detached pacer
+     */
+    Z6502Pacer();
+
+    /**
+     * @brief Pace an instance and clear the totals
+     * @param cpu Instance
+     * @param frequency Emulated clock, in Hz
+     * @param slice_microseconds Emulated time run between two clock checks.
+     *        Shorter slices lower the jitter seen from outside, longer
+     *        ones lower the cost of pacing.
+     * @returns 0 on success, -1 if the frequency or the slice is 0 or a slice is less than a cycle
+     */
+    int attach(Z6502* cpu, uint64_t frequency, uint32_t slice_microseconds = Z6502_PACE_DEFAULT_SLICE_MICROSECONDS);
+
+    /**
+     * @brief Run at the emulated clock until the cycle budget is spent or
+     *        the instance stops on its own (halt, breakpoint, Z6502::stop())
+     * @param cycle_budget Cycles to run
+     * @returns Cycles spent
+     */
+    uint64_t run(uint64_t cycle_budget);
+
+    /**
+     * @brief Make run() return after the current slice. May be called from
+     *        another thread or a signal handler.
+     */
+    void stop(void){
+        _stopping.store(TRUE, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the totals since attach()
+     */
+    void get_stats(pace_stats_t* stats){
+        *stats = _stats;
+    }
+
+    /**
+     * @brief Print the achieved frequency, overruns, drift and jitter
+     * @param out Output stream
+     */
+    void print_summary(FILE* out);
+};
+
+#endif // Z6502_PACE_H_INCLUDED
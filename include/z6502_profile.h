@@ -0,0 +1,143 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_PROFILE_H_INCLUDED
+#define Z6502_PROFILE_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include "z6502.h"
+
+/*Executions and cycles of one opcode or one address*/
+typedef struct
+{
+    uint16_t address;           /* Instruction address, 0 for opcode entries */
+    uint8_t opcode;             /* Opcode, last one executed at address for address entries */
+    uint64_t count;             /* Executions */
+    uint64_t cycles;            /* Cycles, as counted by the CPU timing (see Z6502::set_timing()) */
+} profile_entry_t;
+
+/*Execution profile fed by one or more Z6502 (see Z6502::set_profiler()).
+  Holds about 1 MiB of counters, allocate it with new.*/
+class Z6502Profiler
+{
+private:
+    /*Per opcode*/
+    uint64_t _opcode_count[256];
+    uint64_t _opcode_cycles[256];
+
+    /*Per instruction address*/
+    uint64_t _address_count[Z6502_MAX_MEMORY_SIZE_BYTES];
+    uint64_t _address_cycles[Z6502_MAX_MEMORY_SIZE_BYTES];
+    uint8_t _address_opcode[Z6502_MAX_MEMORY_SIZE_BYTES];
+
+    /**
+     * @brief Sort entries by cycles, most first, and keep the first ones
+     * @param entries Candidates, sorted in place
+     * @param count Number of candidates
+     * @param max Entries to keep
+     * @returns Entries kept
+     */
+    static unsigned int _top(profile_entry_t* entries, unsigned int count, unsigned int max);
+
+public:
+    /**
+     * @brief Create an empty profile
+     */
+    Z6502Profiler();
+
+    /**
+     * @brief Clear all counters
+     */
+    void clear(void);
+
+    /**
+     * @brief Count one instruction. Called by the CPU.
+     * @param address Instruction address
+     * @param opcode Opcode
+     * @param cycles Cycles the instruction took
+     */
+    inline void count(uint16_t address, uint8_t opcode, uint8_t cycles){
+        _opcode_count[opcode]++;
+        _opcode_cycles[opcode] += cycles;
+        _address_count[address]++;
+        _address_cycles[address] += cycles;
+        _address_opcode[address] = opcode;
+    }
+
+    /**
+     * @brief Get total number of instructions counted
+     */
+    uint64_t get_instruction_count(void);
+
+    /**
+     * @brief Get total number of cycles counted
+     */
+    uint64_t get_cycle_count(void);
+
+    /**
+     * @brief Get executions and cycles of an opcode
+     * @param opcode Opcode
+     * @param entry Counters of the opcode
+     */
+    void get_opcode(uint8_t opcode, profile_entry_t* entry);
+
+    /**
+     * @brief Get executions and cycles of the instruction at an address
+     * @param address Instruction address
+     * @param entry Counters of the address
+     */
+    void get_address(uint16_t address, profile_entry_t* entry);
+
+    /**
+     * @brief Get the opcodes that took the most cycles
+     * @param entries Output, max entries long
+     * @param max Number of entries wanted
+     * @returns Number of entries filled, fewer if fewer opcodes ran
+     */
+    unsigned int get_hot_opcodes(profile_entry_t* entries, unsigned int max);
+
+    /**
+     * @brief Get the instruction addresses that took the most cycles
+     * @param entries Output, max entries long
+     * @param max Number of entries wanted
+     * @returns Number of entries filled, fewer if fewer addresses ran
+     */
+    unsigned int get_hot_spots(profile_entry_t* entries, unsigned int max);
+
+    /**
+     * @brief Print the totals, hottest addresses and hottest opcodes
+     * @param out Output stream
+     * @param max Number of addresses and opcodes to list
+     */
+    void print_summary(FILE* out, unsigned int max);
+
+    /**
+     * @brief Export every opcode and address that ran as CSV:
+     *        kind,address,opcode,mnemonic,count,cycles
+     * @param filename Output file name
+     * @returns 0 on success, -1 if the file cannot be written
+     */
+    int export_csv(const char* filename);
+
+    /**
+     * @brief Export every opcode and address that ran as JSON:
+     *        {"instructions", "cycles", "opcodes": [...], "addresses": [...]}
+     * @param filename Output file name
+     * @returns 0 on success, -1 if the file cannot be written
+     */
+    int export_json(const char* filename);
+};
+
+#endif // Z6502_PROFILE_H_INCLUDED
@@ -0,0 +1,177 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_REPLAY_H_INCLUDED
+#define Z6502_REPLAY_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "z6502.h"
+
+/*Default cycles between two checkpoints*/
+#define Z6502_REPLAY_DEFAULT_INTERVAL 10000000U
+
+/*Checkpoint taken while recording*/
+typedef struct
+{
+    z6502_snapshot_t* snapshot; /* Registers and memory, pages shared with the other checkpoints */
+    uint64_t cycles;            /* Cycle count of the snapshot */
+    uint64_t instructions;      /* Instruction count of the snapshot */
+    size_t read;                /* Device reads logged before it */
+    size_t interrupt;           /* Interrupts logged before it */
+} replay_checkpoint_t;
+
+/*Deterministic record and replay of a Z6502. Recording logs what the CPU
+  cannot compute by itself: values returned by device reads and the cycle
+  counts interrupts were taken at, and takes a checkpoint every interval.
+  Replay runs a separate instance from the nearest checkpoint, serving
+  device reads from the log and dropping device writes, so seeking costs
+  at most one interval of execution. Positions are cycle counts, which
+  identify instruction boundaries: every instruction takes at least two cycles.
+  They are not instruction counts: an interrupt entry is not an instruction,
+  so the boundaries before and after it share one instruction count, and
+  interrupts are logged at the cycle count they are taken at. The
+  instruction count of a position is get_cpu()->get_instructions(), and
+  seek_instruction() moves to the first boundary with a given count.
+  Memory written from outside the CPU while recording is not logged.*/
+class Z6502Replay
+{
+private:
+    /*Inputs of the recorded run*/
+    struct replay_s* _log;
+    std::vector<replay_checkpoint_t> _checkpoint;
+    uint64_t _interval;
+
+    /*Instance being recorded, NULL when not recording*/
+    Z6502* _recorded;
+
+    /*Cycle count recording stopped at*/
+    uint64_t _end;
+
+    /*Replaying instance, created by record(), and next interrupt it takes*/
+    Z6502* _cpu;
+    size_t _next_interrupt;
+
+    /**
+     * @brief Snapshot the recorded instance
+     * @returns 0 on success, -1 if out of memory
+     */
+    int _take_checkpoint(void);
+
+    /**
+     * @brief Replay up to the first instruction boundary at or after a cycle count
+     * @param cycles Cycle count, not past the end of the recording
+     */
+    void _advance(uint64_t cycles);
+
+    /**
+     * @brief Drop the log, the checkpoints and the replaying instance
+     */
+    void _clear(void);
+
+public:
+    /**
+     * @brief Create an empty recording
+     */
+    Z6502Replay();
+
+    /**
+     * @brief Start recording an instance from its current state. A previous
+     *        recording is dropped.
+     * @param cpu Instance, run with run() below until stop()
+     * @param checkpoint_interval Cycles between two checkpoints
+     * @returns 0 on success, -1 if already recording or out of memory
+     */
+    int record(Z6502* cpu, uint64_t checkpoint_interval = Z6502_REPLAY_DEFAULT_INTERVAL);
+
+    /**
+     * @brief Run the recorded instance, taking checkpoints on the way. Events,
+     *        interrupts and devices work as with Z6502::run().
+     * @param cycle_budget number of clock cycles to execute
+     * @returns number of clock cycles spent
+     */
+    uint64_t run(uint64_t cycle_budget);
+
+    /**
+     * @brief Stop recording, the instance runs unrecorded again. Must be
+     *        called before the recorded instance is deleted.
+     */
+    void stop(void);
+
+    /**
+     * @brief Get the cycle count recording started at
+     */
+    uint64_t get_start(void){
+        return _checkpoint.empty() ? 0U : _checkpoint.front().cycles;
+    }
+
+    /**
+     * @brief Get the cycle count of the end of the recording, the current
+     *        one of the recorded instance while recording
+     */
+    uint64_t get_end(void);
+
+    /**
+     * @brief Get the number of checkpoints taken
+     */
+    size_t get_checkpoint_count(void){
+        return _checkpoint.size();
+    }
+
+    /**
+     * @brief Move the replaying instance to the first instruction boundary at
+     *        or after a cycle count, from the nearest checkpoint before it
+     * @param cycles Cycle count, clamped to the recording
+     * @returns 0 on success, -1 if nothing was recorded or out of memory
+     */
+    int seek(uint64_t cycles);
+
+    /**
+     * @brief Move the replaying instance to the first instruction boundary
+     *        whose instruction count is a given one: right after that many
+     *        instructions, before any interrupt entry that follows
+     * @param instructions Instruction count, clamped to the recording
+     * @returns 0 on success, -1 if nothing was recorded
+     */
+    int seek_instruction(uint64_t instructions);
+
+    /**
+     * @brief Replay one instruction, or one interrupt entry
+     * @returns Cycles spent, -1 at the end of the recording or if nothing was recorded
+     */
+    int step(void);
+
+    /**
+     * @brief Go back one instruction, or one interrupt entry
+     * @returns 0 on success, -1 at the start of the recording or if nothing was recorded
+     */
+    int step_back(void);
+
+    /**
+     * @brief Get the replaying instance, to inspect its registers and memory.
+     *        It starts at the beginning of the recording and must only be
+     *        moved with seek(), step() and step_back().
+     * @returns Instance, NULL if nothing was recorded
+     */
+    Z6502* get_cpu(void){
+        return _cpu;
+    }
+
+    /**
+     * @brief Z6502Replay destructor, stops recording
+     */
+    ~Z6502Replay();
+};
+
+#endif // Z6502_REPLAY_H_INCLUDED
@@ -0,0 +1,167 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#ifndef Z6502_TRACE_H_INCLUDED
+#define Z6502_TRACE_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include "z6502.h"
+
+/*Trace file header: magic then format version*/
+#define Z6502_TRACE_MAGIC "Z6502TRC"
+#define Z6502_TRACE_VERSION 1U
+#define Z6502_TRACE_HEADER_BYTES 16U
+
+/*Default ring size in records, a power of two*/
+#define Z6502_TRACE_DEFAULT_RING 262144U
+
+/*One executed instruction, with the registers it started from*/
+typedef struct
+{
+    uint64_t cycles;            /* Cycles executed before the instruction */
+    uint16_t program_counter;
+    uint8_t opcode;
+    uint8_t operand[2];         /* Operand bytes, as many as instruction_mode[opcode] uses */
+    uint8_t accumulator;
+    uint8_t x;
+    uint8_t y;
+    uint8_t stack_pointer;
+    uint8_t status;             /* P register, NV1BDIZC */
+} trace_record_t;
+
+/*Instruction encoder state, the same on the writing and the reading side*/
+typedef struct
+{
+    trace_record_t previous;    /* Last record */
+    uint32_t code[Z6502_MAX_MEMORY_SIZE_BYTES]; /* Instruction bytes last seen per address, bit 24 set once seen */
+} trace_codec_t;
+
+/*Instruction tracer fed by one Z6502 (see Z6502::set_tracer()). The CPU
+  pushes records into a lock-free ring that a writer thread drains,
+  delta-encodes and writes to a file. The CPU only waits when the ring is full.*/
+class Z6502Tracer
+{
+private:
+    /*Ring of records, written by the CPU and read by the writer thread*/
+    trace_record_t* _ring;
+    uint64_t _ring_mask;
+    alignas(64) std::atomic<uint64_t> _head;    /* Next record written by the CPU */
+    uint64_t _free_until;                       /* CPU side copy of _tail + ring size */
+    alignas(64) std::atomic<uint64_t> _tail;    /* Next record read by the writer */
+
+    /*Writer thread*/
+    std::thread _writer;
+    std::atomic<uint8_t> _closing;
+    FILE* _file;
+    trace_codec_t* _codec;
+    uint8_t* _buffer;                           /* Encoded records waiting for fwrite() */
+    uint8_t _error;
+
+    /**
+     * @brief Writer thread: encode records as they come until closed
+     */
+    void _write_loop(void);
+
+public:
+    /**
+     * @brief Create a closed tracer
+     */
+    Z6502Tracer();
+
+    /**
+     * @brief Start tracing to a file
+     * @param filename Trace file name
+     * @param ring_records Ring size in records, rounded up to a power of two
+     * @returns 0 on success, -1 if the file or the ring cannot be created
+     */
+    int open(const char* filename, uint32_t ring_records = Z6502_TRACE_DEFAULT_RING);
+
+    /**
+     * @brief Write the records still in the ring and close the file
+     * @returns 0 on success, -1 if writing failed
+     */
+    int close(void);
+
+    /**
+     * @brief Tracer is writing to a file
+     */
+    uint8_t is_open(void){
+        return (_file != NULL) ? TRUE : FALSE;
+    }
+
+    /**
+     * @brief Get number of records pushed since open()
+     */
+    uint64_t get_record_count(void){
+        return _head.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Push a record, waiting while the ring is full. Called by the CPU.
+     * @param record Record
+     */
+    inline void push(const trace_record_t* record){
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        while(head == _free_until){
+            _free_until = _tail.load(std::memory_order_acquire) + _ring_mask + 1U;
+            if(head == _free_until){
+                std::this_thread::yield();
+            }
+        }
+        _ring[head & _ring_mask] = *record;
+        _head.store(head + 1U, std::memory_order_release);
+    }
+
+    /**
+     * @brief Z6502Tracer destructor, closes the trace
+     */
+    ~Z6502Tracer();
+};
+
+/*Trace file being decoded*/
+typedef struct
+{
+    FILE* file;
+    trace_codec_t codec;
+    uint64_t count;             /* Records read so far */
+    uint8_t buffer[65536];      /* Bytes read ahead from the file */
+    size_t length;              /* Bytes in buffer */
+    size_t position;            /* Next byte to decode */
+} trace_reader_t;
+
+/**
+ * @brief Open a trace file for decoding
+ * @param filename Trace file name
+ * @returns Reader to release with trace_reader_close(), NULL if the file cannot be read or is not a trace
+ */
+trace_reader_t* trace_reader_open(const char* filename);
+
+/**
+ * @brief Decode the next record
+ * @param reader Reader
+ * @param record Decoded record
+ * @returns 1 if a record was read, 0 at the end of the trace, -1 if the trace is truncated or corrupt
+ */
+int trace_reader_next(trace_reader_t* reader, trace_record_t* record);
+
+/**
+ * @brief Close a trace file
+ * @param reader Reader, may be NULL
+ */
+void trace_reader_close(trace_reader_t* reader);
+
+#endif // Z6502_TRACE_H_INCLUDED
@@ -0,0 +1,170 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    ALU regression check: NMOS decimal mode ADC/SBC vectors and the carry
+    of binary SBC and of the compares, run on every core. Exits with 0 when
+    every case matches, 1 otherwise.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "z6502.h"
+
+/*Program address, the case runs there ALU_CHECK_PASSES times, storing
+  the result and the flags of each pass, then ends on a jump to itself.
+  The passes outnumber the JIT hot threshold so the last ones run
+  translated on CORE_JIT*/
+#define ALU_CHECK_ADDRESS 0x0200U
+#define ALU_CHECK_END (ALU_CHECK_ADDRESS + 18U)
+#define ALU_CHECK_PASSES 64U
+#define ALU_CHECK_CYCLES 4096U
+/*Zero page result, flags and pass counter*/
+#define ALU_CHECK_RESULT 0x10U
+#define ALU_CHECK_FLAGS 0x11U
+#define ALU_CHECK_COUNTER 0x12U
+/*Flags pushed by PHP*/
+#define ALU_CHECK_CARRY 0x01U
+#define ALU_CHECK_ZERO 0x02U
+#define ALU_CHECK_OVERFLOW 0x40U
+#define ALU_CHECK_NEGATIVE 0x80U
+
+/*Flags compared, -1 for a flag left unchecked*/
+typedef struct
+{
+    const char* name;
+    uint8_t decimal;        /* SED before the operation */
+    uint8_t carry;          /* Carry in */
+    uint8_t load;           /* LDA, LDX or LDY immediate */
+    uint8_t operation;      /* ADC, SBC, CMP, CPX or CPY immediate */
+    uint8_t value;          /* Register loaded */
+    uint8_t operand;        /* Operand */
+    uint8_t result;         /* Expected accumulator */
+    int carry_out;
+    int zero;
+    int negative;
+    int overflow;
+} alu_case_t;
+
+#define LDA 0xA9U
+#define LDX 0xA2U
+#define LDY 0xA0U
+#define ADC 0x69U
+#define SBC 0xE9U
+#define CMP 0xC9U
+#define CPX 0xE0U
+#define CPY 0xC0U
+
+static const alu_case_t cases[] = {
+    /*Decimal ADC*/
+    {"ADC 12+34",           TRUE, 0U, LDA, ADC, 0x12U, 0x34U, 0x46U, 0, 0, 0, 0},
+    {"ADC 09+01",           TRUE, 0U, LDA, ADC, 0x09U, 0x01U, 0x10U, 0, 0, 0, 0},
+    {"ADC 58+46+1",         TRUE, 1U, LDA, ADC, 0x58U, 0x46U, 0x05U, 1, 0, -1, -1},
+    {"ADC 81+92",           TRUE, 0U, LDA, ADC, 0x81U, 0x92U, 0x73U, 1, 0, -1, -1},
+    {"ADC 99+01, Z binary", TRUE, 0U, LDA, ADC, 0x99U, 0x01U, 0x00U, 1, 0, 1, 0},
+    {"ADC 79+00+1, N V",    TRUE, 1U, LDA, ADC, 0x79U, 0x00U, 0x80U, 0, 0, 1, 1},
+    {"ADC 0F+00 invalid",   TRUE, 0U, LDA, ADC, 0x0FU, 0x00U, 0x15U, 0, 0, -1, -1},
+    /*Decimal SBC*/
+    {"SBC 46-12",           TRUE, 1U, LDA, SBC, 0x46U, 0x12U, 0x34U, 1, 0, 0, 0},
+    {"SBC 40-13",           TRUE, 1U, LDA, SBC, 0x40U, 0x13U, 0x27U, 1, 0, 0, 0},
+    {"SBC 32-02-1",         TRUE, 0U, LDA, SBC, 0x32U, 0x02U, 0x29U, 1, 0, 0, 0},
+    {"SBC 12-21",           TRUE, 1U, LDA, SBC, 0x12U, 0x21U, 0x91U, 0, 0, 1, 0},
+    {"SBC 21-34",           TRUE, 1U, LDA, SBC, 0x21U, 0x34U, 0x87U, 0, 0, 1, 0},
+    {"SBC 00-00",           TRUE, 1U, LDA, SBC, 0x00U, 0x00U, 0x00U, 1, 1, 0, 0},
+    /*Binary SBC carry: set when nothing was borrowed*/
+    {"SBC 00-00",           FALSE, 1U, LDA, SBC, 0x00U, 0x00U, 0x00U, 1, 1, 0, 0},
+    {"SBC 00-00-1",         FALSE, 0U, LDA, SBC, 0x00U, 0x00U, 0xFFU, 0, 0, 1, 0},
+    {"SBC 01-02",           FALSE, 1U, LDA, SBC, 0x01U, 0x02U, 0xFFU, 0, 0, 1, 0},
+    {"SBC 80-01",           FALSE, 1U, LDA, SBC, 0x80U, 0x01U, 0x7FU, 1, 0, 0, 1},
+    {"SBC FF-FF",           FALSE, 1U, LDA, SBC, 0xFFU, 0xFFU, 0x00U, 1, 1, 0, 0},
+    /*Compares are unsigned*/
+    {"CMP 80,7F",           FALSE, 0U, LDA, CMP, 0x80U, 0x7FU, 0x80U, 1, 0, 0, -1},
+    {"CMP 7F,80",           FALSE, 1U, LDA, CMP, 0x7FU, 0x80U, 0x7FU, 0, 0, 1, -1},
+    {"CMP 10,10",           FALSE, 0U, LDA, CMP, 0x10U, 0x10U, 0x10U, 1, 1, 0, -1},
+    {"CMP FF,00",           TRUE, 0U, LDA, CMP, 0xFFU, 0x00U, 0xFFU, 1, 0, 1, -1},
+    {"CPX 00,FF",           FALSE, 1U, LDX, CPX, 0x00U, 0xFFU, 0x00U, 0, 0, 0, -1},
+    {"CPX FF,00",           FALSE, 0U, LDX, CPX, 0xFFU, 0x00U, 0x00U, 1, 0, 1, -1},
+    {"CPY 01,02",           FALSE, 1U, LDY, CPY, 0x01U, 0x02U, 0x00U, 0, 0, 1, -1},
+    {"CPY 81,01",           FALSE, 0U, LDY, CPY, 0x81U, 0x01U, 0x00U, 1, 0, 1, -1},
+};
+
+static const core_t cores[] = {CORE_TABLE, CORE_SWITCH, CORE_CACHE, CORE_JIT};
+
+/**
+ * @brief Check a flag pushed by PHP
+ * @param flags Pushed flags
+ * @param mask Flag
+ * @param expected Expected value, -1 for a flag left unchecked
+ */
+static inline uint8_t _flag_matches(uint8_t flags, uint8_t mask, int expected){
+    return (expected < 0 || ((flags & mask) != 0U) == (expected != 0)) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Run one case on one core
+ * @returns 0 if the result and the flags match, -1 otherwise
+ */
+static int check_case(const alu_case_t* test, core_t core, uint8_t* memory){
+    uint8_t program[] = {
+        (uint8_t)(test->decimal == TRUE ? 0xF8U : 0xD8U),  /* SED or CLD */
+        (uint8_t)(test->carry != 0U ? 0x38U : 0x18U),      /* SEC or CLC */
+        0xA9U, 0x00U,                                       /* LDA #0, for compares with X or Y */
+        test->load, test->value,
+        test->operation, test->operand,
+        0x85U, ALU_CHECK_RESULT,                            /* STA result */
+        0x08U, 0x68U,                                       /* PHP; PLA */
+        0x85U, ALU_CHECK_FLAGS,                             /* STA flags */
+        0xC6U, ALU_CHECK_COUNTER,                           /* DEC counter */
+        0xD0U, (uint8_t)(ALU_CHECK_ADDRESS - ALU_CHECK_END),/* BNE to the start */
+        0x4CU, (uint8_t)ALU_CHECK_END, (uint8_t)(ALU_CHECK_END >> 8),
+    };
+    register_set_t reg;
+    uint8_t flags;
+
+    memset(memory, 0, Z6502_MAX_MEMORY_SIZE_BYTES);
+    memcpy(&memory[ALU_CHECK_ADDRESS], program, sizeof(program));
+    memory[ALU_CHECK_COUNTER] = ALU_CHECK_PASSES;
+    Z6502 cpu(memory);
+    cpu.set_core(core);
+    cpu.reset();
+    cpu.dump_register(&reg);
+    reg.program_counter = ALU_CHECK_ADDRESS;
+    cpu.load_register(&reg);
+    cpu.run(ALU_CHECK_CYCLES);
+    cpu.dump_register(&reg);
+    flags = memory[ALU_CHECK_FLAGS];
+
+    return (reg.program_counter == ALU_CHECK_END && memory[ALU_CHECK_RESULT] == test->result &&
+            _flag_matches(flags, ALU_CHECK_CARRY, test->carry_out) == TRUE &&
+            _flag_matches(flags, ALU_CHECK_ZERO, test->zero) == TRUE &&
+            _flag_matches(flags, ALU_CHECK_NEGATIVE, test->negative) == TRUE &&
+            _flag_matches(flags, ALU_CHECK_OVERFLOW, test->overflow) == TRUE) ? 0 : -1;
+}
+
+int main(void){
+    static uint8_t memory[Z6502_MAX_MEMORY_SIZE_BYTES];
+    unsigned int failed = 0U;
+
+    for(core_t core : cores){
+        for(const alu_case_t& test : cases){
+            if(check_case(&test, core, memory) < 0){
+                failed++;
+                printf("[  FAIL  ] %s: %s\n", core_get_name(core), test.name);
+            }
+        }
+    }
+    printf("%u cases on %zu cores, %u failed\n", (unsigned int)(sizeof(cases) / sizeof(cases[0])),
+           sizeof(cores) / sizeof(cores[0]), failed);
+    return (failed == 0U) ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "z6502_batch.h"
+
+static const char* status_tag[] = {"[  PASS  ]", "[  FAIL  ]", "[TIMEOUT ]", "[ ERROR  ]"};
+
+static void usage(const char* name){
+    fprintf(stderr, "Usage: %s [-j threads] [-c table|switch|cache|jit] [-q] manifest\n", name);
+    fprintf(stderr, "Manifest lines: ROM_file load_address entry|reset cycle_limit expected_pc|-\n");
+}
+
+int main(int argc, char** argv){
+    std::vector<batch_job_t> jobs;
+    std::vector<batch_result_t> results;
+    unsigned int thread_count = 0U;
+    unsigned int count[4] = {0U, 0U, 0U, 0U};
+    core_t core = CORE_JIT;
+    uint8_t quiet = FALSE;
+    const char* manifest = NULL;
+    uint64_t cycles = 0U;
+    uint64_t instructions = 0U;
+    double seconds;
+    int result;
+
+    /*Parse arguments*/
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-j") == 0 && i + 1 < argc){
+            thread_count = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            if(core_parse_name(argv[++i], &core) < 0){
+                fprintf(stderr, "[ ERROR  ] Unknown core %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if(strcmp(argv[i], "-q") == 0){
+            quiet = TRUE;
+        }
+        else if(argv[i][0] != '-' && manifest == NULL){
+            manifest = argv[i];
+        }
+        else{
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if(manifest == NULL){
+        usage(argv[0]);
+        return -1;
+    }
+
+    /*Load jobs*/
+    result = batch_load_manifest(manifest, &jobs);
+    if(result < 0){
+        fprintf(stderr, "[ ERROR  ] Could not read manifest %s\n", manifest);
+        return -1;
+    }
+    if(result > 0){
+        fprintf(stderr, "[ ERROR  ] %s:%d: bad job line\n", manifest, result);
+        return -1;
+    }
+    if(thread_count == 0U){
+        thread_count = std::thread::hardware_concurrency();
+    }
+
+    /*Run*/
+    auto start = std::chrono::steady_clock::now();
+    batch_run(jobs, &results, thread_count, core);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    /*Report*/
+    for(size_t i = 0U; i < jobs.size(); i++){
+        count[results[i].status]++;
+        cycles += results[i].cycles;
+        instructions += results[i].instructions;
+        if(quiet == TRUE && results[i].status == BATCH_PASS){
+            continue;
+        }
+        printf("%s #%zu %s pc=$%04X cycles=%llu instructions=%llu (%.3f s)\n", status_tag[results[i].status], i, jobs[i].rom.c_str(),
+               results[i].final_pc, (unsigned long long)results[i].cycles, (unsigned long long)results[i].instructions, results[i].seconds);
+        if(results[i].status == BATCH_ERROR){
+            printf("           %s\n", results[i].error.c_str());
+        }
+    }
+    printf("%zu jobs: %u passed, %u failed, %u timed out, %u errors\n", jobs.size(),
+           count[BATCH_PASS], count[BATCH_FAIL], count[BATCH_TIMEOUT], count[BATCH_ERROR]);
+    printf("%llu instructions, %llu cycles in %.3f s on %u threads (%.1f MIPS, %.1f Mcycles/s)\n",
+           (unsigned long long)instructions, (unsigned long long)cycles, seconds, thread_count,
+           seconds > 0.0 ? instructions / seconds / 1e6 : 0.0, seconds > 0.0 ? cycles / seconds / 1e6 : 0.0);
+
+    return (count[BATCH_PASS] == jobs.size()) ? 0 : 1;
+}
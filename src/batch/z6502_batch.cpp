@@ -0,0 +1,285 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Batch runner. Every job gets its own memory space and Z6502 instance so
+    jobs share nothing and can run on any worker thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "emulator_utility.h"
+#include "z6502_batch.h"
+
+/*Job queue of one worker*/
+typedef struct
+{
+    std::mutex lock;
+    std::deque<size_t> jobs;
+} batch_queue_t;
+
+//*****************************************************************************
+// Manifest
+//*****************************************************************************
+
+/**
+ * @brief Parse an address field
+ * @param field Hexadecimal address, with optional $ or 0x prefix
+ * @param addr Parsed address
+ * @returns 0 on success, -1 on error
+ */
+static int _batch_parse_address(const char* field, uint16_t* addr){
+    char* end;
+    unsigned long value;
+
+    if(field[0] == '$'){
+        field++;
+    }
+    value = strtoul(field, &end, 16);
+    if(end == field || *end != '\0' || value > 0xFFFFU){
+        return -1;
+    }
+    *addr = (uint16_t)value;
+    return 0;
+}
+
+int batch_load_manifest(const char* filename, std::vector<batch_job_t>* jobs){
+    char line[1024];
+    char rom[1024];
+    char load[32];
+    char entry[32];
+    char limit[32];
+    char expected[32];
+    char* end;
+    int line_number = 0;
+    batch_job_t job;
+
+    FILE* file = fopen(filename, "r");
+    if(file == NULL){
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL){
+        line_number++;
+        if(sscanf(line, " %1023s", rom) != 1 || rom[0] == '#'){
+            continue;
+        }
+        if(sscanf(line, " %1023s %31s %31s %31s %31s", rom, load, entry, limit, expected) != 5){
+            fclose(file);
+            return line_number;
+        }
+
+        job.rom = rom;
+        job.reset_entry = (strcasecmp(entry, "reset") == 0) ? TRUE : FALSE;
+        job.entry = 0U;
+        job.check_pc = (strcmp(expected, "-") != 0) ? TRUE : FALSE;
+        job.expected_pc = 0U;
+        job.cycle_limit = strtoull(limit, &end, 10);
+        if(_batch_parse_address(load, &job.load_address) < 0 ||
+           (job.reset_entry == FALSE && _batch_parse_address(entry, &job.entry) < 0) ||
+           (job.check_pc == TRUE && _batch_parse_address(expected, &job.expected_pc) < 0) ||
+           end == limit || *end != '\0'){
+            fclose(file);
+            return line_number;
+        }
+        jobs->push_back(job);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+//*****************************************************************************
+// Jobs
+//*****************************************************************************
+
+void batch_run_job(const batch_job_t* job, core_t core, batch_result_t* result){
+    auto start = std::chrono::steady_clock::now();
+    rom_status_t status;
+    register_set_t reg;
+    uint8_t* memory_space;
+    uint64_t slice = BATCH_MIN_SLICE_CYCLES;
+    uint64_t left;
+    uint16_t pc;
+    uint8_t trapped = FALSE;
+
+    result->final_pc = 0U;
+    result->cycles = 0U;
+    result->instructions = 0U;
+    result->seconds = 0.0;
+
+    memory_space = (uint8_t*)calloc(Z6502_MAX_MEMORY_SIZE_BYTES, sizeof(uint8_t));
+    if(memory_space == NULL){
+        result->status = BATCH_ERROR;
+        result->error = "out of memory";
+        return;
+    }
+    if(rom_load(job->rom.c_str(), ROM_FORMAT_AUTO, job->load_address, memory_space, Z6502_MAX_MEMORY_SIZE_BYTES, NULL, &status) < 0){
+        free(memory_space);
+        result->status = BATCH_ERROR;
+        result->error = status.message;
+        return;
+    }
+
+    Z6502 cpu(memory_space);
+    cpu.set_core(core);
+    cpu.reset();
+    cpu.dump_register(&reg);
+    if(job->reset_entry == TRUE){
+        reg.program_counter = memory_space[Z6502_RESET_VECTOR_ADDRESS] | (memory_space[Z6502_RESET_VECTOR_ADDRESS + 1U] << 8);
+    }
+    else{
+        reg.program_counter = job->entry;
+    }
+    cpu.load_register(&reg);
+
+    while(cpu.get_cycles() < job->cycle_limit){
+        left = job->cycle_limit - cpu.get_cycles();
+        cpu.run(left < slice ? left : slice);
+        if(slice < BATCH_MAX_SLICE_CYCLES){
+            slice *= 2U;
+        }
+
+        /*A trap is an instruction that does not move the program counter:
+          a jump or taken branch to itself, or an unhandled opcode*/
+        if(cpu.is_halted() == TRUE){
+            trapped = TRUE;
+            break;
+        }
+        if(cpu.get_cycles() + BATCH_TRAP_CHECK_CYCLES > job->cycle_limit){
+            break;
+        }
+        pc = cpu.dump_register(&reg)->program_counter;
+        cpu.step();
+        if(cpu.dump_register(&reg)->program_counter == pc){
+            trapped = TRUE;
+            break;
+        }
+    }
+
+    result->final_pc = cpu.dump_register(&reg)->program_counter;
+    result->cycles = cpu.get_cycles();
+    result->instructions = cpu.get_instructions();
+    if(trapped == FALSE){
+        result->status = BATCH_TIMEOUT;
+    }
+    else if(job->check_pc == TRUE && result->final_pc != job->expected_pc){
+        result->status = BATCH_FAIL;
+    }
+    else{
+        result->status = BATCH_PASS;
+    }
+
+    free(memory_space);
+    result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//*****************************************************************************
+// Worker pool
+//*****************************************************************************
+
+/**
+ * @brief Take a job from the front of a queue
+ * @returns TRUE if a job was taken
+ */
+static uint8_t _batch_pop(batch_queue_t* queue, size_t* job){
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if(queue->jobs.empty()){
+        return FALSE;
+    }
+    *job = queue->jobs.front();
+    queue->jobs.pop_front();
+    return TRUE;
+}
+
+/**
+ * @brief Take a job from the back of another worker's queue
+ * @returns TRUE if a job was taken
+ */
+static uint8_t _batch_steal(batch_queue_t* queue, size_t* job){
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if(queue->jobs.empty()){
+        return FALSE;
+    }
+    *job = queue->jobs.back();
+    queue->jobs.pop_back();
+    return TRUE;
+}
+
+/**
+ * @brief Worker thread. No job is added once workers run, so a worker
+ *        leaves when its own queue and all the others are empty.
+ */
+static void _batch_worker(unsigned int id, std::vector<batch_queue_t>* queues, const std::vector<batch_job_t>* jobs,
+                          std::vector<batch_result_t>* results, core_t core){
+    unsigned int count = queues->size();
+    uint8_t found;
+    size_t job;
+
+    for(;;){
+        found = _batch_pop(&(*queues)[id], &job);
+        for(unsigned int i = 1U; i < count && found == FALSE; i++){
+            found = _batch_steal(&(*queues)[(id + i) % count], &job);
+        }
+        if(found == FALSE){
+            return;
+        }
+        batch_run_job(&(*jobs)[job], core, &(*results)[job]);
+    }
+}
+
+void batch_run(const std::vector<batch_job_t>& jobs, std::vector<batch_result_t>* results, unsigned int thread_count, core_t core){
+    std::vector<std::thread> workers;
+    std::vector<rom_image_t*> images;
+
+    if(thread_count == 0U){
+        thread_count = std::thread::hardware_concurrency();
+    }
+    if(thread_count == 0U){
+        thread_count = 1U;
+    }
+    if(thread_count > jobs.size() && jobs.size() > 0U){
+        thread_count = jobs.size();
+    }
+
+    results->assign(jobs.size(), batch_result_t());
+    std::vector<batch_queue_t> queues(thread_count);
+
+    /*Keep every ROM mapped for the run, jobs then share the mapping instead
+      of reading the file again. Files that fail are reported by their jobs*/
+    for(const auto& job : jobs){
+        images.push_back(rom_image_open(job.rom.c_str(), NULL));
+    }
+
+    /*Deal jobs round robin so that neighbouring heavy jobs spread out*/
+    for(size_t i = 0U; i < jobs.size(); i++){
+        queues[i % thread_count].jobs.push_back(i);
+    }
+
+    for(unsigned int i = 0U; i < thread_count; i++){
+        workers.emplace_back(_batch_worker, i, &queues, &jobs, results, core);
+    }
+    for(auto& worker : workers){
+        worker.join();
+    }
+    for(auto image : images){
+        rom_image_close(image);
+    }
+}
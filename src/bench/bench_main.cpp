@@ -0,0 +1,312 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Interpreter benchmark. Every workload is a small 6502 program looping
+    forever from $0400. It is run on each core for a fixed cycle budget,
+    after a warm-up run that fills the instruction cache and the JIT.
+    Instructions per second come from the instruction count of the
+    measured runs.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <vector>
+#include "z6502.h"
+
+/*Start address of every workload*/
+#define BENCH_ENTRY 0x0400U
+
+/*Built-in workload*/
+typedef struct
+{
+    const char* name;
+    const char* description;
+    const uint8_t* code;        /* Program loaded at BENCH_ENTRY */
+    size_t size;
+    void (*setup)(uint8_t* memory);  /* Data the program works on, may be NULL */
+} bench_workload_t;
+
+/*Result of one workload on one core*/
+typedef struct
+{
+    double median;              /* Cycles per second */
+    double minimum;
+    double maximum;
+    double deviation;           /* Standard deviation */
+    double ipc;                 /* Instructions per cycle of the measured runs */
+} bench_result_t;
+
+/* LDA #0; loop: CLC; ADC #7; EOR #$5A; ASL A; AND #$7F; ORA #1; LSR A; INX; BNE loop; INY; JMP loop */
+static const uint8_t alu_code[] = {
+    0xA9, 0x00, 0x18, 0x69, 0x07, 0x49, 0x5A, 0x0A, 0x29, 0x7F, 0x09, 0x01, 0x4A, 0xE8, 0xD0, 0xF2,
+    0xC8, 0x4C, 0x02, 0x04,
+};
+
+/* Copy 16 pages from $2000 to $3000 with LDA ($10),Y / STA ($12),Y, then start over */
+static const uint8_t copy_code[] = {
+    0xA9, 0x00, 0x85, 0x10, 0x85, 0x12, 0xA9, 0x20, 0x85, 0x11, 0xA9, 0x30, 0x85, 0x13, 0xA2, 0x10,
+    0xA0, 0x00, 0xB1, 0x10, 0x91, 0x12, 0xC8, 0xD0, 0xF9, 0xE6, 0x11, 0xE6, 0x13, 0xCA, 0xD0, 0xF2,
+    0x4C, 0x00, 0x04,
+};
+
+/* For each of the 128 pointers at $0200, sum 16 bytes with ADC ($20),Y into $0300,X */
+static const uint8_t table_code[] = {
+    0xA2, 0x00, 0xBD, 0x00, 0x02, 0x85, 0x20, 0xBD, 0x01, 0x02, 0x85, 0x21, 0xA0, 0x0F, 0xA9, 0x00,
+    0x18, 0x71, 0x20, 0x88, 0x10, 0xFB, 0x9D, 0x00, 0x03, 0xE8, 0xE8, 0xD0, 0xE5, 0x4C, 0x00, 0x04,
+};
+
+/* Binary recursion 10 levels deep: rec: DEX; BEQ leaf; JSR rec; JSR rec; INX; RTS; leaf: INX; INC $30; RTS */
+static const uint8_t recursion_code[] = {
+    0xA2, 0x0A, 0x20, 0x08, 0x04, 0x4C, 0x00, 0x04, 0xCA, 0xF0, 0x08, 0x20, 0x08, 0x04, 0x20, 0x08,
+    0x04, 0xE8, 0x60, 0xE8, 0xE6, 0x30, 0x60,
+};
+
+/* Fill 32 bytes at $0200 from a pseudo-random sequence, bubble sort them
+   in 31 passes with CMP / BCC and swaps, then start over */
+static const uint8_t sort_code[] = {
+    0xA2, 0x1F, 0xA5, 0x40, 0x0A, 0x0A, 0x18, 0x65, 0x40, 0x69, 0x11, 0x85, 0x40, 0x9D, 0x00, 0x02,
+    0xCA, 0x10, 0xEF, 0xA0, 0x1F, 0xA2, 0x00, 0xBD, 0x00, 0x02, 0xDD, 0x01, 0x02, 0x90, 0x0B, 0x48,
+    0xBD, 0x01, 0x02, 0x9D, 0x00, 0x02, 0x68, 0x9D, 0x01, 0x02, 0xE8, 0xE0, 0x1F, 0xD0, 0xE8, 0x88,
+    0xD0, 0xE3, 0x4C, 0x00, 0x04,
+};
+
+/**
+ * @brief Source pages of the copy workload
+ */
+static void copy_setup(uint8_t* memory){
+    for(unsigned int i = 0U; i < 0x1000U; i++){
+        memory[0x2000U + i] = (uint8_t)(i * 7U + (i >> 8));
+    }
+}
+
+/**
+ * @brief Pointer table and data of the table walk workload
+ */
+static void table_setup(uint8_t* memory){
+    uint16_t pointer;
+    for(unsigned int i = 0U; i < 128U; i++){
+        pointer = 0x4000U + ((i * 37U) % 128U) * 31U;
+        memory[0x0200U + 2U * i] = pointer & 0xFFU;
+        memory[0x0201U + 2U * i] = pointer >> 8;
+    }
+    for(unsigned int i = 0U; i < 0x1000U; i++){
+        memory[0x4000U + i] = (uint8_t)(i * 13U + 5U);
+    }
+}
+
+static const bench_workload_t workloads[] = {
+    {"alu", "tight ALU loop", alu_code, sizeof(alu_code), NULL},
+    {"copy", "4 KiB memory copy, indirect indexed", copy_code, sizeof(copy_code), copy_setup},
+    {"table", "pointer table walk, indirect indexed", table_code, sizeof(table_code), table_setup},
+    {"recursion", "JSR/RTS binary recursion", recursion_code, sizeof(recursion_code), NULL},
+    {"sort", "branch heavy bubble sort", sort_code, sizeof(sort_code), NULL},
+};
+
+/*Cores compared by default, in this order*/
+static const core_t cores[] = {CORE_TABLE, CORE_SWITCH, CORE_CACHE, CORE_JIT};
+
+static void usage(const char* name){
+    fprintf(stderr, "Usage: %s [-w workload] [-c core] [-n cycles] [-r repeats] [-a] [-l]\n", name);
+    fprintf(stderr, "  -w workload  Run this workload only, may be repeated (default all)\n");
+    fprintf(stderr, "  -c core      table, switch, cache or jit, may be repeated (default all)\n");
+    fprintf(stderr, "  -n cycles    Cycles per measured run (default 50000000)\n");
+    fprintf(stderr, "  -r repeats   Measured runs per workload and core (default 5)\n");
+    fprintf(stderr, "  -a           Accurate timing, with branch and page crossing penalties\n");
+    fprintf(stderr, "  -l           List the workloads\n");
+}
+
+/**
+ * @brief Create a CPU at the workload entry point
+ * @param workload Workload
+ * @param memory 64 KiB memory space, overwritten
+ */
+static Z6502* bench_load(const bench_workload_t* workload, timing_t timing, uint8_t* memory){
+    Z6502* cpu;
+    register_set_t reg;
+
+    memset(memory, 0, Z6502_MAX_MEMORY_SIZE_BYTES);
+    memcpy(&memory[BENCH_ENTRY], workload->code, workload->size);
+    if(workload->setup != NULL){
+        workload->setup(memory);
+    }
+    cpu = new (std::nothrow) Z6502(memory);
+    if(cpu != NULL){
+        cpu->reset();
+        cpu->dump_register(&reg);
+        reg.program_counter = BENCH_ENTRY;
+        reg.stack_pointer = 0xFFU;
+        cpu->load_register(&reg);
+        cpu->set_timing(timing);
+    }
+    return cpu;
+}
+
+/**
+ * @brief Run a workload on a core: one warm-up run then measured runs
+ * @returns 0 on success, -1 if out of memory or the workload halted
+ */
+static int bench_measure(const bench_workload_t* workload, core_t core, timing_t timing, uint8_t* memory,
+                         uint64_t cycles, unsigned int repeats, bench_result_t* result){
+    Z6502* cpu = bench_load(workload, timing, memory);
+    std::vector<double> rates;
+    double seconds;
+    double mean = 0.0;
+    uint64_t spent;
+    uint64_t first_cycles;
+    uint64_t first_instructions;
+
+    if(cpu == NULL){
+        return -1;
+    }
+    cpu->set_core(core);
+    cpu->run(cycles / 4U + 1U);
+    first_cycles = cpu->get_cycles();
+    first_instructions = cpu->get_instructions();
+
+    for(unsigned int i = 0U; i < repeats && cpu->is_halted() == FALSE; i++){
+        auto start = std::chrono::steady_clock::now();
+        spent = cpu->run(cycles);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rates.push_back(spent / (seconds > 0.0 ? seconds : 1e-9));
+    }
+    if(cpu->is_halted() == TRUE || rates.empty()){
+        delete cpu;
+        return -1;
+    }
+    result->ipc = (double)(cpu->get_instructions() - first_instructions) / (cpu->get_cycles() - first_cycles);
+    delete cpu;
+
+    std::sort(rates.begin(), rates.end());
+    result->median = (rates.size() % 2U == 1U) ? rates[rates.size() / 2U]
+                                               : (rates[rates.size() / 2U - 1U] + rates[rates.size() / 2U]) / 2.0;
+    result->minimum = rates.front();
+    result->maximum = rates.back();
+    for(double rate : rates){
+        mean += rate / rates.size();
+    }
+    result->deviation = 0.0;
+    for(double rate : rates){
+        result->deviation += (rate - mean) * (rate - mean) / rates.size();
+    }
+    result->deviation = sqrt(result->deviation);
+    return 0;
+}
+
+int main(int argc, char** argv){
+    std::vector<const bench_workload_t*> selected_workloads;
+    std::vector<core_t> selected_cores;
+    core_t core;
+    uint64_t cycles = 50000000U;
+    unsigned int repeats = 5U;
+    timing_t timing = TIMING_FAST;
+    bench_result_t result;
+    double reference;
+    uint8_t* memory;
+    uint8_t found;
+    int status = 0;
+
+    /*Parse arguments*/
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-w") == 0 && i + 1 < argc){
+            found = FALSE;
+            i++;
+            for(const auto& workload : workloads){
+                if(strcasecmp(argv[i], workload.name) == 0){
+                    selected_workloads.push_back(&workload);
+                    found = TRUE;
+                }
+            }
+            if(found == FALSE){
+                fprintf(stderr, "[ ERROR  ] Unknown workload %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            if(core_parse_name(argv[++i], &core) < 0){
+                fprintf(stderr, "[ ERROR  ] Unknown core %s\n", argv[i]);
+                return -1;
+            }
+            selected_cores.push_back(core);
+        }
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            cycles = strtoull(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc){
+            repeats = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "-a") == 0){
+            timing = TIMING_ACCURATE;
+        }
+        else if(strcmp(argv[i], "-l") == 0){
+            for(const auto& workload : workloads){
+                printf("%-10s %s\n", workload.name, workload.description);
+            }
+            return 0;
+        }
+        else{
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if(cycles == 0U || repeats == 0U){
+        usage(argv[0]);
+        return -1;
+    }
+    if(selected_workloads.empty()){
+        for(const auto& workload : workloads){
+            selected_workloads.push_back(&workload);
+        }
+    }
+    if(selected_cores.empty()){
+        selected_cores.assign(cores, cores + sizeof(cores) / sizeof(cores[0]));
+    }
+
+    memory = (uint8_t*)malloc(Z6502_MAX_MEMORY_SIZE_BYTES);
+    if(memory == NULL){
+        fprintf(stderr, "[CRITICAL] Memory allocation error\n");
+        return -1;
+    }
+
+    printf("%llu cycles per run, %u runs after warm-up, %s timing, median [min - max] +- deviation\n",
+           (unsigned long long)cycles, repeats, (timing == TIMING_ACCURATE) ? "accurate" : "fast");
+    printf("%-10s %-7s %10s %8s %9s %21s %8s %8s\n", "workload", "core", "Mcycles/s", "MIPS", "ns/instr",
+           "Mcycles/s range", "dev %", "speedup");
+    for(const bench_workload_t* workload : selected_workloads){
+        reference = 0.0;
+        for(core_t selected : selected_cores){
+            if(bench_measure(workload, selected, timing, memory, cycles, repeats, &result) < 0){
+                printf("%-10s %-7s failed\n", workload->name, core_get_name(selected));
+                status = -1;
+                continue;
+            }
+            if(reference == 0.0){
+                reference = result.median;
+            }
+            printf("%-10s %-7s %10.1f %8.1f %9.2f %9.1f - %9.1f %8.2f %7.2fx\n", workload->name, core_get_name(selected),
+                   result.median / 1e6, result.median * result.ipc / 1e6, 1e9 / (result.median * result.ipc),
+                   result.minimum / 1e6, result.maximum / 1e6, 100.0 * result.deviation / result.median,
+                   result.median / reference);
+        }
+    }
+
+    free(memory);
+    return status;
+}
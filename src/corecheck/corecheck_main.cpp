@@ -0,0 +1,212 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Core equivalence check: programs driven by devices run on every core,
+    which must take each interrupt and each stop on the same instruction and
+    end with the same registers, memory and counters. Exits with 0 when every core agrees, 1 otherwise.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "z6502.h"
+
+/*Program and interrupt handler addresses*/
+#define CORE_CHECK_ENTRY 0x0400U
+#define CORE_CHECK_HANDLER 0x0500U
+/*Device page*/
+#define CORE_CHECK_DEVICE_PAGE 0xD0U
+/*Cycles run per case, in slices of CORE_CHECK_SLICE_CYCLES*/
+#define CORE_CHECK_CYCLES 10000000U
+#define CORE_CHECK_SLICE_CYCLES 100000U
+/*Delay of the event scheduled by a trigger*/
+#define CORE_CHECK_EVENT_CYCLES 7U
+/*Triggers between two stop() calls*/
+#define CORE_CHECK_STOP_PERIOD 16U
+
+/*Device state. $D000 writes and $D002 reads trigger the case action,
+  $D001 reads release IRQ line 0, $D003 writes log the interrupted PC*/
+typedef struct check_device_s
+{
+    Z6502* cpu;
+    void (*trigger)(struct check_device_s* device);
+    uint32_t triggers;
+    uint32_t log_hash;
+} check_device_t;
+
+/*One case: a program at CORE_CHECK_ENTRY and the action of the device*/
+typedef struct
+{
+    const char* name;
+    const uint8_t* program;
+    size_t program_size;
+    void (*trigger)(check_device_t* device);
+} check_case_t;
+
+/*End state compared between cores*/
+typedef struct
+{
+    register_set_t reg;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint32_t triggers;
+    uint32_t log_hash;
+    uint32_t return_hash;       /* Cycles at which each run() returned */
+    uint32_t memory_hash;
+} check_state_t;
+
+static inline uint32_t _hash(uint32_t hash, uint32_t value){
+    return (hash ^ value) * 16777619U;
+}
+
+static uint8_t _device_read(void* context, uint16_t addr){
+    check_device_t* device = (check_device_t*)context;
+    if((addr & 0xFFU) == 0x01U){
+        device->cpu->release_irq(0U);
+    }
+    else if((addr & 0xFFU) == 0x02U){
+        device->triggers++;
+        device->trigger(device);
+    }
+    return (uint8_t)addr;
+}
+
+static void _device_write(void* context, uint16_t addr, uint8_t value){
+    check_device_t* device = (check_device_t*)context;
+    if((addr & 0xFFU) == 0x00U){
+        device->triggers++;
+        device->trigger(device);
+    }
+    else if((addr & 0xFFU) == 0x03U){
+        device->log_hash = _hash(device->log_hash, value);
+    }
+}
+
+static void _event_irq(Z6502* cpu, void* context, uint64_t deadline){
+    (void)context;
+    (void)deadline;
+    cpu->assert_irq(0U);
+}
+
+static void _raise_irq(check_device_t* device){
+    device->cpu->assert_irq(0U);
+}
+
+static void _raise_nmi(check_device_t* device){
+    device->cpu->trigger_nmi();
+}
+
+static void _schedule_irq(check_device_t* device){
+    (void)device->cpu->schedule_event(device->cpu->get_cycles() + CORE_CHECK_EVENT_CYCLES, _event_irq, device);
+}
+
+static void _request_stop(check_device_t* device){
+    if((device->triggers % CORE_CHECK_STOP_PERIOD) == 0U){
+        device->cpu->stop();
+    }
+}
+
+/* CLI; loop: STA $D000; INY; INY; INY; JMP loop */
+static const uint8_t store_program[] = {0x58, 0x8D, 0x00, 0xD0, 0xC8, 0xC8, 0xC8, 0x4C, 0x01, 0x04};
+/* CLI; loop: INC $D000; INY; INY; INY; JMP loop */
+static const uint8_t modify_program[] = {0x58, 0xEE, 0x00, 0xD0, 0xC8, 0xC8, 0xC8, 0x4C, 0x01, 0x04};
+/* CLI; loop: LDA $D002; INY; INY; INY; JMP loop */
+static const uint8_t load_program[] = {0x58, 0xAD, 0x02, 0xD0, 0xC8, 0xC8, 0xC8, 0x4C, 0x01, 0x04};
+/* PHA; TXA; PHA; TSX; LDA $0104,X; STA $D003; LDA $0105,X; STA $D003;
+   LDA $D001; INC $10; PLA; TAX; PLA; RTI. Logs the pushed PC, then acknowledges */
+static const uint8_t handler[] = {
+    0x48, 0x8A, 0x48, 0xBA, 0xBD, 0x04, 0x01, 0x8D, 0x03, 0xD0, 0xBD, 0x05, 0x01, 0x8D, 0x03, 0xD0,
+    0xAD, 0x01, 0xD0, 0xE6, 0x10, 0x68, 0xAA, 0x68, 0x40,
+};
+
+static const check_case_t cases[] = {
+    {"IRQ raised by a device write",        store_program,  sizeof(store_program),  _raise_irq},
+    {"IRQ raised by a read-modify-write",   modify_program, sizeof(modify_program), _raise_irq},
+    {"IRQ raised by a device read",         load_program,   sizeof(load_program),   _raise_irq},
+    {"NMI raised by a device write",        store_program,  sizeof(store_program),  _raise_nmi},
+    {"Event scheduled by a device write",   store_program,  sizeof(store_program),  _schedule_irq},
+    {"stop() called by a device write",     store_program,  sizeof(store_program),  _request_stop},
+};
+
+static const core_t cores[] = {CORE_TABLE, CORE_SWITCH, CORE_CACHE, CORE_JIT};
+
+/**
+ * @brief Run a case on a core
+ */
+static void run_case(const check_case_t* test, core_t core, uint8_t* memory, check_state_t* state){
+    check_device_t device = {NULL, test->trigger, 0U, 2166136261U};
+    device_t bus = {_device_read, _device_write, &device};
+    register_set_t reg;
+
+    memset(state, 0, sizeof(*state));
+    memset(memory, 0, Z6502_MAX_MEMORY_SIZE_BYTES);
+    memcpy(&memory[CORE_CHECK_ENTRY], test->program, test->program_size);
+    memcpy(&memory[CORE_CHECK_HANDLER], handler, sizeof(handler));
+    memory[Z6502_IRQ_VECTOR_ADDRESS] = (uint8_t)CORE_CHECK_HANDLER;
+    memory[Z6502_IRQ_VECTOR_ADDRESS + 1U] = (uint8_t)(CORE_CHECK_HANDLER >> 8);
+    memory[Z6502_NMI_VECTOR_ADDRESS] = (uint8_t)CORE_CHECK_HANDLER;
+    memory[Z6502_NMI_VECTOR_ADDRESS + 1U] = (uint8_t)(CORE_CHECK_HANDLER >> 8);
+
+    Z6502 cpu(memory);
+    device.cpu = &cpu;
+    cpu.set_core(core);
+    cpu.reset();
+    cpu.dump_register(&reg);
+    reg.program_counter = CORE_CHECK_ENTRY;
+    reg.stack_pointer = 0xFFU;
+    cpu.load_register(&reg);
+    cpu.map_device(CORE_CHECK_DEVICE_PAGE, 1U, &bus);
+    state->return_hash = 2166136261U;
+    while(cpu.get_cycles() < CORE_CHECK_CYCLES && cpu.is_halted() == FALSE){
+        cpu.run(CORE_CHECK_SLICE_CYCLES);
+        state->return_hash = _hash(state->return_hash, (uint32_t)cpu.get_cycles());
+    }
+
+    cpu.dump_register(&state->reg);
+    state->cycles = cpu.get_cycles();
+    state->instructions = cpu.get_instructions();
+    state->triggers = device.triggers;
+    state->log_hash = device.log_hash;
+    state->memory_hash = 2166136261U;
+    for(unsigned int address = 0U; address < 0x0200U; address++){
+        state->memory_hash = _hash(state->memory_hash, memory[address]);
+    }
+}
+
+int main(void){
+    static uint8_t memory[Z6502_MAX_MEMORY_SIZE_BYTES];
+    check_state_t reference;
+    check_state_t state;
+    unsigned int failed = 0U;
+
+    for(const check_case_t& test : cases){
+        run_case(&test, cores[0], memory, &reference);
+        for(unsigned int c = 1U; c < sizeof(cores) / sizeof(cores[0]); c++){
+            run_case(&test, cores[c], memory, &state);
+            if(memcmp(&state.reg, &reference.reg, sizeof(state.reg)) != 0 || state.cycles != reference.cycles ||
+               state.instructions != reference.instructions || state.triggers != reference.triggers ||
+               state.log_hash != reference.log_hash || state.return_hash != reference.return_hash ||
+               state.memory_hash != reference.memory_hash){
+                failed++;
+                printf("[  FAIL  ] %s: %s ends at PC=$%04X Y=$%02X cycles=%llu, %s at PC=$%04X Y=$%02X cycles=%llu\n",
+                       test.name, core_get_name(cores[c]), state.reg.program_counter, state.reg.y,
+                       (unsigned long long)state.cycles, core_get_name(cores[0]), reference.reg.program_counter,
+                       reference.reg.y, (unsigned long long)reference.cycles);
+            }
+        }
+    }
+    printf("%u cases on %zu cores, %u failed\n", (unsigned int)(sizeof(cases) / sizeof(cases[0])),
+           sizeof(cores) / sizeof(cores[0]), failed);
+    return (failed == 0U) ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "emulator_utility.h"
+#include "z6502_disasm.h"
+
+static void usage(const char* name){
+    fprintf(stderr, "Usage: %s [options] ROM_file\n", name);
+    fprintf(stderr, "  --format name       Image format: auto, raw, ihex, srec or prg (default auto)\n");
+    fprintf(stderr, "  --load addr         Load address of raw images (default 0000)\n");
+    fprintf(stderr, "  -e addr             Trace from this address too, may be repeated\n");
+    fprintf(stderr, "  --no-vectors        Do not trace from the NMI, reset and IRQ vectors\n");
+    fprintf(stderr, "  --range first-last  List this range only (default: first to last byte found)\n");
+    fprintf(stderr, "  --linear first-last Disassemble the range byte after byte, without tracing\n");
+    fprintf(stderr, "  --map file          Save the code map, for z6502_emulator --code-map\n");
+    fprintf(stderr, "  -q                  No listing, print the summary only\n");
+    fprintf(stderr, "Addresses are hexadecimal, with an optional $ or 0x prefix.\n");
+}
+
+/*Hexadecimal address, -1 if invalid*/
+static long parse_address(const char* text){
+    char* end;
+    unsigned long value;
+
+    if(text[0] == '$'){
+        text++;
+    }
+    else if(text[0] == '0' && (text[1] == 'x' || text[1] == 'X')){
+        text += 2;
+    }
+    value = strtoul(text, &end, 16);
+    return (end == text || *end != '\0' || value > 0xFFFFU) ? -1 : (long)value;
+}
+
+/*first-last, -1 if invalid*/
+static int parse_range(const char* text, long* first, long* last){
+    char buffer[32];
+    char* separator;
+
+    if(strlen(text) >= sizeof(buffer)){
+        return -1;
+    }
+    strcpy(buffer, text);
+    separator = strchr(buffer, '-');
+    if(separator == NULL){
+        return -1;
+    }
+    *separator = '\0';
+    *first = parse_address(buffer);
+    *last = parse_address(separator + 1);
+    return (*first < 0 || *last < *first) ? -1 : 0;
+}
+
+int main(int argc, char** argv){
+    const char* rom = NULL;
+    const char* map_file = NULL;
+    rom_format_t format = ROM_FORMAT_AUTO;
+    long load_address = 0;
+    std::vector<uint16_t> entry;
+    uint8_t vectors = TRUE;
+    uint8_t quiet = FALSE;
+    uint8_t linear = FALSE;
+    long first = -1;
+    long last = -1;
+    long value;
+    rom_status_t status;
+    rom_info_t info;
+    code_map_stats_t stats;
+    char text[Z6502_DISASM_TEXT_BYTES];
+    int result = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--format") == 0 && i + 1 < argc){
+            if(rom_parse_format(argv[++i], &format) < 0){
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--load") == 0 && i + 1 < argc && (load_address = parse_address(argv[i + 1])) >= 0){
+            i++;
+        }
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc && (value = parse_address(argv[i + 1])) >= 0){
+            entry.push_back((uint16_t)value);
+            i++;
+        }
+        else if(strcmp(argv[i], "--no-vectors") == 0){
+            vectors = FALSE;
+        }
+        else if((strcmp(argv[i], "--range") == 0 || strcmp(argv[i], "--linear") == 0) && i + 1 < argc &&
+                parse_range(argv[i + 1], &first, &last) == 0){
+            linear = (strcmp(argv[i], "--linear") == 0) ? TRUE : FALSE;
+            i++;
+        }
+        else if(strcmp(argv[i], "--map") == 0 && i + 1 < argc){
+            map_file = argv[++i];
+        }
+        else if(strcmp(argv[i], "-q") == 0){
+            quiet = TRUE;
+        }
+        else if(argv[i][0] != '-' && rom == NULL){
+            rom = argv[i];
+        }
+        else{
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(rom == NULL){
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint8_t* memory = (uint8_t*)calloc(Z6502_MAX_MEMORY_SIZE_BYTES, sizeof(uint8_t));
+    code_map_t* map = code_map_create();
+
+    if(memory == NULL || map == NULL){
+        fprintf(stderr, "[CRITICAL] Memory allocation error\n");
+        free(memory);
+        code_map_free(map);
+        return -1;
+    }
+    if(rom_load(rom, format, (uint16_t)load_address, memory, Z6502_MAX_MEMORY_SIZE_BYTES, &info, &status) < 0){
+        fprintf(stderr, "[ ERROR  ] %s\n", status.message);
+        free(memory);
+        code_map_free(map);
+        return -1;
+    }
+
+    if(linear == TRUE){
+        /*No map, every byte is taken as an instruction start*/
+        auto start = std::chrono::steady_clock::now();
+        uint32_t count = 0U;
+        for(long address = first; address <= last; count++){
+            unsigned int length = disasm_instruction(memory, (uint16_t)address, text);
+            if(quiet == FALSE){
+                printf("%04lX  %s\n", address, text);
+            }
+            address += length;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%u instructions in %.3f ms\n", count, seconds * 1e3);
+        free(memory);
+        code_map_free(map);
+        return 0;
+    }
+
+    /*Trace from the vectors, the image start address and the given entries*/
+    auto start = std::chrono::steady_clock::now();
+    if(vectors == TRUE){
+        code_map_trace_vectors(map, memory);
+    }
+    if(info.has_start == TRUE){
+        code_map_trace(map, memory, info.start);
+    }
+    for(uint16_t address : entry){
+        code_map_trace(map, memory, address);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    code_map_get_stats(map, &stats);
+
+    if(quiet == FALSE){
+        if(first < 0){
+            /*First to last byte found*/
+            for(long address = 0; address < (long)Z6502_MAX_MEMORY_SIZE_BYTES; address++){
+                if(map->flags[address] != 0U){
+                    first = (first < 0) ? address : first;
+                    last = address;
+                }
+            }
+        }
+        if(first >= 0){
+            code_map_print(map, memory, (uint16_t)first, (uint16_t)last, stdout);
+        }
+    }
+    fprintf(stderr, "%u instructions, %u blocks, %u targets, %u code bytes, %u data bytes, %u invalid, traced in %.3f ms\n",
+            stats.instructions, stats.blocks, stats.targets, stats.code_bytes, stats.data_bytes, stats.invalid, seconds * 1e3);
+    if(map_file != NULL && code_map_export(map, map_file) < 0){
+        fprintf(stderr, "[ ERROR  ] Could not write %s\n", map_file);
+        result = -1;
+    }
+
+    free(memory);
+    code_map_free(map);
+    return result;
+}
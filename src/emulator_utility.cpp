@@ -1,20 +1,568 @@
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <mutex>
+#include <sys/stat.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define ROM_USE_MMAP
+#endif
 #include "emulator_utility.h"
 
-int memory_load(char* filename, uint16_t start_address, uint8_t* memory_ptr, uint16_t memory_size){
-    int result;
-    /*Open file*/
-    FILE *file = fopen(filename, "r");
-    if(file == NULL){
-        fclose(file);
+#ifndef TRUE
+#define TRUE 1U
+#endif
+#ifndef FALSE
+#define FALSE 0U
+#endif
+
+/*Longest record: 255 data bytes plus count, address, type and checksum*/
+#define ROM_MAX_RECORD_BYTES 261U
+
+/*Parse state shared by the format readers*/
+typedef struct
+{
+    const rom_image_t* image;
+    size_t position;            /* Offset of the next line */
+    unsigned int line;          /* Number of the current line, from 1 */
+    uint8_t* memory_ptr;
+    uint32_t memory_size;
+    rom_info_t* info;
+    rom_status_t* status;
+} rom_parser_t;
+
+/*Images currently open, shared by every opener of the same file*/
+static std::mutex rom_lock;
+static rom_image_t* rom_images = NULL;
+
+//*****************************************************************************
+// Errors
+//*****************************************************************************
+
+/**
+ * @brief Fill a status with file name, line and message
+ * @returns -1
+ */
+static int _rom_error(rom_status_t* status, rom_error_t error, const char* filename, unsigned int line, const char* format, ...){
+    va_list args;
+    int length;
+
+    if(status == NULL){
         return -1;
     }
-    /*Read file*/
-    result = fread(memory_ptr, sizeof(uint8_t), memory_size, file);
-    if(ferror != 0){
-        fclose(file);
+    status->error = error;
+    status->line = line;
+    if(line > 0U){
+        length = snprintf(status->message, sizeof(status->message), "%s:%u: ", filename, line);
+    }
+    else{
+        length = snprintf(status->message, sizeof(status->message), "%s: ", filename);
+    }
+    if(length >= 0 && (size_t)length < sizeof(status->message)){
+        va_start(args, format);
+        vsnprintf(&status->message[length], sizeof(status->message) - length, format, args);
+        va_end(args);
+    }
+    return -1;
+}
+
+/**
+ * @brief Error at the current line of a parser
+ * @returns -1
+ */
+#define _parser_error(parser, error, ...) \
+    _rom_error((parser)->status, error, (parser)->image->filename, (parser)->line, __VA_ARGS__)
+
+//*****************************************************************************
+// Images
+//*****************************************************************************
+
+rom_image_t* rom_image_open(const char* filename, rom_status_t* status){
+    std::lock_guard<std::mutex> guard(rom_lock);
+    struct stat info;
+    rom_image_t* image;
+
+    if(stat(filename, &info) != 0){
+        _rom_error(status, ROM_ERROR_OPEN, filename, 0U, "cannot open image: %s", strerror(errno));
+        return NULL;
+    }
+    if((info.st_mode & S_IFMT) != S_IFREG){
+        _rom_error(status, ROM_ERROR_OPEN, filename, 0U, "not a regular file");
+        return NULL;
+    }
+
+    /*Same file already open*/
+    for(image = rom_images; image != NULL; image = image->next){
+        if(image->device == (uint64_t)info.st_dev && image->inode == (uint64_t)info.st_ino &&
+           image->modified == (int64_t)info.st_mtime && image->size == (size_t)info.st_size &&
+           (info.st_ino != 0 || strcmp(image->filename, filename) == 0)){
+            image->refs++;
+            return image;
+        }
+    }
+
+    image = (rom_image_t*)calloc(1, sizeof(rom_image_t));
+    if(image == NULL || (image->filename = strdup(filename)) == NULL){
+        free(image);
+        _rom_error(status, ROM_ERROR_OPEN, filename, 0U, "out of memory");
+        return NULL;
+    }
+    image->size = info.st_size;
+    image->device = info.st_dev;
+    image->inode = info.st_ino;
+    image->modified = info.st_mtime;
+
+    if(image->size > 0U){
+#ifdef ROM_USE_MMAP
+        int file = open(filename, O_RDONLY);
+        void* data = MAP_FAILED;
+        if(file >= 0){
+            data = mmap(NULL, image->size, PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+        }
+        if(data != MAP_FAILED){
+            image->data = (const uint8_t*)data;
+            image->mapped = TRUE;
+        }
+#endif
+        if(image->data == NULL){
+            /*No mapping, read the file once*/
+            FILE* file = fopen(filename, "rb");
+            uint8_t* data = (uint8_t*)malloc(image->size);
+            if(file == NULL || data == NULL || fread(data, sizeof(uint8_t), image->size, file) != image->size){
+                _rom_error(status, ROM_ERROR_OPEN, filename, 0U, "cannot read image: %s", file == NULL ? strerror(errno) : "short read");
+                if(file != NULL){
+                    fclose(file);
+                }
+                free(data);
+                free(image->filename);
+                free(image);
+                return NULL;
+            }
+            fclose(file);
+            image->data = data;
+        }
+    }
+
+    image->refs = 1U;
+    image->next = rom_images;
+    rom_images = image;
+    return image;
+}
+
+void rom_image_close(rom_image_t* image){
+    std::lock_guard<std::mutex> guard(rom_lock);
+    rom_image_t** link;
+
+    if(image == NULL || --image->refs > 0U){
+        return;
+    }
+    for(link = &rom_images; *link != NULL; link = &(*link)->next){
+        if(*link == image){
+            *link = image->next;
+            break;
+        }
+    }
+#ifdef ROM_USE_MMAP
+    if(image->mapped == TRUE){
+        munmap((void*)image->data, image->size);
+    }
+    else
+#endif
+    {
+        free((void*)image->data);
+    }
+    free(image->filename);
+    free(image);
+}
+
+//*****************************************************************************
+// Parsing
+//*****************************************************************************
+
+/**
+ * @brief Copy data to the memory space
+ * @param parser Parser
+ * @param address Address of the first byte, may be past 64 KiB for 24 and 32 bit records
+ * @param data Data
+ * @param size Number of bytes
+ * @returns 0 on success, -1 if the data does not fit in memory
+ */
+static int _rom_store(rom_parser_t* parser, uint32_t address, const uint8_t* data, size_t size){
+    rom_info_t* info = parser->info;
+
+    if(size == 0U){
+        return 0;
+    }
+    if(address >= parser->memory_size || size > parser->memory_size - address){
+        return _parser_error(parser, ROM_ERROR_RANGE, "%zu bytes at $%04X do not fit in %u bytes of memory",
+                             size, address, parser->memory_size);
+    }
+    memcpy(&parser->memory_ptr[address], data, size);
+
+    if(info->bytes == 0U || address < info->lowest){
+        info->lowest = address;
+    }
+    if(info->bytes == 0U || address + size - 1U > info->highest){
+        info->highest = address + size - 1U;
+    }
+    info->bytes += size;
+    return 0;
+}
+
+/**
+ * @brief Move to the next line of a text image
+ * @param parser Parser
+ * @param text First character of the line, trailing blanks and line end removed
+ * @param length Line length
+ * @returns FALSE at the end of the image
+ */
+static uint8_t _rom_next_line(rom_parser_t* parser, const char** text, size_t* length){
+    const char* start = (const char*)&parser->image->data[parser->position];
+    size_t left = parser->image->size - parser->position;
+    const char* end;
+
+    if(left == 0U){
+        return FALSE;
+    }
+    end = (const char*)memchr(start, '\n', left);
+    if(end == NULL){
+        end = start + left;
+        parser->position = parser->image->size;
+    }
+    else{
+        parser->position += end - start + 1U;
+    }
+    while(end > start && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')){
+        end--;
+    }
+    parser->line++;
+    *text = start;
+    *length = end - start;
+    return TRUE;
+}
+
+/**
+ * @brief Value of a hexadecimal digit, -1 if not a digit
+ */
+static int _hex_digit(char digit){
+    if(digit >= '0' && digit <= '9'){
+        return digit - '0';
+    }
+    if(digit >= 'A' && digit <= 'F'){
+        return digit - 'A' + 10;
+    }
+    if(digit >= 'a' && digit <= 'f'){
+        return digit - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Decode the hexadecimal bytes of a record
+ * @param parser Parser
+ * @param text Hexadecimal digits
+ * @param length Number of digits
+ * @param record Decoded bytes, ROM_MAX_RECORD_BYTES long
+ * @returns Number of bytes, -1 on error
+ */
+static int _rom_decode(rom_parser_t* parser, const char* text, size_t length, uint8_t* record){
+    int high, low;
+
+    if(length % 2U != 0U){
+        return _parser_error(parser, ROM_ERROR_FORMAT, "odd number of hexadecimal digits");
+    }
+    if(length / 2U > ROM_MAX_RECORD_BYTES){
+        return _parser_error(parser, ROM_ERROR_FORMAT, "record longer than %u bytes", ROM_MAX_RECORD_BYTES);
+    }
+    for(size_t i = 0U; i < length; i += 2U){
+        high = _hex_digit(text[i]);
+        low = _hex_digit(text[i + 1U]);
+        if(high < 0 || low < 0){
+            return _parser_error(parser, ROM_ERROR_FORMAT, "bad hexadecimal digit in column %zu", (high < 0 ? i : i + 1U) + 2U);
+        }
+        record[i / 2U] = (high << 4) | low;
+    }
+    return length / 2U;
+}
+
+/**
+ * @brief Load an Intel HEX image: ":" count address type data checksum
+ */
+static int _rom_load_ihex(rom_parser_t* parser){
+    uint8_t record[ROM_MAX_RECORD_BYTES];
+    uint32_t base = 0U;
+    uint8_t sum;
+    const char* text;
+    size_t length;
+    int size;
+
+    while(_rom_next_line(parser, &text, &length) == TRUE){
+        if(length == 0U){
+            continue;
+        }
+        if(text[0] != ':'){
+            return _parser_error(parser, ROM_ERROR_FORMAT, "record does not start with ':'");
+        }
+        size = _rom_decode(parser, &text[1], length - 1U, record);
+        if(size < 0){
+            return -1;
+        }
+        if(size < 5 || record[0] + 5 != size){
+            return _parser_error(parser, ROM_ERROR_FORMAT, "record length does not match its byte count");
+        }
+        sum = 0U;
+        for(int i = 0; i < size; i++){
+            sum += record[i];
+        }
+        if(sum != 0U){
+            return _parser_error(parser, ROM_ERROR_CHECKSUM, "checksum mismatch, expected $%02X",
+                                 (uint8_t)(record[size - 1] - sum));
+        }
+
+        const uint8_t* data = &record[4];
+        uint16_t address = (record[1] << 8) | record[2];
+        switch(record[3]){
+            case 0x00U: /*Data*/
+                if(_rom_store(parser, base + address, data, record[0]) < 0){
+                    return -1;
+                }
+                break;
+            case 0x01U: /*End of file*/
+                return 0;
+            case 0x02U: /*Extended segment address*/
+            case 0x04U: /*Extended linear address*/
+                if(record[0] != 2U){
+                    return _parser_error(parser, ROM_ERROR_FORMAT, "extended address record needs 2 bytes");
+                }
+                base = ((data[0] << 8) | data[1]) << (record[3] == 0x02U ? 4 : 16);
+                break;
+            case 0x03U: /*Start segment address CS:IP*/
+            case 0x05U: /*Start linear address*/
+                if(record[0] != 4U){
+                    return _parser_error(parser, ROM_ERROR_FORMAT, "start address record needs 4 bytes");
+                }
+                parser->info->has_start = TRUE;
+                parser->info->start = (record[3] == 0x03U) ? ((data[0] << 8 | data[1]) << 4) + (data[2] << 8 | data[3])
+                                                           : (data[2] << 8 | data[3]);
+                break;
+            default:
+                return _parser_error(parser, ROM_ERROR_FORMAT, "unknown record type $%02X", record[3]);
+        }
+    }
+    parser->line = 0U;
+    return _parser_error(parser, ROM_ERROR_FORMAT, "missing end of file record");
+}
+
+/**
+ * @brief Load a Motorola S-record image: "S" type count address data checksum
+ */
+static int _rom_load_srec(rom_parser_t* parser){
+    static const uint8_t address_bytes[10] = {2U, 2U, 3U, 4U, 0U, 2U, 3U, 4U, 3U, 2U};
+    uint8_t record[ROM_MAX_RECORD_BYTES];
+    uint32_t data_records = 0U;
+    uint32_t address;
+    uint8_t sum;
+    unsigned int type;
+    const char* text;
+    size_t length;
+    int size;
+
+    while(_rom_next_line(parser, &text, &length) == TRUE){
+        if(length == 0U){
+            continue;
+        }
+        if(length < 2U || text[0] != 'S' || text[1] < '0' || text[1] > '9' || text[1] == '4'){
+            return _parser_error(parser, ROM_ERROR_FORMAT, "record does not start with S0-S3 or S5-S9");
+        }
+        type = text[1] - '0';
+        size = _rom_decode(parser, &text[2], length - 2U, record);
+        if(size < 0){
+            return -1;
+        }
+        if(size < 1 || record[0] + 1 != size || record[0] < address_bytes[type] + 1U){
+            return _parser_error(parser, ROM_ERROR_FORMAT, "record length does not match its byte count");
+        }
+        sum = 0U;
+        for(int i = 0; i < size; i++){
+            sum += record[i];
+        }
+        if(sum != 0xFFU){
+            return _parser_error(parser, ROM_ERROR_CHECKSUM, "checksum mismatch, expected $%02X",
+                                 (uint8_t)(record[size - 1] + 0xFFU - sum));
+        }
+
+        address = 0U;
+        for(unsigned int i = 0U; i < address_bytes[type]; i++){
+            address = (address << 8) | record[1U + i];
+        }
+        switch(type){
+            case 0U: /*Header*/
+                break;
+            case 1U: /*Data, 16, 24 or 32 bit address*/
+            case 2U:
+            case 3U:
+                if(_rom_store(parser, address, &record[1U + address_bytes[type]], record[0] - address_bytes[type] - 1U) < 0){
+                    return -1;
+                }
+                data_records++;
+                break;
+            case 5U: /*Data record count*/
+            case 6U:
+                if(address != data_records){
+                    return _parser_error(parser, ROM_ERROR_FORMAT, "record count %u does not match %u data records",
+                                         address, data_records);
+                }
+                break;
+            default: /*Start address, ends the image*/
+                if(address >= parser->memory_size){
+                    return _parser_error(parser, ROM_ERROR_RANGE, "start address $%X outside memory", address);
+                }
+                parser->info->has_start = TRUE;
+                parser->info->start = address;
+                return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Load a Commodore PRG image: little endian load address then data
+ */
+static int _rom_load_prg(rom_parser_t* parser){
+    const uint8_t* data = parser->image->data;
+
+    if(parser->image->size < 2U){
+        return _parser_error(parser, ROM_ERROR_FORMAT, "PRG image shorter than its load address");
+    }
+    return _rom_store(parser, data[0] | (data[1] << 8), &data[2], parser->image->size - 2U);
+}
+
+/**
+ * @brief First line of a text image is a record of the given kind
+ * @param image Image
+ * @param marker Record start character
+ * @param prefix Characters after the marker that are not hexadecimal
+ */
+static uint8_t _rom_sniff(const rom_image_t* image, char marker, unsigned int prefix){
+    const char* text = (const char*)image->data;
+    size_t i = 0U;
+    size_t digits = 0U;
+
+    while(i < image->size && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r' || text[i] == '\n')){
+        i++;
+    }
+    if(i >= image->size || text[i] != marker){
+        return FALSE;
+    }
+    i++;
+    if(prefix > 0U && (i >= image->size || text[i] < '0' || text[i] > '9')){
+        return FALSE;
+    }
+    i += prefix;
+    for(; i < image->size && text[i] != '\r' && text[i] != '\n'; i++, digits++){
+        if(_hex_digit(text[i]) < 0){
+            return FALSE;
+        }
+    }
+    return digits >= 2U ? TRUE : FALSE;
+}
+
+/**
+ * @brief Guess an image format from the file extension, then from the first record
+ */
+static rom_format_t _rom_detect(const rom_image_t* image){
+    static const char* extensions[] = {".hex", ".ihx", ".ihex", ".s19", ".s28", ".s37", ".srec", ".mot", ".prg"};
+    static const rom_format_t formats[] = {ROM_FORMAT_IHEX, ROM_FORMAT_IHEX, ROM_FORMAT_IHEX, ROM_FORMAT_SREC,
+                                           ROM_FORMAT_SREC, ROM_FORMAT_SREC, ROM_FORMAT_SREC, ROM_FORMAT_SREC, ROM_FORMAT_PRG};
+    const char* extension = strrchr(image->filename, '.');
+
+    if(extension != NULL && strchr(extension, '/') == NULL){
+        for(unsigned int i = 0U; i < sizeof(formats) / sizeof(formats[0]); i++){
+            if(strcasecmp(extension, extensions[i]) == 0){
+                return formats[i];
+            }
+        }
+    }
+    if(_rom_sniff(image, ':', 0U) == TRUE){
+        return ROM_FORMAT_IHEX;
+    }
+    if(_rom_sniff(image, 'S', 1U) == TRUE){
+        return ROM_FORMAT_SREC;
+    }
+    return ROM_FORMAT_RAW;
+}
+
+int rom_image_load(const rom_image_t* image, rom_format_t format, uint16_t load_address,
+                   uint8_t* memory_ptr, uint32_t memory_size, rom_info_t* info, rom_status_t* status){
+    rom_parser_t parser;
+    rom_info_t local_info;
+    int result;
+
+    if(info == NULL){
+        info = &local_info;
+    }
+    memset(info, 0, sizeof(rom_info_t));
+    if(status != NULL){
+        memset(status, 0, sizeof(rom_status_t));
+    }
+
+    parser.image = image;
+    parser.position = 0U;
+    parser.line = 0U;
+    parser.memory_ptr = memory_ptr;
+    parser.memory_size = memory_size;
+    parser.info = info;
+    parser.status = status;
+
+    info->format = (format == ROM_FORMAT_AUTO) ? _rom_detect(image) : format;
+    switch(info->format){
+        case ROM_FORMAT_IHEX:
+            result = _rom_load_ihex(&parser);
+            break;
+        case ROM_FORMAT_SREC:
+            result = _rom_load_srec(&parser);
+            break;
+        case ROM_FORMAT_PRG:
+            result = _rom_load_prg(&parser);
+            break;
+        default:
+            result = _rom_store(&parser, load_address, image->data, image->size);
+            break;
+    }
+    return (result < 0) ? -1 : (int)info->bytes;
+}
+
+int rom_load(const char* filename, rom_format_t format, uint16_t load_address,
+             uint8_t* memory_ptr, uint32_t memory_size, rom_info_t* info, rom_status_t* status){
+    rom_image_t* image = rom_image_open(filename, status);
+    int result;
+
+    if(image == NULL){
+        if(info != NULL){
+            memset(info, 0, sizeof(rom_info_t));
+        }
         return -1;
     }
-    fclose(file);
+    result = rom_image_load(image, format, load_address, memory_ptr, memory_size, info, status);
+    rom_image_close(image);
     return result;
-}
\ No newline at end of file
+}
+
+int rom_parse_format(const char* name, rom_format_t* format){
+    static const char* names[] = {"auto", "raw", "ihex", "srec", "prg"};
+    static const rom_format_t formats[] = {ROM_FORMAT_AUTO, ROM_FORMAT_RAW, ROM_FORMAT_IHEX, ROM_FORMAT_SREC, ROM_FORMAT_PRG};
+
+    for(unsigned int i = 0U; i < sizeof(formats) / sizeof(formats[0]); i++){
+        if(strcasecmp(name, names[i]) == 0){
+            *format = formats[i];
+            return 0;
+        }
+    }
+    return -1;
+}
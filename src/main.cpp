@@ -10,36 +10,547 @@
  * MIT Licence - see licence file
  */
 
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <vector>
 #include "emulator_utility.h"
 #include "z6502.h"
+#include "z6502_profile.h"
+#include "z6502_pace.h"
+#include "z6502_disasm.h"
+
+/*Exit status: run limit or halt point reached, unhandled opcode, bad arguments or setup error*/
+#define EXIT_DONE       0
+#define EXIT_HALTED     2
+#define EXIT_USAGE      1
+#define EXIT_ERROR      3
+
+/*--halt-at addresses at most*/
+#define MAX_HALT_POINTS 64U
+
+/*Memory region printed or saved on exit*/
+typedef struct
+{
+    uint16_t first;
+    uint16_t last;
+    const char* filename;       /* Raw dump file, NULL to print a hex dump */
+} dump_region_t;
+
+/*What ended the run*/
+typedef enum
+{
+    STOP_CYCLES,
+    STOP_INSTRUCTIONS,
+    STOP_ADDRESS,
+    STOP_OPCODE,
+    STOP_UNHANDLED
+} stop_reason_t;
+
+static void usage(const char* name){
+    fprintf(stderr, "Usage: %s [options] ROM_file\n", name);
+    fprintf(stderr, "Image:\n");
+    fprintf(stderr, "  --format name      Image format: auto, raw, ihex, srec or prg (default auto)\n");
+    fprintf(stderr, "  --load addr        Load address of raw images (default 0000)\n");
+    fprintf(stderr, "  -e addr            Start at this address\n");
+    fprintf(stderr, "  --reset-vector     Start at the reset vector even if the image has a start address\n");
+    fprintf(stderr, "Execution:\n");
+    fprintf(stderr, "  -c core            Core: table, switch, cache or jit (default set at build time)\n");
+    fprintf(stderr, "  --accurate         Count branch and page crossing penalty cycles\n");
+    fprintf(stderr, "  --idle             Fast-forward idle loops\n");
+    fprintf(stderr, "  --code-map file    Decode the code of a z6502_disasm map before running\n");
+    fprintf(stderr, "  --clock hz         Run in real time at this clock, k and M suffixes allowed (e.g. 1M)\n");
+    fprintf(stderr, "  --slice us         Emulated time between two clock checks (default %u)\n", Z6502_PACE_DEFAULT_SLICE_MICROSECONDS);
+    fprintf(stderr, "  --load-state file  Continue from a state saved with the same image\n");
+    fprintf(stderr, "Limits, the run ends on the first one reached, counted from the loaded state:\n");
+    fprintf(stderr, "  -n cycles          Cycles to run (default 100000000)\n");
+    fprintf(stderr, "  -i count           Instructions to run\n");
+    fprintf(stderr, "  --halt-at addr     Stop before the instruction at addr, may be repeated\n");
+    fprintf(stderr, "  --halt-on op       Stop before any instruction with opcode op (hex), may be repeated.\n");
+    fprintf(stderr, "                     Interprets instruction by instruction, not with --clock\n");
+    fprintf(stderr, "Output:\n");
+    fprintf(stderr, "  --dump first-last  Print memory as hex on exit, may be repeated\n");
+    fprintf(stderr, "  --dump first-last=file  Save memory as raw bytes on exit\n");
+    fprintf(stderr, "  --save-state file  Save registers and the memory that differs from the image on exit\n");
+    fprintf(stderr, "  --raw-state        Do not compress the saved state\n");
+    fprintf(stderr, "  -p                 Profile and print the hot spots\n");
+    fprintf(stderr, "  -t count           Hot spots and opcodes listed (default 10)\n");
+    fprintf(stderr, "  --csv file         Export the profile as CSV\n");
+    fprintf(stderr, "  --json file        Export the profile as JSON\n");
+    fprintf(stderr, "Exit status: %d run limit or halt point reached, %d unhandled opcode, %d bad arguments, %d error\n",
+            EXIT_DONE, EXIT_HALTED, EXIT_USAGE, EXIT_ERROR);
+}
+
+/*Hexadecimal number with an optional $ or 0x prefix, -1 if invalid or above max*/
+static long parse_hex(const char* text, unsigned long max){
+    char* end;
+    unsigned long value;
+
+    if(text[0] == '$'){
+        text++;
+    }
+    else if(text[0] == '0' && (text[1] == 'x' || text[1] == 'X')){
+        text += 2;
+    }
+    value = strtoul(text, &end, 16);
+    return (end == text || *end != '\0' || value > max) ? -1 : (long)value;
+}
+
+/*Frequency with an optional k or M suffix, 0 if invalid*/
+static uint64_t parse_frequency(const char* text){
+    char* end;
+    double value = strtod(text, &end);
+
+    if(*end == 'k' || *end == 'K'){
+        value *= 1e3;
+        end++;
+    }
+    else if(*end == 'M' || *end == 'm'){
+        value *= 1e6;
+        end++;
+    }
+    return (end == text || *end != '\0' || value < 1.0) ? 0U : (uint64_t)(value + 0.5);
+}
+
+/*Decimal count, -1 if invalid*/
+static int parse_count(const char* text, uint64_t* count){
+    char* end;
+
+    *count = strtoull(text, &end, 10);
+    return (end == text || *end != '\0' || text[0] == '-') ? -1 : 0;
+}
+
+/*first-last or first-last=file, -1 if invalid*/
+static int parse_dump(char* text, dump_region_t* region){
+    char* separator = strchr(text, '-');
+    char* equal = strchr(text, '=');
+    long first;
+    long last;
+
+    if(separator == NULL){
+        return -1;
+    }
+    *separator = '\0';
+    region->filename = NULL;
+    if(equal != NULL){
+        *equal = '\0';
+        region->filename = equal + 1;
+    }
+    first = parse_hex(text, 0xFFFFU);
+    last = parse_hex(separator + 1, 0xFFFFU);
+    if(first < 0 || last < first){
+        return -1;
+    }
+    region->first = (uint16_t)first;
+    region->last = (uint16_t)last;
+    return 0;
+}
+
+/**
+ * @brief Print or save the memory regions asked for
+ * @returns 0 on success, -1 if a file cannot be written
+ */
+static int dump_memory(const uint8_t* memory_space, const std::vector<dump_region_t>& regions){
+    FILE* file;
+    int result = 0;
+
+    for(const dump_region_t& region : regions){
+        if(region.filename != NULL){
+            file = fopen(region.filename, "wb");
+            if(file == NULL || fwrite(&memory_space[region.first], 1U, region.last - region.first + 1U, file) != region.last - region.first + 1U){
+                fprintf(stderr, "[ ERROR  ] Could not write %s\n", region.filename);
+                result = -1;
+            }
+            if(file != NULL){
+                fclose(file);
+            }
+            continue;
+        }
+        for(unsigned int line = region.first & ~0x0FU; line <= region.last; line += 16U){
+            printf("%04X:", line);
+            for(unsigned int addr = line; addr < line + 16U; addr++){
+                if(addr >= region.first && addr <= region.last){
+                    printf(" %02X", memory_space[addr]);
+                }
+                else{
+                    printf("   ");
+                }
+            }
+            printf("\n");
+        }
+    }
+    return result;
+}
 
 int main(int argc,char ** argv) {
     //std::cout << "zephyr_dx82_emulator started." << std::endl;
+    const char* rom = NULL;
+    const char* csv = NULL;
+    const char* json = NULL;
+    const char* code_map_file = NULL;
+    const char* load_state = NULL;
+    const char* save_state = NULL;
+    uint8_t state_flags = Z6502_STATE_COMPRESSED;
+    rom_format_t format = ROM_FORMAT_AUTO;
+    long load_address = 0;
+    long entry = -1;
+    uint8_t reset_vector = FALSE;
+    core_t core = CORE_TABLE;
+    uint8_t core_set = FALSE;
+    uint8_t accurate = FALSE;
+    uint8_t idle = FALSE;
+    uint64_t cycles = 100000000U;
+    uint64_t instructions = UINT64_MAX;
+    std::vector<uint16_t> halt_address;
+    uint8_t halt_opcode[256] = {0};
+    uint8_t halt_on_opcode = FALSE;
+    std::vector<dump_region_t> dump;
+    dump_region_t region;
+    uint64_t top = 10U;
+    uint8_t profile = FALSE;
+    uint64_t clock = 0U;
+    uint64_t slice = Z6502_PACE_DEFAULT_SLICE_MICROSECONDS;
+    long value;
+    register_set_t reg;
+    rom_status_t status;
+    rom_info_t info;
+    int result = EXIT_DONE;
+
+    /*Parse arguments*/
+    for(int i = 1; i < argc; i++){
+        const char* option = argv[i];
+        const char* arg = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int bad = FALSE;
 
-    // le programme prend 3 arguments: le nom du fichier pour cr�er la cl�, le nombre de s�maphore ainsi que la valeur initiale
-	if (argc!=2) { fprintf(stderr,"Usage: %s ROM_file\n",argv[0]);
-					return 1;
-	}
+        if(strcmp(option, "-h") == 0 || strcmp(option, "--help") == 0){
+            usage(argv[0]);
+            return EXIT_DONE;
+        }
+        else if(strcmp(option, "--reset-vector") == 0){
+            reset_vector = TRUE;
+        }
+        else if(strcmp(option, "--accurate") == 0){
+            accurate = TRUE;
+        }
+        else if(strcmp(option, "--idle") == 0){
+            idle = TRUE;
+        }
+        else if(strcmp(option, "-p") == 0){
+            profile = TRUE;
+        }
+        else if(strcmp(option, "--raw-state") == 0){
+            state_flags = 0U;
+        }
+        else if(option[0] != '-'){
+            bad = (rom != NULL) ? TRUE : FALSE;
+            rom = option;
+        }
+        else if(arg == NULL){
+            bad = TRUE;
+        }
+        else{
+            /*Options taking a value*/
+            i++;
+            if(strcmp(option, "--format") == 0){
+                bad = (rom_parse_format(arg, &format) < 0) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "--load") == 0){
+                load_address = parse_hex(arg, 0xFFFFU);
+                bad = (load_address < 0) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "-e") == 0){
+                entry = parse_hex(arg, 0xFFFFU);
+                bad = (entry < 0) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "-c") == 0){
+                bad = (core_parse_name(arg, &core) < 0) ? TRUE : FALSE;
+                core_set = TRUE;
+            }
+            else if(strcmp(option, "--code-map") == 0){
+                code_map_file = arg;
+            }
+            else if(strcmp(option, "--load-state") == 0){
+                load_state = arg;
+            }
+            else if(strcmp(option, "--save-state") == 0){
+                save_state = arg;
+            }
+            else if(strcmp(option, "--clock") == 0){
+                clock = parse_frequency(arg);
+                bad = (clock == 0U) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "--slice") == 0){
+                bad = (parse_count(arg, &slice) < 0 || slice == 0U || slice > UINT32_MAX) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "-n") == 0){
+                bad = (parse_count(arg, &cycles) < 0) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "-i") == 0){
+                bad = (parse_count(arg, &instructions) < 0) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "--halt-at") == 0){
+                value = parse_hex(arg, 0xFFFFU);
+                bad = (value < 0 || halt_address.size() >= MAX_HALT_POINTS) ? TRUE : FALSE;
+                halt_address.push_back((uint16_t)value);
+            }
+            else if(strcmp(option, "--halt-on") == 0){
+                value = parse_hex(arg, 0xFFU);
+                bad = (value < 0) ? TRUE : FALSE;
+                halt_opcode[value & 0xFF] = TRUE;
+                halt_on_opcode = TRUE;
+            }
+            else if(strcmp(option, "--dump") == 0){
+                bad = (parse_dump(argv[i], &region) < 0) ? TRUE : FALSE;
+                dump.push_back(region);
+            }
+            else if(strcmp(option, "-t") == 0){
+                bad = (parse_count(arg, &top) < 0 || top > 65536U) ? TRUE : FALSE;
+            }
+            else if(strcmp(option, "--csv") == 0){
+                csv = arg;
+                profile = TRUE;
+            }
+            else if(strcmp(option, "--json") == 0){
+                json = arg;
+                profile = TRUE;
+            }
+            else{
+                /*Unknown option, its value is not shown*/
+                arg = NULL;
+                bad = TRUE;
+            }
+        }
+        if(bad == TRUE){
+            fprintf(stderr, "[ ERROR  ] Bad option or value: %s%s%s\n", option, (arg != NULL && option[0] == '-') ? " " : "",
+                    (arg != NULL && option[0] == '-') ? arg : "");
+            usage(argv[0]);
+            return EXIT_USAGE;
+        }
+    }
+    if(rom == NULL || (halt_on_opcode == TRUE && clock != 0U)){
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
 
     /*Allocate memory and io spaces*/
-    uint8_t* memory_space = (uint8_t*)malloc(Z6502_MAX_MEMORY_SIZE_BYTES*sizeof(uint8_t));
+    uint8_t* memory_space = (uint8_t*)calloc(Z6502_MAX_MEMORY_SIZE_BYTES, sizeof(uint8_t));
+    Z6502Profiler* profiler = (profile == TRUE) ? new (std::nothrow) Z6502Profiler() : NULL;
 
-    if(memory_space == NULL){
+    if(memory_space == NULL || (profile == TRUE && profiler == NULL)){
         fprintf(stderr, "[CRITICAL] Memory allocation error\n");
-        return -1;
+        free(memory_space);
+        delete profiler;
+        return EXIT_ERROR;
     }
 
     /*Load memory*/
-    if(memory_load(argv[1], 0x0000U, memory_space, Z6502_MAX_MEMORY_SIZE_BYTES) < 0){
-        fprintf(stderr, "[ ERROR  ] Could not load ROM file");
-        return -1;
+    if(rom_load(rom, format, (uint16_t)load_address, memory_space, Z6502_MAX_MEMORY_SIZE_BYTES, &info, &status) < 0){
+        fprintf(stderr, "[ ERROR  ] %s\n", status.message);
+        free(memory_space);
+        delete profiler;
+        return EXIT_ERROR;
+    }
+
+    /*States are stored against the image as loaded*/
+    uint8_t* image = NULL;
+    if(load_state != NULL || save_state != NULL){
+        image = (uint8_t*)malloc(Z6502_MAX_MEMORY_SIZE_BYTES);
+        if(image == NULL){
+            fprintf(stderr, "[CRITICAL] Memory allocation error\n");
+            free(memory_space);
+            delete profiler;
+            return EXIT_ERROR;
+        }
+        memcpy(image, memory_space, Z6502_MAX_MEMORY_SIZE_BYTES);
     }
 
-    /*Create components*/
+    /*Create components, start at -e, where the image says or at the reset vector*/
     Z6502 cpu(memory_space);
+    Z6502Pacer pacer;
+    cpu.reset();
+    cpu.dump_register(&reg);
+    if(entry >= 0){
+        reg.program_counter = (uint16_t)entry;
+    }
+    else if(info.has_start == TRUE && reset_vector == FALSE){
+        reg.program_counter = info.start;
+    }
+    else{
+        reg.program_counter = memory_space[Z6502_RESET_VECTOR_ADDRESS] | (memory_space[Z6502_RESET_VECTOR_ADDRESS + 1U] << 8);
+    }
+    cpu.load_register(&reg);
+    if(core_set == TRUE){
+        cpu.set_core(core);
+    }
+    cpu.set_timing(accurate == TRUE ? TIMING_ACCURATE : TIMING_FAST);
+    cpu.set_idle_skip(idle);
+    cpu.set_profiler(profiler);
+    if(clock != 0U && pacer.attach(&cpu, clock, (uint32_t)slice) < 0){
+        fprintf(stderr, "[ ERROR  ] Slice of %llu us is less than a cycle at %llu Hz\n", (unsigned long long)slice, (unsigned long long)clock);
+        delete profiler;
+        free(image);
+        free(memory_space);
+        return EXIT_ERROR;
+    }
+    for(uint16_t address : halt_address){
+        if(cpu.set_breakpoint(address) < 0){
+            fprintf(stderr, "[CRITICAL] Memory allocation error\n");
+            delete profiler;
+            free(image);
+            free(memory_space);
+            return EXIT_ERROR;
+        }
+    }
+
+    /*Continue a saved run, limits count from there*/
+    if(load_state != NULL){
+        FILE* file = fopen(load_state, "rb");
+        if(file == NULL || cpu.load_state(file, image) < 0){
+            fprintf(stderr, "[ ERROR  ] Could not load state %s, saved with another image or damaged\n", load_state);
+            if(file != NULL){
+                fclose(file);
+            }
+            delete profiler;
+            free(image);
+            free(memory_space);
+            return EXIT_ERROR;
+        }
+        fclose(file);
+        cycles = (cycles > UINT64_MAX - cpu.get_cycles()) ? UINT64_MAX : cycles + cpu.get_cycles();
+        instructions = (instructions > UINT64_MAX - cpu.get_instructions()) ? UINT64_MAX : instructions + cpu.get_instructions();
+    }
 
+    /*Warm the decode caches with the code found by the disassembler*/
+    if(code_map_file != NULL){
+        code_map_t* map = code_map_create();
+        if(map == NULL || code_map_import(map, code_map_file) < 0){
+            fprintf(stderr, "[ ERROR  ] Could not read code map %s\n", code_map_file);
+            code_map_free(map);
+            delete profiler;
+            free(image);
+            free(memory_space);
+            return EXIT_ERROR;
+        }
+        value = cpu.prewarm(map->flags);
+        code_map_free(map);
+        if(value < 0){
+            fprintf(stderr, "[CRITICAL] Memory allocation error\n");
+            delete profiler;
+            free(image);
+            free(memory_space);
+            return EXIT_ERROR;
+        }
+        printf("Prewarmed %ld %s\n", value, cpu.get_core() == CORE_JIT && accurate == FALSE ? "blocks" : "instructions");
+    }
+
+    /*Run*/
+    stop_reason_t reason = STOP_CYCLES;
+    uint8_t opcode;
+    uint64_t budget;
+    uint64_t start_cycles = cpu.get_cycles();
+    uint64_t start_instructions = cpu.get_instructions();
+    auto start = std::chrono::steady_clock::now();
+
+    if(halt_on_opcode == TRUE){
+        /*Look at every opcode before it runs*/
+        while(cpu.get_cycles() < cycles && cpu.get_instructions() < instructions && cpu.is_halted() == FALSE){
+            cpu.dump_register(&reg);
+            opcode = memory_space[reg.program_counter];
+            if(halt_opcode[opcode] == TRUE){
+                reason = STOP_OPCODE;
+                break;
+            }
+            if(std::find(halt_address.begin(), halt_address.end(), reg.program_counter) != halt_address.end()){
+                reason = STOP_ADDRESS;
+                break;
+            }
+            cpu.step();
+        }
+    }
+    else{
+        /*Every instruction takes at least 2 cycles, a budget of twice the
+          instructions left cannot run past the instruction limit*/
+        while(cpu.get_cycles() < cycles && cpu.get_instructions() < instructions && cpu.is_halted() == FALSE){
+            budget = cycles - cpu.get_cycles();
+            if((instructions - cpu.get_instructions()) < budget / 2U){
+                budget = (instructions - cpu.get_instructions()) * 2U;
+            }
+            if(clock != 0U){
+                pacer.run(budget);
+            }
+            else{
+                cpu.run(budget);
+            }
+            if(cpu.get_break(NULL) == BREAK_EXECUTE){
+                reason = STOP_ADDRESS;
+                break;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(cpu.is_halted() == TRUE){
+        reason = STOP_UNHANDLED;
+        result = EXIT_HALTED;
+    }
+    else if(reason == STOP_CYCLES && cpu.get_instructions() >= instructions){
+        reason = STOP_INSTRUCTIONS;
+    }
+
+    /*Report*/
+    cpu.dump_register(&reg);
+    switch(reason){
+        case STOP_CYCLES:       printf("Stopped: cycle limit\n"); break;
+        case STOP_INSTRUCTIONS: printf("Stopped: instruction limit\n"); break;
+        case STOP_ADDRESS:      printf("Stopped: halt address $%04X\n", reg.program_counter); break;
+        case STOP_OPCODE:       printf("Stopped: halt opcode $%02X at $%04X\n", memory_space[reg.program_counter], reg.program_counter); break;
+        default:                printf("Stopped: unhandled opcode $%02X at $%04X\n", memory_space[reg.program_counter], reg.program_counter); break;
+    }
+    printf("PC=$%04X A=$%02X X=$%02X Y=$%02X SP=$%02X P=%c%c-%c%c%c%c%c\n", reg.program_counter, reg.accumulator, reg.x, reg.y,
+           (uint8_t)reg.stack_pointer, reg.processor_status.negative ? 'N' : 'n', reg.processor_status.overflow ? 'V' : 'v',
+           reg.processor_status.break_cmd ? 'B' : 'b', reg.processor_status.decimal_mode ? 'D' : 'd',
+           reg.processor_status.irq_disable ? 'I' : 'i', reg.processor_status.zero ? 'Z' : 'z', reg.processor_status.carry ? 'C' : 'c');
+    if(dump_memory(memory_space, dump) < 0){
+        result = EXIT_ERROR;
+    }
+    if(save_state != NULL){
+        FILE* file = fopen(save_state, "wb");
+        value = (file != NULL) ? cpu.save_state(file, image, state_flags) : -1;
+        if(file != NULL && fclose(file) != 0){
+            value = -1;
+        }
+        if(value < 0){
+            fprintf(stderr, "[ ERROR  ] Could not write %s\n", save_state);
+            result = EXIT_ERROR;
+        }
+    }
+    if(clock != 0U){
+        pacer.print_summary(stdout);
+    }
+    if(profiler != NULL){
+        profiler->print_summary(stdout, (unsigned int)top);
+        if(csv != NULL && profiler->export_csv(csv) < 0){
+            fprintf(stderr, "[ ERROR  ] Could not write %s\n", csv);
+            result = EXIT_ERROR;
+        }
+        if(json != NULL && profiler->export_json(json) < 0){
+            fprintf(stderr, "[ ERROR  ] Could not write %s\n", json);
+            result = EXIT_ERROR;
+        }
+    }
+
+    /*One line for scripts*/
+    printf("stats: instructions=%llu cycles=%llu idle_cycles=%llu seconds=%.6f mips=%.3f mhz=%.3f\n",
+           (unsigned long long)cpu.get_instructions(), (unsigned long long)cpu.get_cycles(),
+           (unsigned long long)cpu.get_idle_cycles(), seconds,
+           (seconds > 0.0) ? (cpu.get_instructions() - start_instructions) / seconds / 1e6 : 0.0,
+           (seconds > 0.0) ? (cpu.get_cycles() - start_cycles) / seconds / 1e6 : 0.0);
+
+    delete profiler;
+    free(image);
     free(memory_space);
-    return 0;
+    return result;
 }
@@ -0,0 +1,127 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "z6502_trace.h"
+
+static void usage(const char* name){
+    fprintf(stderr, "Usage: %s [-n count] [-s] trace_file\n", name);
+    fprintf(stderr, "  -n count  Print the first count instructions only\n");
+    fprintf(stderr, "  -s        Print the record count only\n");
+}
+
+/**
+ * @brief Number of operand bytes of an opcode
+ */
+static unsigned int operand_length(uint8_t opcode){
+    switch(instruction_mode[opcode]){
+        case ABS: case ABX: case ABY: case IND: return 2U;
+        case ___: case IMP: case ACC: return 0U;
+        default: return 1U;
+    }
+}
+
+/**
+ * @brief Format the operand of a traced instruction
+ * @param record Record
+ * @param text Output, at least 16 characters
+ */
+static void format_operand(const trace_record_t* record, char* text){
+    uint8_t low = record->operand[0];
+    uint16_t word = record->operand[0] | (record->operand[1] << 8);
+
+    switch(instruction_mode[record->opcode]){
+        case ACC: sprintf(text, "A"); break;
+        case IMM: sprintf(text, "#$%02X", low); break;
+        case ZP:  sprintf(text, "$%02X", low); break;
+        case ZPX: sprintf(text, "$%02X,X", low); break;
+        case ZPY: sprintf(text, "$%02X,Y", low); break;
+        case REL: sprintf(text, "$%04X", (uint16_t)(record->program_counter + 2U + (int8_t)low)); break;
+        case ABS: sprintf(text, "$%04X", word); break;
+        case ABX: sprintf(text, "$%04X,X", word); break;
+        case ABY: sprintf(text, "$%04X,Y", word); break;
+        case IND: sprintf(text, "($%04X)", word); break;
+        case INX: sprintf(text, "($%02X,X)", low); break;
+        case INY: sprintf(text, "($%02X),Y", low); break;
+        default:  text[0] = '\0'; break;
+    }
+}
+
+int main(int argc, char** argv){
+    const char* filename = NULL;
+    uint64_t limit = UINT64_MAX;
+    uint8_t summary = FALSE;
+    trace_reader_t* reader;
+    trace_record_t record;
+    char bytes[16];
+    char operand[16];
+    int result;
+
+    /*Parse arguments*/
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            limit = strtoull(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "-s") == 0){
+            summary = TRUE;
+        }
+        else if(argv[i][0] != '-' && filename == NULL){
+            filename = argv[i];
+        }
+        else{
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if(filename == NULL){
+        usage(argv[0]);
+        return -1;
+    }
+
+    reader = trace_reader_open(filename);
+    if(reader == NULL){
+        fprintf(stderr, "[ ERROR  ] %s is not a readable trace\n", filename);
+        return -1;
+    }
+
+    /*One line per instruction, with the registers it started from*/
+    result = 0;
+    while(reader->count < limit && (result = trace_reader_next(reader, &record)) > 0){
+        if(summary == TRUE){
+            continue;
+        }
+        switch(operand_length(record.opcode)){
+            case 0U: sprintf(bytes, "%02X", record.opcode); break;
+            case 1U: sprintf(bytes, "%02X %02X", record.opcode, record.operand[0]); break;
+            default: sprintf(bytes, "%02X %02X %02X", record.opcode, record.operand[0], record.operand[1]); break;
+        }
+        format_operand(&record, operand);
+        printf("%12llu  %04X  %-8s  %s %-9s  A:%02X X:%02X Y:%02X P:%02X SP:%02X\n",
+               (unsigned long long)record.cycles, record.program_counter, bytes,
+               instruction_mnemonic[instruction_id[record.opcode]], operand,
+               record.accumulator, record.x, record.y, record.status, record.stack_pointer);
+    }
+    if(summary == TRUE || result < 0){
+        printf("%llu instructions, last at cycle %llu\n", (unsigned long long)reader->count,
+               (unsigned long long)(reader->count > 0U ? record.cycles : 0U));
+    }
+    if(result < 0){
+        fprintf(stderr, "[ ERROR  ] %s is truncated or corrupt after %llu records\n", filename,
+                (unsigned long long)reader->count);
+    }
+    trace_reader_close(reader);
+    return (result < 0) ? -1 : 0;
+}
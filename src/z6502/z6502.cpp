@@ -12,648 +12,362 @@
     MIT License for more details.    
 */
 
+#include <stdlib.h>
+#include <strings.h>
 #include "z6502.h"
+#include "z6502_private.h"
+#include "z6502_profile.h"
+#include "z6502_trace.h"
 
-//*****************************************************************************
-// Private functions
-//*****************************************************************************
-
-/**
- * @brief Get operand based on addressing mode
- * @param mem Pointer to memory space
- * @param reg Pointer to register set
- * @param mode Addressing mode
- * @return Operand address or value
- */
-uint16_t _get_operand(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t lo = 0U;
-    uint16_t hi = 0U;
-    uint16_t operand = 0U;
-    switch (mode)
-    {
-        case IMP:
-            /*No operand*/
-            return 0;
-        case ACC:
-            /*No operand*/
-            return 0;
-        case IMM:
-            /*Return 8 bit value*/
-            operand = mem[reg->program_counter];
-            reg->program_counter++;
-            return operand;
-        case ZP:
-            /*Return address in zero page (0x0000-0x00FF)*/
-            operand = mem[reg->program_counter];
-            reg->program_counter++;
-            return operand;
-        case ZPX:
-            /*Return address in zero page (0x0000-0x00FF), indexed by X*/
-            operand = (mem[reg->program_counter] + reg->x) % 256;
-            reg->program_counter++;
-            return operand;
-        case ZPY:
-            /*Return address in zero page (0x0000-0x00FF), indexed by Y*/
-            operand = (mem[reg->program_counter] + reg->y) % 256;
-            reg->program_counter++;
-            return operand;
-        case REL:
-            /*Return branch offset value*/
-            operand = mem[reg->program_counter];
-            reg->program_counter++;
-            return operand;
-        case ABS:
-            /*Return absolute address*/
-            lo = mem[reg->program_counter];
-            hi = mem[reg->program_counter + 1];
-            operand = (hi << 8) | lo;
-            reg->program_counter += 2;
-            return operand;
-        case ABX:
-            /*Return absolute address, indexed by X*/
-            lo = mem[reg->program_counter];
-            hi = mem[reg->program_counter + 1];
-            operand = (((hi << 8) | lo) + reg->x) % 65536;
-            reg->program_counter += 2;
-            return operand;
-        case ABY:
-            /*Return absolute address, indexed by Y*/
-            lo = mem[reg->program_counter];
-            hi = mem[reg->program_counter + 1];
-            operand = (((hi << 8) | lo) + reg->y) % 65536;
-            reg->program_counter += 2;
-            return operand;
-        case IND:
-            /*Return indirect address*/
-            lo = mem[reg->program_counter];
-            hi = mem[reg->program_counter + 1];
-            operand = (hi << 8) | lo;
-            reg->program_counter += 2;
-            return mem[operand] | (mem[(operand + 1) % 65536] << 8);
-        case INX:
-            /*Return X-indexed indirect address*/
-            operand = (mem[reg->program_counter] + reg->x) % 256;
-            lo = mem[operand];
-            hi = mem[(operand + 1) % 256];
-            operand = (hi << 8) | lo;
-            reg->program_counter++;
-            return operand;
-        case INY:
-            /*Return Indirect Y-indexed address*/
-            operand = mem[reg->program_counter];
-            lo = mem[operand];
-            hi = mem[(operand + 1) % 256];
-            operand = ((hi << 8) | lo) + reg->y;
-            reg->program_counter++;
-            return operand;
-        default:
-            return 0;
-    }
-}
 
-/**
- * @brief Update zero flag
- * @param reg Pointer to register set
- * @param value Value to check
- */
-void _update_zero_flag(register_set_t* reg, uint8_t value){
-    if(value == 0U){
-        reg->processor_status.zero = 1U;
-    }
-    else{
-        reg->processor_status.zero = 0U;
-    }
-}
-
-/**
- * @brief Update negative flag
- * @param reg Pointer to register set
- * @param value Value to check
- */
-void _update_negative_flag(register_set_t* reg, uint8_t value){
-    reg->processor_status.negative = (value >> 7) & 0x01;
-}
-
-/**
- * @brief Update carry flag
- * @param reg Pointer to register set
- * @param value Value to check (uint16_t)
- */
-void _update_carry_flag(register_set_t* reg, uint16_t value){
-    if(value > 0xFF){
-        reg->processor_status.carry = 1U;
-    }
-    else{
-        reg->processor_status.carry = 0U;
-    }
+Z6502::Z6502(uint8_t* memory_space)
+{
+    _memory.decoded = NULL;
+    _memory.jit = NULL;
+    _memory.owned = NULL;
+    _memory.replay = NULL;
+    _memory.replaying = FALSE;
+    _memory.debug = NULL;
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        _memory.code_page[page] = FALSE;
+        _memory.shared[page] = NULL;
+    }
+    map_memory(0U, Z6502_PAGE_COUNT, memory_space, FALSE);
+    _cycles = 0U;
+    _instructions = 0U;
+    _halted = FALSE;
+    _stop_requested = FALSE;
+    _stop_by_user = FALSE;
+    _event_count = 0U;
+    _event_serial = 0U;
+    _irq_lines = 0U;
+    _nmi_pending = FALSE;
+    _idle_skip = FALSE;
+    _idle_cycles = 0U;
+    _idle_interval = Z6502_IDLE_CHECK_MIN_CYCLES;
+    _core = Z6502_DEFAULT_CORE;
+    _timing = TIMING_FAST;
+    _tracer = NULL;
+    _profiler = NULL;
+    _break.kind = BREAK_NONE;
+    _coverage = NULL;
+    _coverage_previous = 0U;
+    _coverage_new = 0U;
 }
 
-/**
- * @brief Update overflow flag
- * @param reg Pointer to register set
- * @param a First operand
- * @param b Second operand
- * @param result Result of the operation
- */
-void _update_overflow_flag(register_set_t* reg, uint8_t a, uint8_t b, uint8_t result){
-    if(((a ^ result) & (b ^ result) & 0x80) != 0U){
-        reg->processor_status.overflow = 1U;
-    }
-    else{
-        reg->processor_status.overflow = 0U;
-    }
-}
+void Z6502::reset(void) {
+    /*Init special purpose registers*/
+    _reg.program_counter = 0U;
+    _reg.stack_pointer = 0U;
+    _reg.accumulator = 0U;
+    _reg.x = 0U;
+    _reg.y = 0U;
 
-/**
- * @brief Pull a byte from the stack
- * @param mem Pointer to memory space
- * @param reg Pointer to register set
- * @param value Pointer to store the pulled value
- */
-void _pull_stack(uint8_t* mem, register_set_t* reg, uint8_t* value){
-    reg->stack_pointer = (reg->stack_pointer + 1U) % 256;
-    *value = mem[0x0100 + reg->stack_pointer];
-}
+    _reg.processor_status.carry = 0U;
+    _reg.processor_status.irq_disable = 0U;
+    _reg.processor_status.decimal_mode = 0U;
+    _reg.processor_status.overflow = 0U;
+    /*Z and N clear*/
+    _reg.processor_status.zero_result = 1U;
+    _reg.processor_status.negative_result = 0U;
 
-/**
- * @brief Push a byte onto the stack
- * @param mem Pointer to memory space
- * @param reg Pointer to register set
- * @param value Value to push onto the stack
- */
-void _push_stack(uint8_t* mem, register_set_t* reg, uint8_t value){
-    mem[0x0100 + reg->stack_pointer] = value;
-    reg->stack_pointer = (reg->stack_pointer - 1U) % 256;
+    _halted = FALSE;
 }
 
-/**
- * @brief Pull processor status from the stack
- * @param mem Pointer to memory space
- * @param reg Pointer to register set
- */
-void _pull_register_stack(uint8_t* mem, register_set_t* reg){
-    uint8_t tmp;
-    reg->stack_pointer = (reg->stack_pointer + 1U) % 256;
-    tmp = mem[0x0100 + reg->stack_pointer];
-    reg->processor_status.negative = (tmp >> 7) & 0x01;
-    reg->processor_status.overflow = (tmp >> 6) & 0x01;
-    reg->processor_status.decimal_mode = (tmp >> 3) & 0x01;
-    reg->processor_status.irq_disable = (tmp >> 2) & 0x01;
-    reg->processor_status.zero = (tmp >> 1) & 0x01;
-    reg->processor_status.carry = tmp & 0x01;
-}
+int Z6502::step(void) {
+    uint8_t stop_pending;
+    int cycles;
 
-/**
- * @brief Push processor status onto the stack
- * @param mem Pointer to memory space
- * @param reg Pointer to register set
- */
-void _push_register_stack(uint8_t* mem, register_set_t* reg){
-    mem[0x0100 + reg->stack_pointer] = (uint8_t)(reg->processor_status.negative << 7 |
-                                                 reg->processor_status.overflow << 6 |
-                                                 1 << 5 |
-                                                 1 << 4 |
-                                                 reg->processor_status.decimal_mode << 3 |
-                                                 reg->processor_status.irq_disable << 2 |
-                                                 reg->processor_status.zero << 1 |
-                                                 reg->processor_status.carry);
-    reg->stack_pointer = (reg->stack_pointer - 1U) % 256;
-}
+    _break.kind = BREAK_NONE;
+    if(_memory.debug != NULL){
+        /*Stepping executes the instruction even when a breakpoint is set on it*/
+        _memory.debug->resume_address = _reg.program_counter;
+        _memory.debug->resume_cycles = _cycles;
+    }
+    if(_is_scheduled() == TRUE || _is_instrumented() == TRUE){
+        /*Events, then an interrupt entry or one instruction. A stop() made
+          before the step is kept for run(), one made by the step is dropped*/
+        stop_pending = _stop_by_user;
+        _stop_by_user = FALSE;
+        _stop_requested = FALSE;
+        cycles = (_is_scheduled() == TRUE) ? (int)_run_scheduled(1U) : (int)_run_instrumented(1U);
+        _stop_by_user = stop_pending;
+        _stop_requested = stop_pending;
+        return cycles;
+    }
 
-//*****************************************************************************
-// Instruction implementations
-//*****************************************************************************
+    /*Read instruction*/
+    uint8_t opcode = _mem_read(&_memory, _reg.program_counter);
 
-void _op_ADC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint8_t tmp;
-    uint16_t res;
-    if(mode == IMM){
-        tmp = _get_operand(mem, reg, mode);
-    }
-    else{
-        tmp = mem[_get_operand(mem, reg, mode)];
-    }
-    res += tmp + reg->processor_status.carry;
-    _update_overflow_flag(reg, reg->accumulator, tmp, res);
-    _update_carry_flag(reg, res);
-    reg->accumulator = (uint8_t)(res % 256);
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_AND(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    if (mode == IMM) {
-        reg->accumulator &= (uint8_t)_get_operand(mem, reg, mode);
-    }
-    else{
-        reg->accumulator &= mem[_get_operand(mem, reg, mode)];
-    }
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_ASL(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t addr;
-    if (mode == ACC) {
-        reg->processor_status.carry = (reg->accumulator >> 7) & 0x01;
-        reg->accumulator = (reg->accumulator << 1);
-        _update_zero_flag(reg, reg->accumulator);
-        _update_negative_flag(reg, reg->accumulator);
-    }
-    else{
-        addr = _get_operand(mem, reg, mode);
-        reg->processor_status.carry = (mem[addr] >> 7) & 0x01;
-        mem[addr] = (mem[addr] << 1);
-        _update_zero_flag(reg, mem[addr]);
-        _update_negative_flag(reg, mem[addr]);
-    }
-}
-void _op_BCC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.carry == 0U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BCS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.carry == 1U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BEQ(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.zero == 1U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BIT(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint8_t tmp = mem[_get_operand(mem, reg, mode)];
-    _update_zero_flag(reg, reg->accumulator & tmp);
-    _update_negative_flag(reg, tmp);
-    reg->processor_status.overflow = (tmp >> 6) & 0x01;
-}
-void _op_BMI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.negative == 1U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BNE(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.zero == 0U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BPL(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.negative == 0U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BRK(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t addr = (reg->program_counter + 2U) % 65536;
-    _push_stack(mem, reg, (uint8_t)((addr >> 8) & 0x00FF));
-    _push_stack(mem, reg, (uint8_t)(addr & 0x00FF));
-    _push_register_stack(mem, reg);
-    reg->program_counter = Z6502_IRQ_VECTOR_ADDRESS;
-    reg->processor_status.irq_disable = 1U;
-}
-void _op_BVC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.overflow == 0U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_BVS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t addr = _get_operand(mem, reg, mode);
-    if (reg->processor_status.overflow == 1U){
-        reg->program_counter = (reg->program_counter + 2 + addr) % 65536;
-    }
-}
-void _op_CLC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.carry = 0U;
-}
-void _op_CLD(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.decimal_mode = 0U;
-}
-void _op_CLI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.irq_disable = 0U;
-}
-void _op_CLV(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.overflow = 0U;
-}
-void _op_CMP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t tmp;
-    if (mode == IMM){
-        tmp = _get_operand(mem, reg, mode);
-    }
-    else{
-        tmp = mem[_get_operand(mem, reg, mode)];
-    }
-    tmp = reg->accumulator - tmp;
-    reg->processor_status.carry = (tmp >= 0)?1U:0U;
-    reg->processor_status.zero = (tmp == 0)?1U:0U;
-    reg->processor_status.negative = (tmp >> 7) & 0x01;
-}
-void _op_CPX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t tmp;
-    if (mode == IMM){
-        tmp = _get_operand(mem, reg, mode);
-    }
-    else{
-        tmp = mem[_get_operand(mem, reg, mode)];
-    }
-    tmp = reg->x - tmp;
-    reg->processor_status.carry = (tmp >= 0)?1U:0U;
-    reg->processor_status.zero = (tmp == 0)?1U:0U;
-    reg->processor_status.negative = (tmp >> 7) & 0x01;
-}
-void _op_CPY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    int8_t tmp;
-    if (mode == IMM){
-        tmp = _get_operand(mem, reg, mode);
-    }
-    else{
-        tmp = mem[_get_operand(mem, reg, mode)];
-    }
-    tmp = reg->y - tmp;
-    reg->processor_status.carry = (tmp >= 0)?1U:0U;
-    reg->processor_status.zero = (tmp == 0)?1U:0U;
-    reg->processor_status.negative = (tmp >> 7) & 0x01;
-}
-void _op_DEC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t addr = _get_operand(mem, reg, mode);
-    mem[addr] = (mem[addr] - 1U) % 256;
-    _update_zero_flag(reg, mem[addr]);
-    _update_negative_flag(reg, mem[addr]);
-}
-void _op_DEX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->x = (reg->x - 1U) % 256;
-    _update_zero_flag(reg, reg->x);
-    _update_negative_flag(reg, reg->x);
-}
-void _op_DEY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->y = (reg->y - 1U) % 256;
-    _update_zero_flag(reg, reg->y);
-    _update_negative_flag(reg, reg->y);
-}
-void _op_EOR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    if (mode == IMM) {
-        reg->accumulator ^= (uint8_t)_get_operand(mem, reg, mode);
-    }
-    else{
-        reg->accumulator ^= mem[_get_operand(mem, reg, mode)];
-    }
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_INC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t addr = _get_operand(mem, reg, mode);
-    mem[addr] = (mem[addr] + 1U) % 256;
-    _update_zero_flag(reg, mem[addr]);
-    _update_negative_flag(reg, mem[addr]);
-}
-void _op_INX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->x = (reg->x + 1U) % 256;
-    _update_zero_flag(reg, reg->x);
-    _update_negative_flag(reg, reg->x);
-}
-void _op_INY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->y = (reg->y + 1U) % 256;
-    _update_zero_flag(reg, reg->y);
-    _update_negative_flag(reg, reg->y);
-}
-void _op_JMP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->program_counter = _get_operand(mem, reg, mode);
-}
-void _op_JSR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t tmp = (reg->program_counter + 2U) % 65536;
-    _push_stack(mem, reg, (uint8_t)((tmp >> 8) & 0x00FF));
-    _push_stack(mem, reg, (uint8_t)(tmp & 0x00FF));
-    reg->program_counter = _get_operand(mem, reg, mode);
-}
-void _op_LDA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    if (mode == IMM) {
-        reg->accumulator = _get_operand(mem, reg, mode);
-    }
-    else{
-        reg->accumulator = mem[_get_operand(mem, reg, mode)];
-    }
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_LDX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    if (mode == IMM) {
-        reg->x = _get_operand(mem, reg, mode);
-    }
-    else{
-        reg->x = mem[_get_operand(mem, reg, mode)];
-    }
-    _update_zero_flag(reg, reg->x);
-    _update_negative_flag(reg, reg->x);
-}
-void _op_LDY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    if (mode == IMM) {
-        reg->y = _get_operand(mem, reg, mode);
-    }
-    else{
-        reg->y = mem[_get_operand(mem, reg, mode)];
+    /*Execute instruction*/
+    if(instruction_set[opcode] == NULL){
+        /*Unhandled opcode, stay on it*/
+        _halted = TRUE;
+        return 0;
     }
-    _update_zero_flag(reg, reg->y);
-    _update_negative_flag(reg, reg->y);
-}
-void _op_LSR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint16_t addr;
-    if (mode == ACC) {
-        reg->processor_status.carry = reg->accumulator & 0x01;
-        reg->accumulator = (reg->accumulator >> 1);
-        _update_zero_flag(reg, reg->accumulator);
-        _update_negative_flag(reg, reg->accumulator);
+    _reg.program_counter++;
+    if(_timing == TIMING_ACCURATE){
+        cycles = accurate_instruction_set[opcode](&_memory, &_reg);
     }
     else{
-        addr = _get_operand(mem, reg, mode);
-        reg->processor_status.carry = mem[addr] & 0x01;
-        mem[addr] = (mem[addr] >> 1);
-        _update_zero_flag(reg, mem[addr]);
-        _update_negative_flag(reg, mem[addr]);
+        instruction_set[opcode](&_memory, &_reg);
+        cycles = instruction_cycles[opcode];
     }
+
+    _cycles += cycles;
+    _instructions++;
+    return cycles;
 }
-void _op_NOP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    return;
-}
-void _op_ORA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    if (mode == IMM) {
-        reg->accumulator |= (uint8_t)_get_operand(mem, reg, mode);
-    }
-    else{
-        reg->accumulator |= mem[_get_operand(mem, reg, mode)];
+
+uint64_t Z6502::run(uint64_t cycle_budget) {
+    uint64_t spent = 0U;
+
+    _break.kind = BREAK_NONE;
+    while(spent < cycle_budget && _halted == FALSE && _stop_by_user == FALSE){
+        if(_is_scheduled() == TRUE || _idle_skip == TRUE){
+            spent += _run_scheduled(cycle_budget - spent);
+        }
+        else if(_begin_slice() == FALSE){
+            /*Nothing scheduled, run uninterrupted. A device raising an
+              interrupt, scheduling an event or setting a breakpoint ends the
+              batch, the loop then goes on with what it asked for*/
+            spent += _dispatch(cycle_budget - spent);
+        }
     }
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_PHA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    _push_stack(mem, reg, reg->accumulator);
-}
-void _op_PHP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    _push_register_stack(mem, reg);
-}
-void _op_PLA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    _pull_stack(mem,reg, &reg->accumulator);
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_PLP(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    _pull_register_stack(mem, reg);
+
+    /*Cleared on return, not on entry, so that a stop() made between two
+      calls is not lost*/
+    _stop_by_user = FALSE;
+    _stop_requested = FALSE;
+    return spent;
 }
-void _op_ROL(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint8_t c;
-    uint16_t addr;
-    if (mode == ACC) {
-        c = (reg->accumulator >> 7) & 0x01;
-        reg->accumulator = (reg->accumulator << 1) | (reg->processor_status.carry);
-        reg->processor_status.carry = c;
-        _update_zero_flag(reg, reg->accumulator);
-        _update_negative_flag(reg, reg->accumulator);
-    }
-    else{
-        addr = _get_operand(mem, reg, mode);
-        c = (mem[addr] >> 7) & 0x01;
-        mem[addr] = (mem[addr] << 1) | (reg->processor_status.carry);
-        reg->processor_status.carry = c;
-        _update_zero_flag(reg, mem[addr]);
-        _update_negative_flag(reg, mem[addr]);
+
+uint64_t Z6502::_dispatch(uint64_t cycle_budget) {
+    if(_is_instrumented() == TRUE){
+        return _run_instrumented(cycle_budget);
+    }
+    if(_timing == TIMING_ACCURATE){
+        /*Translated blocks count base cycles only, the JIT core runs the cache*/
+        switch(_core){
+            case CORE_SWITCH:
+                return _run_switch<timing_accurate_t>(cycle_budget);
+            case CORE_CACHE:
+            case CORE_JIT:
+                return _run_cached<timing_accurate_t>(cycle_budget);
+            default:
+                return _run_table<timing_accurate_t>(cycle_budget);
+        }
+    }
+    switch(_core){
+        case CORE_SWITCH:
+            return _run_switch<timing_fast_t>(cycle_budget);
+        case CORE_CACHE:
+            return _run_cached<timing_fast_t>(cycle_budget);
+        case CORE_JIT:
+            return _run_jit(cycle_budget);
+        default:
+            return _run_table<timing_fast_t>(cycle_budget);
     }
 }
-void _op_ROR(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint8_t c;
-    uint16_t addr;
-    if (mode == ACC) {
-        c = reg->accumulator & 0x01;
-        reg->accumulator = (reg->accumulator >> 1) | (reg->processor_status.carry << 7);
-        reg->processor_status.carry = c;
-        _update_zero_flag(reg, reg->accumulator);
-        _update_negative_flag(reg, reg->accumulator);
-    }
-    else{
-        addr = _get_operand(mem, reg, mode);
-        c = mem[addr] & 0x01;
-        mem[addr] = (mem[addr] >> 1) | (reg->processor_status.carry << 7);
-        reg->processor_status.carry = c;
-        _update_zero_flag(reg, mem[addr]);
-        _update_negative_flag(reg, mem[addr]);
+
+template<typename TIMING>
+uint64_t Z6502::_run_table(uint64_t cycle_budget) {
+    /*Work on local copies for the whole batch*/
+    cpu_state_t reg = _reg;
+    memory_t* mem = &_memory;
+    uint64_t spent = 0U;
+    uint64_t executed = 0U;
+    uint8_t opcode;
+
+    while(spent < cycle_budget && _stop_requested == FALSE){
+        /*Read instruction*/
+        opcode = _mem_read(mem, reg.program_counter);
+        if(instruction_set[opcode] == NULL){
+            /*Unhandled opcode, stay on it*/
+            _halted = TRUE;
+            break;
+        }
+        reg.program_counter++;
+        executed++;
+
+        /*Execute instruction*/
+        if constexpr (TIMING::accurate){
+            spent += accurate_instruction_set[opcode](mem, &reg);
+        }
+        else{
+            instruction_set[opcode](mem, &reg);
+            spent += instruction_cycles[opcode];
+        }
     }
-    
-}
-void _op_RTI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    _pull_register_stack(mem, reg);
-    _pull_stack(mem, reg, (uint8_t*)&reg->program_counter);
-    _pull_stack(mem, reg, (uint8_t*)&reg->program_counter + 1);
-}
-void _op_RTS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    _pull_stack(mem, reg, (uint8_t*)&reg->program_counter);
-    _pull_stack(mem, reg, (uint8_t*)&reg->program_counter + 1);
-    reg->program_counter++;
+
+    _reg = reg;
+    _cycles += spent;
+    _instructions += executed;
+    return spent;
 }
-void _op_SBC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    uint8_t tmp;
-    uint16_t res;
-    if(mode == IMM){
-        tmp = _get_operand(mem, reg, mode);
-    }
-    else{
-        tmp = mem[_get_operand(mem, reg, mode)];
+
+template uint64_t Z6502::_run_table<timing_fast_t>(uint64_t cycle_budget);
+template uint64_t Z6502::_run_table<timing_accurate_t>(uint64_t cycle_budget);
+
+uint64_t Z6502::_run_instrumented(uint64_t cycle_budget) {
+    /*Work on local copies for the whole batch*/
+    cpu_state_t reg = _reg;
+    memory_t* mem = &_memory;
+    Z6502Tracer* tracer = _tracer;
+    Z6502Profiler* profiler = _profiler;
+    struct debug_s* debug = _memory.debug;
+    uint8_t* coverage = _coverage;
+    uint64_t spent = 0U;
+    uint64_t executed = 0U;
+    uint16_t edge;
+    trace_record_t record;
+    decoded_handler_t handler;
+    uint16_t operand;
+    uint8_t length;
+    uint8_t cycles;
+
+    while(spent < cycle_budget && _stop_requested == FALSE){
+        if(debug != NULL){
+            if(_bitmap_test(debug->execute, reg.program_counter) != 0U && _break_at(&reg, _cycles + spent) == TRUE){
+                break;
+            }
+            debug->program_counter = reg.program_counter;
+            debug->fetching = TRUE;
+        }
+
+        /*Fetch the instruction bytes once, as the other cores do*/
+        record.program_counter = reg.program_counter;
+        record.opcode = _mem_read(mem, reg.program_counter);
+        handler = decoded_instruction_set[record.opcode];
+        if(handler == NULL){
+            /*Unhandled opcode, stay on it*/
+            _halted = TRUE;
+            if(debug != NULL){
+                debug->fetching = FALSE;
+            }
+            break;
+        }
+        length = _operand_length(instruction_mode[record.opcode]);
+        record.operand[0] = (length >= 1U) ? _mem_read(mem, (uint16_t)(reg.program_counter + 1U)) : 0U;
+        record.operand[1] = (length == 2U) ? _mem_read(mem, (uint16_t)(reg.program_counter + 2U)) : 0U;
+        operand = record.operand[0] | (record.operand[1] << 8);
+        if(debug != NULL){
+            debug->fetching = FALSE;
+        }
+
+        if(coverage != NULL){
+            edge = (uint16_t)(_coverage_previous ^ record.program_counter);
+            if(_bitmap_test(coverage, edge) == 0U){
+                coverage[edge >> 3] |= (uint8_t)(1U << (edge & 7U));
+                _coverage_new++;
+            }
+            _coverage_previous = record.program_counter >> 1;
+        }
+
+        if(tracer != NULL){
+            record.cycles = _cycles + spent;
+            record.accumulator = reg.accumulator;
+            record.x = reg.x;
+            record.y = reg.y;
+            record.stack_pointer = (uint8_t)reg.stack_pointer;
+            record.status = _pack_status(&reg);
+            tracer->push(&record);
+        }
+
+        /*Execute instruction, the handler moves the program counter*/
+        handler(mem, &reg, operand);
+        cycles = instruction_cycles[record.opcode];
+        if(_timing == TIMING_ACCURATE){
+            cycles += _penalty_cycles<timing_accurate_t>(mem, &reg, record.opcode, operand,
+                                                         (uint16_t)(record.program_counter + 1U + length));
+        }
+        if(profiler != NULL){
+            profiler->count(record.program_counter, record.opcode, cycles);
+        }
+        spent += cycles;
+        executed++;
+
+        if(debug != NULL && debug->hit.kind != BREAK_NONE){
+            /*Watchpoint hit, stop after the instruction*/
+            _break = debug->hit;
+            debug->hit.kind = BREAK_NONE;
+            _stop_requested = TRUE;
+            _stop_by_user = TRUE;
+        }
     }
-    res = reg->accumulator - tmp - (1U - reg->processor_status.carry);
-    _update_overflow_flag(reg, reg->accumulator, ~tmp, res);
-    _update_carry_flag(reg, res);
-    reg->accumulator = (uint8_t)(res % 256);
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_SEC(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.carry = 1U;
-}
-void _op_SED(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.decimal_mode = 1U;
-}
-void _op_SEI(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->processor_status.irq_disable = 1U;
-}
-void _op_STA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    mem[_get_operand(mem, reg, mode)] = reg->accumulator;
-}
-void _op_STX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    mem[_get_operand(mem, reg, mode)] = reg->x;
-}
-void _op_STY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    mem[_get_operand(mem, reg, mode)] = reg->y;
-}
-void _op_TAX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->x = reg->accumulator;
-    _update_zero_flag(reg, reg->x);
-    _update_negative_flag(reg, reg->x);
-}
-void _op_TAY(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->y = reg->accumulator;
-    _update_zero_flag(reg, reg->y);
-    _update_negative_flag(reg, reg->y);
-}
-void _op_TSX(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->x = reg->stack_pointer;
-    _update_zero_flag(reg, reg->x);
-    _update_negative_flag(reg, reg->x);
-}
-void _op_TXA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->accumulator = reg->x;
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
-}
-void _op_TXS(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->stack_pointer = reg->x;
-}
-void _op_TYA(uint8_t* mem, register_set_t* reg, addressing_mode_t mode){
-    reg->accumulator = reg->y;
-    _update_zero_flag(reg, reg->accumulator);
-    _update_negative_flag(reg, reg->accumulator);
+
+    _reg = reg;
+    _cycles += spent;
+    _instructions += executed;
+    return spent;
 }
 
+register_set_t* Z6502::dump_register(register_set_t* register_set){
+    register_set->program_counter = _reg.program_counter;
+    register_set->stack_pointer = _reg.stack_pointer;
+    register_set->accumulator = _reg.accumulator;
+    register_set->x = _reg.x;
+    register_set->y = _reg.y;
 
-Z6502::Z6502(uint8_t* memory_space)
-{
-    _memory_space = memory_space;
+    register_set->processor_status.carry = _reg.processor_status.carry;
+    register_set->processor_status.zero = _zero_flag(&_reg);
+    register_set->processor_status.irq_disable = _reg.processor_status.irq_disable;
+    register_set->processor_status.decimal_mode = _reg.processor_status.decimal_mode;
+    register_set->processor_status.break_cmd = 0U;
+    register_set->processor_status.overflow = _reg.processor_status.overflow;
+    register_set->processor_status.negative = _negative_flag(&_reg);
+    return register_set;
 }
 
-void Z6502::reset(void) {
-    /*Init special purpose registers*/
-    _reg.program_counter = 0U;
-    _reg.stack_pointer = 0U;
-    _reg.accumulator = 0U;
-    _reg.x = 0U;
-    _reg.y = 0U;
+void Z6502::load_register(const register_set_t* register_set){
+    _reg.program_counter = register_set->program_counter;
+    _reg.stack_pointer = register_set->stack_pointer % 256;
+    _reg.accumulator = register_set->accumulator;
+    _reg.x = register_set->x;
+    _reg.y = register_set->y;
 
-    _reg.processor_status.carry = 0U;
-    _reg.processor_status.zero = 0U;
-    _reg.processor_status.irq_disable = 0U;
-    _reg.processor_status.decimal_mode = 0U;
-    _reg.processor_status.break_cmd = 0U;
-    _reg.processor_status.overflow = 0U;
-    _reg.processor_status.negative = 0U;
+    _reg.processor_status.carry = register_set->processor_status.carry & 0x01;
+    _reg.processor_status.irq_disable = register_set->processor_status.irq_disable & 0x01;
+    _reg.processor_status.decimal_mode = register_set->processor_status.decimal_mode & 0x01;
+    _reg.processor_status.overflow = register_set->processor_status.overflow & 0x01;
+    _reg.processor_status.zero_result = (register_set->processor_status.zero != 0U) ? 0U : 1U;
+    _reg.processor_status.negative_result = (register_set->processor_status.negative != 0U) ? 0x80U : 0U;
 }
 
-int Z6502::step(void) {
-    /*Read instruction*/
-    uint8_t opcode = _memory_space[_reg.program_counter];
-    _reg.program_counter++;
+uint8_t Z6502::get_status(void){
+    return _pack_status(&_reg);
+}
 
-    /*Execute instruction*/
-    if(instruction_set[opcode] != NULL){
-        instruction_set[opcode](_memory_space, &_reg, instruction_mode[opcode]);
-    }
-    else{
-        //Unhandled opcode
+Z6502::~Z6502()
+{
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        _release_snapshot_page(_memory.shared[page]);
     }
+    free(_memory.owned);
+    free(_memory.decoded);
+    _jit_free(_memory.jit);
+    delete _memory.debug;
+}
 
-    return 0;
+/*Core names, as given to the tools*/
+static const char* const core_names[] = {"table", "switch", "cache", "jit"};
+static const core_t core_values[] = {CORE_TABLE, CORE_SWITCH, CORE_CACHE, CORE_JIT};
+
+int core_parse_name(const char* name, core_t* core){
+    for(unsigned int i = 0U; i < sizeof(core_values) / sizeof(core_values[0]); i++){
+        if(strcasecmp(name, core_names[i]) == 0){
+            *core = core_values[i];
+            return 0;
+        }
+    }
+    return -1;
 }
 
-Z6502::~Z6502()
-{
-}
\ No newline at end of file
+const char* core_get_name(core_t core){
+    for(unsigned int i = 0U; i < sizeof(core_values) / sizeof(core_values[0]); i++){
+        if(core_values[i] == core){
+            return core_names[i];
+        }
+    }
+    return "unknown";
+}
\ No newline at end of file
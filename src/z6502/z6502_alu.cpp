@@ -0,0 +1,127 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Decimal mode tables of ADC and SBC, filled on first use. They follow
+    the NMOS 6502: the accumulator always holds the BCD result (invalid BCD
+    operands included), ADC takes N and V from the sum before the high
+    digit is adjusted and Z from the binary sum, SBC sets every flag as in
+    binary mode. Binary mode and compares are computed inline, see _adc(),
+    _sbc() and _compare() in z6502_private.h.
+*/
+
+#include "z6502.h"
+#include "z6502_private.h"
+
+/*Table entries: carry in, accumulator and operand*/
+#define Z6502_ALU_TABLE_ENTRIES 0x20000U
+
+/**
+ * @brief Decimal mode ADC
+ * @returns Result in the low byte, N, V and C in the high byte
+ */
+static uint16_t _decimal_adc(unsigned int carry, unsigned int a, unsigned int b){
+    int low = (int)((a & 0x0FU) + (b & 0x0FU) + carry);
+    int sum = 0;
+    int signed_sum = 0;
+    unsigned int flags = 0U;
+
+    if(low >= 0x0A){
+        low = ((low + 0x06) & 0x0F) + 0x10;
+    }
+    sum = (int)((a & 0xF0U) + (b & 0xF0U)) + low;
+    signed_sum = (int8_t)(a & 0xF0U) + (int8_t)(b & 0xF0U) + low;
+    flags = (sum & 0x80) | ((signed_sum < -128 || signed_sum > 127) ? 0x40U : 0U);
+    if(sum >= 0xA0){
+        sum += 0x60;
+    }
+    flags |= (sum >= 0x100) ? 0x01U : 0U;
+    return (uint16_t)((flags << 8) | (sum & 0xFF));
+}
+
+/**
+ * @brief Decimal mode SBC
+ * @returns Result
+ */
+static uint8_t _decimal_sbc(unsigned int carry, unsigned int a, unsigned int b){
+    int low = (int)(a & 0x0FU) - (int)(b & 0x0FU) + (int)carry - 1;
+    int difference = 0;
+
+    if(low < 0){
+        low = ((low - 0x06) & 0x0F) - 0x10;
+    }
+    difference = (int)(a & 0xF0U) - (int)(b & 0xF0U) + low;
+    if(difference < 0){
+        difference -= 0x60;
+    }
+    return (uint8_t)(difference & 0xFF);
+}
+
+/*Decimal mode results per table entry*/
+typedef struct
+{
+    uint16_t adc[Z6502_ALU_TABLE_ENTRIES];  /* Result in the low byte, N, V and C at their P register positions in the high byte */
+    uint8_t sbc[Z6502_ALU_TABLE_ENTRIES];   /* Result */
+} alu_tables_t;
+
+/**
+ * @brief Fill the tables
+ * @returns TRUE
+ */
+static uint8_t _alu_fill(alu_tables_t* tables){
+    for(unsigned int index = 0U; index < Z6502_ALU_TABLE_ENTRIES; index++){
+        tables->adc[index] = _decimal_adc(index >> 16, (index >> 8) & 0xFFU, index & 0xFFU);
+        tables->sbc[index] = _decimal_sbc(index >> 16, (index >> 8) & 0xFFU, index & 0xFFU);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Get the tables, filled by the first decimal mode ADC or SBC. The
+ *        local static makes this thread safe and independent of the order
+ *        static objects of other files are built in, an instance may run
+ *        from one of them. A loop is a few hundred microseconds, building
+ *        the tables as constant expressions cost seconds of compile time.
+ */
+static const alu_tables_t* _alu_tables(void){
+    static alu_tables_t tables;
+    static const uint8_t filled = _alu_fill(&tables);
+
+    (void)filled;
+    return &tables;
+}
+
+/**
+ * @brief Index of the tables
+ */
+static inline uint32_t _alu_index(const cpu_state_t* reg, uint8_t value){
+    return ((uint32_t)reg->processor_status.carry << 16) | ((uint32_t)reg->accumulator << 8) | value;
+}
+
+void _adc_decimal(cpu_state_t* reg, uint8_t value){
+    uint16_t decimal = _alu_tables()->adc[_alu_index(reg, value)];
+
+    reg->processor_status.zero_result = (uint8_t)(reg->accumulator + value + reg->processor_status.carry);
+    reg->processor_status.negative_result = (uint8_t)(decimal >> 8);
+    reg->processor_status.overflow = (decimal >> 14) & 0x01U;
+    reg->processor_status.carry = (decimal >> 8) & 0x01U;
+    reg->accumulator = (uint8_t)decimal;
+}
+
+void _sbc_decimal(cpu_state_t* reg, uint8_t value){
+    uint8_t decimal = _alu_tables()->sbc[_alu_index(reg, value)];
+
+    _add(reg, (uint8_t)~value);
+    reg->accumulator = decimal;
+}
@@ -0,0 +1,122 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Paged memory bus. Each of the 256 pages is mapped to memory, to a device
+    or to nothing. Memory pages get direct read and write pointers in
+    memory_t so that RAM accesses stay a table lookup and a load or store.
+    Everything else (devices, ROM writes, unmapped pages, stores to pages
+    holding predecoded code, first stores to pages shared with a snapshot
+    and accesses to pages holding a watchpoint) goes through the slow path
+    below.
+*/
+
+#include <stdlib.h>
+#include "z6502.h"
+#include "z6502_private.h"
+
+uint8_t _bus_read(memory_t* mem, uint16_t addr){
+    const page_map_t* map = &mem->page_map[addr >> 8];
+    uint8_t value;
+
+    if(map->base != NULL){
+        /*Memory page watched for reads*/
+        value = map->base[addr & 0xFFU];
+    }
+    else if(map->device == NULL || map->device->read == NULL){
+        value = Z6502_OPEN_BUS_VALUE;
+    }
+    else if(mem->replay != NULL){
+        value = _replay_read(mem, map->device, addr);
+    }
+    else{
+        value = map->device->read(map->device->context, addr);
+    }
+    if(mem->debug != NULL){
+        _debug_access(mem, addr, value, BREAK_READ);
+    }
+    return value;
+}
+
+void _bus_write(memory_t* mem, uint16_t addr, uint8_t value){
+    uint8_t page = addr >> 8;
+    const device_t* device = mem->page_map[page].device;
+
+    if(mem->debug != NULL){
+        _debug_access(mem, addr, value, BREAK_WRITE);
+    }
+    if(device != NULL){
+        if(device->write != NULL && mem->replaying == FALSE){
+            device->write(device->context, addr, value);
+        }
+    }
+    else if(mem->page_map[page].base != NULL && mem->page_map[page].read_only == FALSE){
+        if(mem->shared[page] != NULL && _unshare_page(mem, page) < 0){
+            return;
+        }
+        mem->page_map[page].base[addr & 0xFFU] = value;
+        if(mem->code_page[page] != FALSE){
+            _invalidate_code_page(mem, page);
+        }
+    }
+}
+
+void _remap_page(memory_t* mem, uint8_t page){
+    if(mem->code_page[page] != FALSE){
+        _invalidate_code_page(mem, page);
+    }
+    if(mem->jit != NULL){
+        _jit_unmap_page(mem->jit, page);
+    }
+    mem->read_page[page] = _page_readable(mem, page) ? mem->page_map[page].base : NULL;
+    mem->write_page[page] = _page_writable(mem, page) ? mem->page_map[page].base : NULL;
+}
+
+int Z6502::map_memory(uint8_t first_page, unsigned int page_count, uint8_t* memory, uint8_t read_only){
+    page_map_t* map;
+
+    if(first_page + page_count > Z6502_PAGE_COUNT){
+        return -1;
+    }
+
+    for(unsigned int i = 0U; i < page_count; i++){
+        map = &_memory.page_map[first_page + i];
+        _release_snapshot_page(_memory.shared[first_page + i]);
+        _memory.shared[first_page + i] = NULL;
+        map->base = (memory != NULL) ? &memory[i * Z6502_PAGE_SIZE_BYTES] : NULL;
+        map->device = NULL;
+        map->read_only = (read_only != FALSE) ? TRUE : FALSE;
+        _remap_page(&_memory, first_page + i);
+    }
+    return 0;
+}
+
+int Z6502::map_device(uint8_t first_page, unsigned int page_count, const device_t* device){
+    page_map_t* map;
+
+    if(first_page + page_count > Z6502_PAGE_COUNT || device == NULL){
+        return -1;
+    }
+
+    for(unsigned int i = 0U; i < page_count; i++){
+        map = &_memory.page_map[first_page + i];
+        _release_snapshot_page(_memory.shared[first_page + i]);
+        _memory.shared[first_page + i] = NULL;
+        map->base = NULL;
+        map->device = device;
+        map->read_only = FALSE;
+        _remap_page(&_memory, first_page + i);
+    }
+    return 0;
+}
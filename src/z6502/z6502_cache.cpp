@@ -0,0 +1,219 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Predecoded instruction cache. Each instruction is fetched and decoded
+    once into a decoded_instruction_t holding its specialized handler, raw
+    operand, length and cycle count. Pages holding decoded instructions are
+    flagged in memory_t::code_page, and any store to such a page drops the
+    decoded instructions that depend on it.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <array>
+#include <utility>
+#include "z6502.h"
+#include "z6502_private.h"
+
+/**
+ * @brief Clear the decoded instructions of a page
+ * @param mem Pointer to memory space
+ * @param page Page number
+ * @param first First entry to clear
+ */
+static void _clear_decoded(memory_t* mem, uint8_t page, int first){
+    if(mem->decoded != NULL){
+        memset(&mem->decoded[(page << 8) + first], 0, (256 - first) * sizeof(decoded_instruction_t));
+    }
+}
+
+void _invalidate_code_page(memory_t* mem, uint8_t page){
+    /*Instructions of this page and the ones of the previous page which
+      have operand bytes in this page*/
+    _clear_decoded(mem, page, 0);
+    _clear_decoded(mem, (uint8_t)(page - 1U), 256 - 2);
+    if(mem->jit != NULL){
+        _jit_invalidate_page(mem->jit, page);
+    }
+    _unwatch_code_page(mem, page);
+}
+
+/**
+ * @brief Decode the instruction at an address
+ * @param mem Pointer to memory space
+ * @param addr Instruction address
+ * @param entry Decoded instruction
+ * @returns 0 on success, -1 if the opcode is not handled, 1 if the
+ *          instruction is not in memory and must be interpreted
+ */
+static int _decode(memory_t* mem, uint16_t addr, decoded_instruction_t* entry){
+    uint8_t opcode;
+    uint8_t length;
+    uint16_t last;
+
+    /*Device reads may have side effects, never cache them*/
+    if(mem->read_page[addr >> 8] == NULL){
+        return 1;
+    }
+    opcode = _mem_read(mem, addr);
+    length = 1U + _operand_length(instruction_mode[opcode]);
+    last = (uint16_t)(addr + length - 1U);
+    if(decoded_instruction_set[opcode] == NULL){
+        return -1;
+    }
+    if(mem->read_page[last >> 8] == NULL){
+        return 1;
+    }
+
+    entry->handler = decoded_instruction_set[opcode];
+    entry->operand = 0U;
+    if(length >= 2U){
+        entry->operand = _mem_read(mem, (uint16_t)(addr + 1U));
+    }
+    if(length == 3U){
+        entry->operand |= _mem_read(mem, (uint16_t)(addr + 2U)) << 8;
+    }
+    entry->length = length;
+    entry->cycles = instruction_cycles[opcode];
+    entry->opcode = opcode;
+
+    /*Watch every page the instruction bytes come from*/
+    _watch_code_page(mem, addr >> 8);
+    _watch_code_page(mem, last >> 8);
+    return 0;
+}
+
+void Z6502::invalidate_cache(void) {
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        _clear_decoded(&_memory, page, 0);
+        _unwatch_code_page(&_memory, page);
+    }
+    _jit_flush(_memory.jit);
+}
+
+int Z6502::prewarm(const uint8_t* code_map){
+    memory_t* mem = &_memory;
+    int prepared = 0;
+    int result;
+
+    if(_core == CORE_JIT && _timing == TIMING_FAST){
+        for(unsigned int addr = 0U; addr < Z6502_MAX_MEMORY_SIZE_BYTES; addr++){
+            if((code_map[addr] & Z6502_CODE_BLOCK) == 0U){
+                continue;
+            }
+            result = _jit_prewarm(mem, (uint16_t)addr);
+            if(result < 0){
+                /*No translator, the JIT core runs the cache*/
+                break;
+            }
+            prepared += result;
+        }
+        if(mem->jit != NULL){
+            return prepared;
+        }
+    }
+    else if(_core != CORE_CACHE && _core != CORE_JIT){
+        return 0;
+    }
+
+    if(mem->decoded == NULL){
+        mem->decoded = (decoded_instruction_t*)calloc(Z6502_MAX_MEMORY_SIZE_BYTES, sizeof(decoded_instruction_t));
+        if(mem->decoded == NULL){
+            return -1;
+        }
+    }
+    for(unsigned int addr = 0U; addr < Z6502_MAX_MEMORY_SIZE_BYTES; addr++){
+        if((code_map[addr] & Z6502_CODE_INSTRUCTION) != 0U && mem->decoded[addr].handler == NULL &&
+           _decode(mem, (uint16_t)addr, &mem->decoded[addr]) == 0){
+            prepared++;
+        }
+    }
+    return prepared;
+}
+
+template<typename TIMING>
+uint64_t Z6502::_run_cached(uint64_t cycle_budget) {
+    /*Work on local copies for the whole batch*/
+    cpu_state_t reg;
+    memory_t* mem = &_memory;
+    uint64_t spent = 0U;
+    uint64_t executed = 0U;
+    decoded_instruction_t* entry;
+    uint16_t operand;
+    uint16_t next;
+    uint8_t opcode;
+    int result;
+
+    if(mem->decoded == NULL){
+        mem->decoded = (decoded_instruction_t*)calloc(Z6502_MAX_MEMORY_SIZE_BYTES, sizeof(decoded_instruction_t));
+        if(mem->decoded == NULL){
+            /*Out of memory, run uncached*/
+            return _run_table<TIMING>(cycle_budget);
+        }
+    }
+
+    reg = _reg;
+    while(spent < cycle_budget && _stop_requested == FALSE){
+        entry = &mem->decoded[reg.program_counter];
+        if(entry->handler == NULL){
+            result = _decode(mem, reg.program_counter, entry);
+            if(result < 0){
+                /*Unhandled opcode, stay on it*/
+                _halted = TRUE;
+                break;
+            }
+            if(result > 0){
+                /*Running from a device, interpret*/
+                opcode = _mem_read(mem, reg.program_counter);
+                if(instruction_set[opcode] == NULL){
+                    _halted = TRUE;
+                    break;
+                }
+                reg.program_counter++;
+                executed++;
+                if constexpr (TIMING::accurate){
+                    spent += accurate_instruction_set[opcode](mem, &reg);
+                }
+                else{
+                    instruction_set[opcode](mem, &reg);
+                    spent += instruction_cycles[opcode];
+                }
+                continue;
+            }
+        }
+
+        /*The handler may drop its own entry when storing to its page*/
+        spent += entry->cycles;
+        executed++;
+        if constexpr (TIMING::accurate){
+            opcode = entry->opcode;
+            operand = entry->operand;
+            next = (uint16_t)(reg.program_counter + entry->length);
+            entry->handler(mem, &reg, operand);
+            spent += _penalty_cycles<TIMING>(mem, &reg, opcode, operand, next);
+        }
+        else{
+            entry->handler(mem, &reg, entry->operand);
+        }
+    }
+
+    _reg = reg;
+    _cycles += spent;
+    _instructions += executed;
+    return spent;
+}
+
+template uint64_t Z6502::_run_cached<timing_fast_t>(uint64_t cycle_budget);
+template uint64_t Z6502::_run_cached<timing_accurate_t>(uint64_t cycle_budget);
@@ -0,0 +1,256 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Breakpoints and watchpoints. Nothing is checked while none is set: the
+    state is allocated by the first breakpoint or watchpoint and freed with
+    the last one. While it exists run() goes through _run_instrumented(),
+    which tests the execute bitmap before each instruction. Watched pages
+    lose their direct pointers, so that only their accesses reach the bus
+    slow path where the read and write bitmaps are tested.
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include "z6502.h"
+#include "z6502_private.h"
+
+/**
+ * @brief Get the breakpoint state, allocating it on first use
+ * @param mem Pointer to memory space
+ * @returns State, NULL if out of memory
+ */
+static struct debug_s* _debug_state(memory_t* mem){
+    if(mem->debug == NULL){
+        mem->debug = new (std::nothrow) debug_s();
+        if(mem->debug != NULL){
+            mem->debug->hit.kind = BREAK_NONE;
+            mem->debug->resume_cycles = UINT64_MAX;
+        }
+    }
+    return mem->debug;
+}
+
+/**
+ * @brief Breakpoint condition holds
+ * @param condition Condition
+ * @param reg Registers
+ */
+static uint8_t _condition_holds(const breakpoint_condition_t* condition, const cpu_state_t* reg){
+    uint8_t value;
+
+    switch(condition->reg){
+        case CONDITION_A:
+            value = reg->accumulator;
+            break;
+        case CONDITION_X:
+            value = reg->x;
+            break;
+        case CONDITION_Y:
+            value = reg->y;
+            break;
+        case CONDITION_SP:
+            value = (uint8_t)reg->stack_pointer;
+            break;
+        default:
+            value = _pack_status(reg);
+            break;
+    }
+    value &= condition->mask;
+
+    switch(condition->test){
+        case CONDITION_EQUAL:
+            return (value == condition->value) ? TRUE : FALSE;
+        case CONDITION_NOT_EQUAL:
+            return (value != condition->value) ? TRUE : FALSE;
+        case CONDITION_LESS:
+            return (value < condition->value) ? TRUE : FALSE;
+        default:
+            return (value > condition->value) ? TRUE : FALSE;
+    }
+}
+
+/**
+ * @brief Set or clear an address in a bitmap
+ * @returns TRUE if the bit changed
+ */
+static uint8_t _set_bit(uint8_t* bitmap, uint16_t addr, uint8_t set){
+    uint8_t mask = (uint8_t)(1U << (addr & 7U));
+
+    if(((bitmap[addr >> 3] & mask) != 0U) == (set != FALSE)){
+        return FALSE;
+    }
+    bitmap[addr >> 3] ^= mask;
+    return TRUE;
+}
+
+void _debug_access(memory_t* mem, uint16_t addr, uint8_t value, break_kind_t kind){
+    struct debug_s* debug = mem->debug;
+
+    if(debug->hit.kind != BREAK_NONE || (kind == BREAK_READ && debug->fetching == TRUE)){
+        return;
+    }
+    if(_bitmap_test((kind == BREAK_READ) ? debug->read : debug->write, addr) != 0U){
+        debug->hit.kind = kind;
+        debug->hit.program_counter = debug->program_counter;
+        debug->hit.address = addr;
+        debug->hit.value = value;
+    }
+}
+
+uint8_t Z6502::_break_at(const cpu_state_t* reg, uint64_t cycles){
+    struct debug_s* debug = _memory.debug;
+
+    if(reg->program_counter == debug->resume_address && cycles == debug->resume_cycles){
+        /*Resuming from this breakpoint*/
+        return FALSE;
+    }
+    for(const debug_condition_t& entry : debug->condition){
+        if(entry.address == reg->program_counter && _condition_holds(&entry.condition, reg) == FALSE){
+            return FALSE;
+        }
+    }
+    _break.kind = BREAK_EXECUTE;
+    _break.program_counter = reg->program_counter;
+    _break.address = reg->program_counter;
+    _break.value = 0U;
+    debug->resume_address = reg->program_counter;
+    debug->resume_cycles = cycles;
+    _stop_requested = TRUE;
+    _stop_by_user = TRUE;
+    return TRUE;
+}
+
+void Z6502::_update_debug(unsigned int first_page, unsigned int page_count){
+    struct debug_s* debug = _memory.debug;
+    uint8_t empty = (debug->breakpoint_count == 0U) ? TRUE : FALSE;
+
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT && empty == TRUE; page++){
+        if(debug->read_count[page] != 0U || debug->write_count[page] != 0U){
+            empty = FALSE;
+        }
+    }
+    if(empty == TRUE){
+        delete debug;
+        _memory.debug = NULL;
+    }
+    for(unsigned int page = first_page; page < first_page + page_count; page++){
+        _remap_page(&_memory, page);
+    }
+}
+
+int Z6502::set_breakpoint(uint16_t address, const breakpoint_condition_t* condition){
+    uint8_t armed = (_memory.debug != NULL) ? TRUE : FALSE;
+    struct debug_s* debug = _debug_state(&_memory);
+
+    if(debug == NULL){
+        return -1;
+    }
+    debug->condition.erase(std::remove_if(debug->condition.begin(), debug->condition.end(),
+                                          [address](const debug_condition_t& entry){
+                                              return entry.address == address;
+                                          }),
+                           debug->condition.end());
+    if(condition != NULL){
+        debug->condition.push_back({address, *condition});
+    }
+    if(_set_bit(debug->execute, address, TRUE) == TRUE){
+        debug->breakpoint_count++;
+    }
+    if(armed == FALSE){
+        /*Leave the core for the instrumented loop*/
+        _stop_requested = TRUE;
+    }
+    return 0;
+}
+
+int Z6502::clear_breakpoint(uint16_t address){
+    struct debug_s* debug = _memory.debug;
+
+    if(debug == NULL || _set_bit(debug->execute, address, FALSE) == FALSE){
+        return -1;
+    }
+    debug->breakpoint_count--;
+    debug->condition.erase(std::remove_if(debug->condition.begin(), debug->condition.end(),
+                                          [address](const debug_condition_t& entry){
+                                              return entry.address == address;
+                                          }),
+                           debug->condition.end());
+    _update_debug(0U, 0U);
+    return 0;
+}
+
+int Z6502::set_watchpoint(uint16_t address, unsigned int length, uint8_t access){
+    uint8_t armed = (_memory.debug != NULL) ? TRUE : FALSE;
+    struct debug_s* debug;
+    uint16_t addr;
+
+    if(length == 0U || address + length > Z6502_MAX_MEMORY_SIZE_BYTES ||
+       access == 0U || (access & ~(Z6502_WATCH_READ | Z6502_WATCH_WRITE)) != 0U){
+        return -1;
+    }
+    debug = _debug_state(&_memory);
+    if(debug == NULL){
+        return -1;
+    }
+    for(unsigned int i = 0U; i < length; i++){
+        addr = (uint16_t)(address + i);
+        if((access & Z6502_WATCH_READ) != 0U && _set_bit(debug->read, addr, TRUE) == TRUE){
+            debug->read_count[addr >> 8]++;
+        }
+        if((access & Z6502_WATCH_WRITE) != 0U && _set_bit(debug->write, addr, TRUE) == TRUE){
+            debug->write_count[addr >> 8]++;
+        }
+    }
+    _update_debug(address >> 8, ((address + length - 1U) >> 8) - (address >> 8) + 1U);
+    if(armed == FALSE){
+        _stop_requested = TRUE;
+    }
+    return 0;
+}
+
+int Z6502::clear_watchpoint(uint16_t address, unsigned int length, uint8_t access){
+    struct debug_s* debug = _memory.debug;
+    uint16_t addr;
+
+    if(length == 0U || address + length > Z6502_MAX_MEMORY_SIZE_BYTES ||
+       access == 0U || (access & ~(Z6502_WATCH_READ | Z6502_WATCH_WRITE)) != 0U){
+        return -1;
+    }
+    if(debug == NULL){
+        return 0;
+    }
+    for(unsigned int i = 0U; i < length; i++){
+        addr = (uint16_t)(address + i);
+        if((access & Z6502_WATCH_READ) != 0U && _set_bit(debug->read, addr, FALSE) == TRUE){
+            debug->read_count[addr >> 8]--;
+        }
+        if((access & Z6502_WATCH_WRITE) != 0U && _set_bit(debug->write, addr, FALSE) == TRUE){
+            debug->write_count[addr >> 8]--;
+        }
+    }
+    _update_debug(address >> 8, ((address + length - 1U) >> 8) - (address >> 8) + 1U);
+    return 0;
+}
+
+void Z6502::clear_debug(void){
+    if(_memory.debug != NULL){
+        delete _memory.debug;
+        _memory.debug = NULL;
+        for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+            _remap_page(&_memory, page);
+        }
+    }
+}
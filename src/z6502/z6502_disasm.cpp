@@ -0,0 +1,317 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Disassembler and code map. Instructions are decoded with
+    instruction_mode[] and formatted by hand, without printf, so that whole
+    images disassemble at memory speed. The code map is built by recursive
+    traversal with an explicit work list: each entry is decoded up to the
+    end of its flow, pushing branch, jump and call targets on the way.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "z6502.h"
+#include "z6502_disasm.h"
+#include "z6502_private.h"
+
+static const char hex_digit[] = "0123456789ABCDEF";
+
+/**
+ * @brief Append a byte as 2 hex digits
+ */
+static inline char* _put_hex8(char* text, uint8_t value){
+    text[0] = hex_digit[value >> 4];
+    text[1] = hex_digit[value & 0x0FU];
+    return text + 2;
+}
+
+/**
+ * @brief Append a word as 4 hex digits
+ */
+static inline char* _put_hex16(char* text, uint16_t value){
+    return _put_hex8(_put_hex8(text, (uint8_t)(value >> 8)), (uint8_t)value);
+}
+
+static inline char* _put_text(char* text, const char* source){
+    while(*source != '\0'){
+        *text++ = *source++;
+    }
+    return text;
+}
+
+static inline uint16_t _read16(const uint8_t* memory, uint16_t address){
+    return memory[address] | (memory[(uint16_t)(address + 1U)] << 8);
+}
+
+unsigned int disasm_instruction(const uint8_t* memory, uint16_t address, char* text){
+    uint8_t opcode = memory[address];
+    addressing_mode_t mode = instruction_mode[opcode];
+    uint8_t low = memory[(uint16_t)(address + 1U)];
+    uint16_t word = _read16(memory, (uint16_t)(address + 1U));
+
+    if(instruction_id[opcode] == OP___){
+        text = _put_hex8(_put_text(text, ".BYTE $"), opcode);
+        *text = '\0';
+        return 1U;
+    }
+    text = _put_text(text, instruction_mnemonic[instruction_id[opcode]]);
+    switch(mode){
+        case ACC: text = _put_text(text, " A"); break;
+        case IMM: text = _put_hex8(_put_text(text, " #$"), low); break;
+        case ZP:  text = _put_hex8(_put_text(text, " $"), low); break;
+        case ZPX: text = _put_text(_put_hex8(_put_text(text, " $"), low), ",X"); break;
+        case ZPY: text = _put_text(_put_hex8(_put_text(text, " $"), low), ",Y"); break;
+        case REL: text = _put_hex16(_put_text(text, " $"), (uint16_t)(address + 2U + (int8_t)low)); break;
+        case ABS: text = _put_hex16(_put_text(text, " $"), word); break;
+        case ABX: text = _put_text(_put_hex16(_put_text(text, " $"), word), ",X"); break;
+        case ABY: text = _put_text(_put_hex16(_put_text(text, " $"), word), ",Y"); break;
+        case IND: text = _put_text(_put_hex16(_put_text(text, " ($"), word), ")"); break;
+        case INX: text = _put_text(_put_hex8(_put_text(text, " ($"), low), ",X)"); break;
+        case INY: text = _put_text(_put_hex8(_put_text(text, " ($"), low), "),Y"); break;
+        default: break;
+    }
+    *text = '\0';
+    return 1U + _operand_length(instruction_mode[opcode]);
+}
+
+code_map_t* code_map_create(void){
+    return (code_map_t*)calloc(1, sizeof(code_map_t));
+}
+
+void code_map_free(code_map_t* map){
+    free(map);
+}
+
+/**
+ * @brief Mark a branch, jump or call target and queue it
+ */
+static inline void _add_target(code_map_t* map, std::vector<uint16_t>* work, uint16_t target){
+    map->flags[target] |= Z6502_CODE_TARGET | Z6502_CODE_BLOCK;
+    if((map->flags[target] & Z6502_CODE_INSTRUCTION) == 0U){
+        work->push_back(target);
+    }
+}
+
+uint32_t code_map_trace(code_map_t* map, const uint8_t* memory, uint16_t entry){
+    std::vector<uint16_t> work;
+    uint32_t found = 0U;
+    uint16_t address;
+    uint16_t operand;
+    unsigned int length;
+    uint8_t opcode;
+    uint8_t overlap;
+    uint8_t* flags = map->flags;
+
+    flags[entry] |= Z6502_CODE_ENTRY | Z6502_CODE_BLOCK;
+    work.push_back(entry);
+    while(work.empty() == false){
+        address = work.back();
+        work.pop_back();
+
+        /*Decode up to the end of the flow or known code*/
+        while((flags[address] & Z6502_CODE_INSTRUCTION) == 0U){
+            opcode = memory[address];
+            length = 1U + _operand_length(instruction_mode[opcode]);
+            overlap = FALSE;
+            for(unsigned int i = 0U; i < length; i++){
+                if((flags[(uint16_t)(address + i)] & (i == 0U ? Z6502_CODE_OPERAND : Z6502_CODE_INSTRUCTION | Z6502_CODE_OPERAND)) != 0U){
+                    overlap = TRUE;
+                }
+            }
+            if(instruction_id[opcode] == OP___ || overlap == TRUE){
+                flags[address] |= Z6502_CODE_INVALID;
+                break;
+            }
+            flags[address] |= Z6502_CODE_INSTRUCTION;
+            for(unsigned int i = 1U; i < length; i++){
+                flags[(uint16_t)(address + i)] |= Z6502_CODE_OPERAND;
+            }
+            found++;
+            operand = (length == 3U) ? _read16(memory, (uint16_t)(address + 1U)) : memory[(uint16_t)(address + 1U)];
+            address = (uint16_t)(address + length);
+
+            switch(instruction_id[opcode]){
+                case OP_BCC: case OP_BCS: case OP_BEQ: case OP_BNE:
+                case OP_BMI: case OP_BPL: case OP_BVC: case OP_BVS:
+                    _add_target(map, &work, (uint16_t)(address + (int8_t)operand));
+                    flags[address] |= Z6502_CODE_BLOCK;
+                    continue;
+                case OP_JSR:
+                    /*Assume the call returns*/
+                    _add_target(map, &work, operand);
+                    flags[address] |= Z6502_CODE_BLOCK;
+                    continue;
+                case OP_JMP:
+                    if(instruction_mode[opcode] == ABS){
+                        _add_target(map, &work, operand);
+                    }
+                    else{
+                        /*Target only known at run time*/
+                        flags[operand] |= Z6502_CODE_DATA;
+                        flags[(uint16_t)(operand + 1U)] |= Z6502_CODE_DATA;
+                    }
+                    break;
+                case OP_RTS: case OP_RTI: case OP_BRK:
+                    break;
+                default:
+                    switch(instruction_mode[opcode]){
+                        case ZP: case ZPX: case ZPY: case ABS: case ABX: case ABY:
+                            flags[operand] |= Z6502_CODE_DATA;
+                            break;
+                        case INX: case INY:
+                            /*Zero page pointer*/
+                            flags[operand] |= Z6502_CODE_DATA;
+                            flags[(uint8_t)(operand + 1U)] |= Z6502_CODE_DATA;
+                            break;
+                        default:
+                            break;
+                    }
+                    continue;
+            }
+            break;
+        }
+    }
+    return found;
+}
+
+uint32_t code_map_trace_vectors(code_map_t* map, const uint8_t* memory){
+    static const uint16_t vector[] = {Z6502_NMI_VECTOR_ADDRESS, Z6502_RESET_VECTOR_ADDRESS, Z6502_IRQ_VECTOR_ADDRESS};
+    uint32_t found = 0U;
+
+    for(unsigned int i = 0U; i < sizeof(vector) / sizeof(vector[0]); i++){
+        map->flags[vector[i]] |= Z6502_CODE_DATA;
+        map->flags[vector[i] + 1U] |= Z6502_CODE_DATA;
+    }
+    for(unsigned int i = 0U; i < sizeof(vector) / sizeof(vector[0]); i++){
+        found += code_map_trace(map, memory, _read16(memory, vector[i]));
+    }
+    return found;
+}
+
+void code_map_get_stats(const code_map_t* map, code_map_stats_t* stats){
+    uint8_t flags;
+
+    memset(stats, 0, sizeof(*stats));
+    for(unsigned int address = 0U; address < Z6502_MAX_MEMORY_SIZE_BYTES; address++){
+        flags = map->flags[address];
+        stats->instructions += (flags & Z6502_CODE_INSTRUCTION) != 0U;
+        stats->code_bytes += (flags & (Z6502_CODE_INSTRUCTION | Z6502_CODE_OPERAND)) != 0U;
+        stats->data_bytes += (flags & (Z6502_CODE_INSTRUCTION | Z6502_CODE_OPERAND | Z6502_CODE_DATA)) == Z6502_CODE_DATA;
+        stats->blocks += (flags & (Z6502_CODE_INSTRUCTION | Z6502_CODE_BLOCK)) == (Z6502_CODE_INSTRUCTION | Z6502_CODE_BLOCK);
+        stats->targets += (flags & Z6502_CODE_TARGET) != 0U;
+        stats->invalid += (flags & Z6502_CODE_INVALID) != 0U;
+    }
+}
+
+void code_map_print(const code_map_t* map, const uint8_t* memory, uint16_t first, uint16_t last, FILE* out){
+    char line[80];
+    char* text;
+    unsigned int address = first;
+    unsigned int length;
+    unsigned int count;
+    uint8_t flags;
+
+    while(address <= last){
+        flags = map->flags[address];
+        text = line;
+        if((flags & Z6502_CODE_INSTRUCTION) != 0U){
+            if((flags & Z6502_CODE_BLOCK) != 0U && address != first){
+                *text++ = '\n';
+            }
+            if((flags & (Z6502_CODE_TARGET | Z6502_CODE_ENTRY)) != 0U){
+                text = _put_text(_put_hex16(_put_text(text, "L"), (uint16_t)address), ":\n");
+            }
+            text = _put_text(_put_hex16(text, (uint16_t)address), "  ");
+            length = 1U + _operand_length(instruction_mode[memory[address]]);
+            for(unsigned int i = 0U; i < 3U; i++){
+                if(i < length){
+                    text = _put_hex8(text, memory[(uint16_t)(address + i)]);
+                    *text++ = ' ';
+                }
+                else{
+                    text = _put_text(text, "   ");
+                }
+            }
+            text = _put_text(text, "  ");
+            disasm_instruction(memory, (uint16_t)address, text);
+            text += strlen(text);
+        }
+        else if(flags == 0U){
+            /*Unknown bytes, one line for the run*/
+            for(length = 1U; address + length <= last && map->flags[address + length] == 0U; length++){
+            }
+            text = _put_text(_put_hex16(text, (uint16_t)address), "  ; ");
+            text += sprintf(text, "%u unknown byte%s", length, (length > 1U) ? "s" : "");
+        }
+        else{
+            /*Up to 8 data bytes, not past code, a label, a change of kind or the end*/
+            text = _put_text(_put_hex16(text, (uint16_t)address), "  .BYTE ");
+            length = 0U;
+            for(count = 0U; count < 8U && address + count <= last; count++){
+                if(count > 0U && ((map->flags[address + count] & (Z6502_CODE_INSTRUCTION | Z6502_CODE_TARGET | Z6502_CODE_INVALID)) != 0U ||
+                                  (map->flags[address + count] & Z6502_CODE_DATA) != (flags & Z6502_CODE_DATA) ||
+                                  (flags & Z6502_CODE_INVALID) != 0U)){
+                    break;
+                }
+                if(count > 0U){
+                    *text++ = ',';
+                }
+                text = _put_hex8(_put_text(text, "$"), memory[address + count]);
+                length++;
+            }
+            if((flags & Z6502_CODE_INVALID) != 0U){
+                text = _put_text(text, "  ; code flow, not decodable");
+            }
+        }
+        *text++ = '\n';
+        fwrite(line, 1, text - line, out);
+        address += length;
+    }
+}
+
+int code_map_export(const code_map_t* map, const char* filename){
+    uint8_t header[Z6502_CODE_MAP_HEADER_BYTES] = {0};
+    FILE* file = fopen(filename, "wb");
+    int result;
+
+    if(file == NULL){
+        return -1;
+    }
+    memcpy(header, Z6502_CODE_MAP_MAGIC, sizeof(Z6502_CODE_MAP_MAGIC) - 1U);
+    header[sizeof(Z6502_CODE_MAP_MAGIC) - 1U] = Z6502_CODE_MAP_VERSION;
+    result = (fwrite(header, sizeof(header), 1, file) == 1 && fwrite(map->flags, sizeof(map->flags), 1, file) == 1) ? 0 : -1;
+    if(fclose(file) != 0){
+        result = -1;
+    }
+    return result;
+}
+
+int code_map_import(code_map_t* map, const char* filename){
+    uint8_t header[Z6502_CODE_MAP_HEADER_BYTES];
+    FILE* file = fopen(filename, "rb");
+    int result;
+
+    if(file == NULL){
+        return -1;
+    }
+    result = (fread(header, sizeof(header), 1, file) == 1 &&
+              memcmp(header, Z6502_CODE_MAP_MAGIC, sizeof(Z6502_CODE_MAP_MAGIC) - 1U) == 0 &&
+              header[sizeof(Z6502_CODE_MAP_MAGIC) - 1U] == Z6502_CODE_MAP_VERSION &&
+              fread(map->flags, sizeof(map->flags), 1, file) == 1) ? 0 : -1;
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,225 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Event scheduler and interrupt inputs. Pending events sit in a binary
+    min-heap ordered by deadline, then by scheduling order. While something
+    is pending run() executes the core in slices that end at the earliest
+    deadline, so nothing is polled per instruction; events and interrupt
+    inputs are serviced between two slices. A device raising an interrupt or
+    scheduling an earlier event in the middle of a slice ends it through the
+    stop flag: the interpreters check it after each instruction, translated
+    code after each instruction that reaches the bus through an interpreter
+    handler, which is the only way it reaches a device.
+*/
+
+#include "z6502.h"
+#include "z6502_private.h"
+
+/**
+ * @brief Event a is due before event b
+ */
+static inline uint8_t _event_before(const event_t* a, const event_t* b){
+    if(a->deadline != b->deadline){
+        return (a->deadline < b->deadline) ? TRUE : FALSE;
+    }
+    /*Ids are 31 bit serial numbers*/
+    return ((int32_t)((a->id - b->id) << 1) < 0) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Move a heap entry up to its place
+ * @param heap Events
+ * @param index Entry
+ */
+static void _sift_up(event_t* heap, unsigned int index){
+    event_t event = heap[index];
+    unsigned int parent;
+
+    while(index > 0U){
+        parent = (index - 1U) / 2U;
+        if(_event_before(&event, &heap[parent]) == FALSE){
+            break;
+        }
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = event;
+}
+
+/**
+ * @brief Move a heap entry down to its place
+ * @param heap Events
+ * @param count Number of events
+ * @param index Entry
+ */
+static void _sift_down(event_t* heap, unsigned int count, unsigned int index){
+    event_t event = heap[index];
+    unsigned int child;
+
+    while((child = 2U * index + 1U) < count){
+        if(child + 1U < count && _event_before(&heap[child + 1U], &heap[child]) == TRUE){
+            child++;
+        }
+        if(_event_before(&heap[child], &event) == FALSE){
+            break;
+        }
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = event;
+}
+
+int Z6502::schedule_event(uint64_t deadline, event_handler_t handler, void* context){
+    event_t* event;
+    uint32_t id;
+
+    if(_event_count == Z6502_MAX_EVENTS || handler == NULL){
+        return -1;
+    }
+    id = _event_serial;
+    _event_serial = (_event_serial + 1U) & 0x7FFFFFFFU;
+    event = &_event[_event_count];
+    event->deadline = deadline;
+    event->id = id;
+    event->handler = handler;
+    event->context = context;
+    _sift_up(_event, _event_count++);
+
+    if(_event[0].id == id){
+        /*New earliest deadline, end the current slice*/
+        _stop_requested = TRUE;
+    }
+    return (int)id;
+}
+
+int Z6502::cancel_event(int id){
+    for(unsigned int index = 0U; index < _event_count; index++){
+        if(_event[index].id == (uint32_t)id){
+            _event_count--;
+            if(index < _event_count){
+                _event[index] = _event[_event_count];
+                _sift_down(_event, _event_count, index);
+                _sift_up(_event, index);
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int Z6502::assert_irq(unsigned int line){
+    if(line >= Z6502_IRQ_LINES){
+        return -1;
+    }
+    _irq_lines |= 1U << line;
+    _stop_requested = TRUE;
+    return 0;
+}
+
+int Z6502::release_irq(unsigned int line){
+    if(line >= Z6502_IRQ_LINES){
+        return -1;
+    }
+    _irq_lines &= ~(1U << line);
+    return 0;
+}
+
+void Z6502::trigger_nmi(void){
+    _nmi_pending = TRUE;
+    _stop_requested = TRUE;
+}
+
+void Z6502::_take_interrupt(uint16_t vector){
+    if(_memory.replay != NULL && _memory.replaying == FALSE){
+        _replay_log_interrupt(_memory.replay, _cycles, vector);
+    }
+    if(_memory.debug != NULL){
+        _memory.debug->program_counter = _reg.program_counter;
+    }
+    _interrupt(&_memory, &_reg, vector);
+    _cycles += Z6502_INTERRUPT_CYCLES;
+    if(_memory.debug != NULL && _memory.debug->hit.kind != BREAK_NONE){
+        /*Watchpoint hit while pushing to the stack or reading the vector*/
+        _break = _memory.debug->hit;
+        _memory.debug->hit.kind = BREAK_NONE;
+        _stop_requested = TRUE;
+        _stop_by_user = TRUE;
+    }
+}
+
+uint64_t Z6502::_run_scheduled(uint64_t cycle_budget) {
+    uint64_t spent = 0U;
+    uint64_t slice;
+    uint64_t skipped;
+    event_t event;
+
+    while(spent < cycle_budget && _halted == FALSE && _stop_by_user == FALSE){
+        /*Events due, earliest first. Handlers may schedule more*/
+        while(_event_count > 0U && _event[0].deadline <= _cycles){
+            event = _event[0];
+            _event[0] = _event[--_event_count];
+            _sift_down(_event, _event_count, 0U);
+            event.handler(this, event.context, event.deadline);
+        }
+        if(_stop_by_user == TRUE){
+            break;
+        }
+
+        /*Interrupts are taken between two instructions, NMI first*/
+        if(_nmi_pending == TRUE){
+            _nmi_pending = FALSE;
+            _take_interrupt(Z6502_NMI_VECTOR_ADDRESS);
+            spent += Z6502_INTERRUPT_CYCLES;
+            continue;
+        }
+        if(_irq_lines != 0U && _reg.processor_status.irq_disable == 0U){
+            _take_interrupt(Z6502_IRQ_VECTOR_ADDRESS);
+            spent += Z6502_INTERRUPT_CYCLES;
+            continue;
+        }
+
+        /*Run up to the next deadline*/
+        slice = cycle_budget - spent;
+        if(_event_count > 0U && _event[0].deadline - _cycles < slice){
+            slice = _event[0].deadline - _cycles;
+        }
+        if(_irq_lines != 0U){
+            /*IRQ masked, look at the I flag again after every instruction*/
+            slice = 1U;
+        }
+        else if(_idle_skip == TRUE && _is_instrumented() == FALSE){
+            skipped = _skip_idle(slice);
+            if(skipped > 0U){
+                _cycles += skipped;
+                _idle_cycles += skipped;
+                spent += skipped;
+                _idle_interval = Z6502_IDLE_CHECK_MIN_CYCLES;
+                continue;
+            }
+            /*Busy, look again later and less often*/
+            if(slice > _idle_interval){
+                slice = _idle_interval;
+            }
+            if(_idle_interval < Z6502_IDLE_CHECK_MAX_CYCLES){
+                _idle_interval *= 2U;
+            }
+        }
+        if(_begin_slice() == TRUE){
+            break;
+        }
+        spent += _dispatch(slice);
+    }
+    return spent;
+}
@@ -0,0 +1,268 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "z6502.h"
+#include "z6502_private.h"
+#include "z6502_fuzz.h"
+
+/*Byte values mutations like to try*/
+static const uint8_t interesting_values[] = {0x00U, 0x01U, 0x0AU, 0x0DU, 0x20U, 0x7FU, 0x80U, 0xFFU};
+
+Z6502Fuzzer::Z6502Fuzzer(){
+    _cpu = NULL;
+    _start = NULL;
+    _input_address = 0U;
+    _input_size = 0U;
+    _cycle_limit = 0U;
+    _coverage = NULL;
+    _finding_handler = NULL;
+    _finding_context = NULL;
+    memset(&_stats, 0, sizeof(_stats));
+    _rng = 1U;
+}
+
+uint64_t Z6502Fuzzer::_random(void){
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 7;
+    _rng ^= _rng << 17;
+    return _rng;
+}
+
+int Z6502Fuzzer::attach(Z6502* cpu, uint16_t input_address, uint16_t input_size, uint64_t cycle_limit){
+    const page_map_t* map;
+
+    detach();
+    if(cycle_limit == 0U || input_address + input_size > Z6502_MAX_MEMORY_SIZE_BYTES){
+        return -1;
+    }
+    for(unsigned int page = input_address >> 8; input_size > 0U && page <= (input_address + input_size - 1U) >> 8; page++){
+        map = &cpu->_memory.page_map[page];
+        if(map->base == NULL || map->read_only != FALSE){
+            return -1;
+        }
+    }
+
+    _coverage = (uint8_t*)calloc(Z6502_FUZZ_MAP_ENTRIES / 8U, 1U);
+    _start = cpu->snapshot();
+    if(_coverage == NULL || _start == NULL){
+        free(_coverage);
+        _coverage = NULL;
+        snapshot_free(_start);
+        _start = NULL;
+        return -1;
+    }
+    _cpu = cpu;
+    _input_address = input_address;
+    _input_size = input_size;
+    _cycle_limit = cycle_limit;
+    _corpus.clear();
+    memset(&_stats, 0, sizeof(_stats));
+    cpu->_coverage = _coverage;
+    return 0;
+}
+
+void Z6502Fuzzer::detach(void){
+    if(_cpu != NULL){
+        for(uint16_t address : _exit){
+            _cpu->clear_breakpoint(address);
+        }
+        _cpu->_coverage = NULL;
+        _cpu = NULL;
+    }
+    _exit.clear();
+    snapshot_free(_start);
+    _start = NULL;
+    free(_coverage);
+    _coverage = NULL;
+}
+
+int Z6502Fuzzer::add_exit(uint16_t address){
+    if(_cpu == NULL || _cpu->set_breakpoint(address) < 0){
+        return -1;
+    }
+    if(std::find(_exit.begin(), _exit.end(), address) == _exit.end()){
+        _exit.push_back(address);
+    }
+    return 0;
+}
+
+int Z6502Fuzzer::add_seed(const uint8_t* input, size_t length){
+    if(_cpu == NULL){
+        return -1;
+    }
+    length = std::min(length, (size_t)_input_size);
+    _corpus.emplace_back(input, input + length);
+    if(_corpus.back().empty()){
+        _corpus.back().push_back(0U);
+    }
+    _stats.corpus = _corpus.size();
+    return 0;
+}
+
+void Z6502Fuzzer::_load_input(const uint8_t* input, size_t length){
+    memory_t* mem = &_cpu->_memory;
+    unsigned int addr = _input_address;
+    unsigned int end = _input_address + _input_size;
+    unsigned int count;
+    unsigned int copied;
+    uint8_t page;
+
+    while(addr < end){
+        page = addr >> 8;
+        count = std::min(end - addr, Z6502_PAGE_SIZE_BYTES - (addr & 0xFFU));
+        if(mem->shared[page] != NULL && _unshare_page(mem, page) < 0){
+            return;
+        }
+        if(mem->code_page[page] != FALSE){
+            _invalidate_code_page(mem, page);
+        }
+        copied = std::min(count, (unsigned int)length);
+        memcpy(&mem->page_map[page].base[addr & 0xFFU], input, copied);
+        memset(&mem->page_map[page].base[(addr & 0xFFU) + copied], 0, count - copied);
+        input += copied;
+        length -= copied;
+        addr += count;
+    }
+}
+
+fuzz_result_t Z6502Fuzzer::run_one(const uint8_t* input, size_t length, uint32_t* new_edges){
+    memory_t* mem = &_cpu->_memory;
+    fuzz_result_t result = FUZZ_TIMEOUT;
+    uint64_t spent = 0U;
+    break_info_t hit;
+
+    /*Only pages written by the previous iteration are copied back*/
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        if(mem->page_map[page].base != NULL && mem->page_map[page].read_only == FALSE && mem->shared[page] == NULL){
+            _stats.dirty_pages++;
+        }
+    }
+    _cpu->restore(_start);
+
+    length = std::min(length, (size_t)_input_size);
+    _load_input(input, length);
+    _cpu->_reg.accumulator = length & 0xFFU;
+    _cpu->_reg.x = (uint8_t)(length >> 8);
+    _cpu->_coverage_previous = 0U;
+    _cpu->_coverage_new = 0U;
+
+    while(spent < _cycle_limit){
+        spent += _cpu->run(_cycle_limit - spent);
+        if(_cpu->is_halted() == TRUE){
+            result = FUZZ_HALT;
+            break;
+        }
+        if(_cpu->get_break(&hit) != BREAK_NONE){
+            result = (hit.kind == BREAK_EXECUTE && std::find(_exit.begin(), _exit.end(), hit.address) != _exit.end())
+                     ? FUZZ_EXIT : FUZZ_BREAK;
+            break;
+        }
+    }
+
+    _stats.iterations++;
+    _stats.result[result]++;
+    _stats.cycles += spent;
+    _stats.edges += _cpu->_coverage_new;
+    if(new_edges != NULL){
+        *new_edges = _cpu->_coverage_new;
+    }
+    return result;
+}
+
+void Z6502Fuzzer::_mutate(std::vector<uint8_t>* input){
+    unsigned int count = 1U + _random() % 4U;
+    const std::vector<uint8_t>* other;
+    size_t position;
+
+    for(unsigned int i = 0U; i < count; i++){
+        position = _random() % input->size();
+        switch(_random() % 7U){
+            case 0:
+                (*input)[position] ^= (uint8_t)(1U << (_random() % 8U));
+                break;
+            case 1:
+                (*input)[position] = (uint8_t)_random();
+                break;
+            case 2:
+                (*input)[position] = interesting_values[_random() % sizeof(interesting_values)];
+                break;
+            case 3:
+                (*input)[position] += (uint8_t)(_random() % 33U) - 16U;
+                break;
+            case 4:
+                if(input->size() < _input_size){
+                    input->insert(input->begin() + position, (uint8_t)_random());
+                }
+                break;
+            case 5:
+                if(input->size() > 1U){
+                    input->erase(input->begin() + position);
+                }
+                break;
+            default:
+                /*Splice the tail of another input*/
+                other = &_corpus[_random() % _corpus.size()];
+                if(position < other->size()){
+                    input->resize(position);
+                    input->insert(input->end(), other->begin() + position, other->end());
+                }
+                break;
+        }
+    }
+}
+
+uint64_t Z6502Fuzzer::fuzz(uint64_t iterations){
+    std::vector<uint8_t> input;
+    fuzz_result_t result;
+    uint32_t new_edges;
+
+    if(_cpu == NULL || _input_size == 0U){
+        return 0U;
+    }
+    if(_corpus.empty()){
+        _corpus.push_back(std::vector<uint8_t>(1U, 0U));
+        _stats.corpus = 1U;
+    }
+
+    for(uint64_t i = 0U; i < iterations; i++){
+        input = _corpus[_random() % _corpus.size()];
+        _mutate(&input);
+        result = run_one(input.data(), input.size(), &new_edges);
+        if(new_edges > 0U && _corpus.size() < Z6502_FUZZ_MAX_CORPUS){
+            _corpus.push_back(input);
+            _stats.corpus = _corpus.size();
+        }
+        if((result == FUZZ_HALT || result == FUZZ_BREAK) && _finding_handler != NULL){
+            _finding_handler(_finding_context, result, input.data(), input.size());
+        }
+    }
+    return iterations;
+}
+
+void Z6502Fuzzer::print_summary(FILE* out){
+    fprintf(out, "%llu iterations, %llu cycles, %.2f dirty pages per iteration\n",
+            (unsigned long long)_stats.iterations, (unsigned long long)_stats.cycles,
+            (_stats.iterations > 0U) ? (double)_stats.dirty_pages / _stats.iterations : 0.0);
+    fprintf(out, "exit %llu, timeout %llu, halt %llu, break %llu\n",
+            (unsigned long long)_stats.result[FUZZ_EXIT], (unsigned long long)_stats.result[FUZZ_TIMEOUT],
+            (unsigned long long)_stats.result[FUZZ_HALT], (unsigned long long)_stats.result[FUZZ_BREAK]);
+    fprintf(out, "%u edges covered, %u inputs in corpus\n", _stats.edges, _stats.corpus);
+}
+
+Z6502Fuzzer::~Z6502Fuzzer(){
+    detach();
+}
@@ -0,0 +1,184 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Idle loop fast-forward. From the program counter, one iteration of the
+    loop is interpreted on a copy of the registers, then a second one. The
+    loop is idle when its instructions only read memory pages mapped
+    directly, store nothing, leave the stack alone, and the second
+    iteration ends on the registers the first one ended on: memory cannot
+    change until an event or an interrupt, so every following iteration is
+    the same. The first iteration is committed and whole iterations are
+    counted without running them.
+*/
+
+#include "z6502.h"
+#include "z6502_private.h"
+
+/**
+ * @brief Instruction that can be part of an idle loop: no store, no stack
+ *        access, no interrupt mask change, no indirect jump
+ * @param opcode Opcode
+ */
+static uint8_t _idle_instruction(uint8_t opcode){
+    switch(instruction_id[opcode]){
+        case OP_ADC: case OP_AND: case OP_BIT: case OP_CMP: case OP_CPX: case OP_CPY:
+        case OP_EOR: case OP_LDA: case OP_LDX: case OP_LDY: case OP_ORA: case OP_SBC:
+        case OP_BCC: case OP_BCS: case OP_BEQ: case OP_BMI: case OP_BNE: case OP_BPL:
+        case OP_BVC: case OP_BVS: case OP_CLC: case OP_CLD: case OP_CLV: case OP_SEC:
+        case OP_SED: case OP_NOP: case OP_DEX: case OP_DEY: case OP_INX: case OP_INY:
+        case OP_TAX: case OP_TAY: case OP_TSX: case OP_TXA: case OP_TXS: case OP_TYA:
+            return TRUE;
+        case OP_ASL: case OP_LSR: case OP_ROL: case OP_ROR:
+            return (instruction_mode[opcode] == ACC) ? TRUE : FALSE;
+        case OP_JMP:
+            return (instruction_mode[opcode] == ABS) ? TRUE : FALSE;
+        default:
+            return FALSE;
+    }
+}
+
+/**
+ * @brief A byte can be read without going to a device
+ */
+static inline uint8_t _direct(const memory_t* mem, uint16_t addr){
+    return (mem->read_page[addr >> 8] != NULL) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Every byte the instruction at program counter reads, itself
+ *        included, is in directly mapped memory
+ * @param mem Pointer to memory space
+ * @param reg Register set the instruction starts from
+ * @param opcode Opcode
+ */
+static uint8_t _direct_operands(const memory_t* mem, const cpu_state_t* reg, uint8_t opcode){
+    addressing_mode_t mode = instruction_mode[opcode];
+    uint16_t pc = reg->program_counter;
+    uint16_t operand;
+    uint16_t pointer;
+
+    if(_operand_length(mode) == 0U){
+        return TRUE;
+    }
+    if(_direct(mem, (uint16_t)(pc + _operand_length(mode))) == FALSE){
+        return FALSE;
+    }
+    operand = mem->read_page[(uint16_t)(pc + 1U) >> 8][(uint16_t)(pc + 1U) & 0xFFU];
+    if(_operand_length(mode) == 2U){
+        operand |= mem->read_page[(uint16_t)(pc + 2U) >> 8][(uint16_t)(pc + 2U) & 0xFFU] << 8;
+    }
+    switch(mode){
+        case ZP: case ZPX: case ZPY:
+            return _direct(mem, 0U);
+        case ABS:
+            /*JMP target, or data read*/
+            return (instruction_id[opcode] == OP_JMP) ? TRUE : _direct(mem, operand);
+        case ABX:
+            return _direct(mem, (uint16_t)(operand + reg->x));
+        case ABY:
+            return _direct(mem, (uint16_t)(operand + reg->y));
+        case INX:
+        case INY:
+            if(_direct(mem, 0U) == FALSE){
+                return FALSE;
+            }
+            pointer = (mode == INX) ? (uint8_t)(operand + reg->x) : (uint8_t)operand;
+            pointer = mem->read_page[0][pointer] | (mem->read_page[0][(uint8_t)(pointer + 1U)] << 8);
+            return _direct(mem, (mode == INY) ? (uint16_t)(pointer + reg->y) : pointer);
+        default:
+            return TRUE;
+    }
+}
+
+/**
+ * @brief Interpret one iteration of the loop at program counter
+ * @param mem Pointer to memory space
+ * @param reg Register set, moved to the end of the iteration
+ * @param timing Cycle counting
+ * @param cycles Cycles of the iteration
+ * @param instructions Instructions of the iteration
+ * @returns 0 if the program counter came back, -1 if this is not an idle loop
+ */
+static int _idle_iteration(memory_t* mem, cpu_state_t* reg, timing_t timing, uint64_t* cycles, uint64_t* instructions){
+    uint16_t start = reg->program_counter;
+    uint8_t opcode;
+
+    *cycles = 0U;
+    for(unsigned int count = 0U; count < Z6502_IDLE_MAX_INSTRUCTIONS; count++){
+        if(_direct(mem, reg->program_counter) == FALSE){
+            return -1;
+        }
+        opcode = mem->read_page[reg->program_counter >> 8][reg->program_counter & 0xFFU];
+        if(_idle_instruction(opcode) == FALSE || _direct_operands(mem, reg, opcode) == FALSE){
+            return -1;
+        }
+        reg->program_counter++;
+        if(timing == TIMING_ACCURATE){
+            *cycles += accurate_instruction_set[opcode](mem, reg);
+        }
+        else{
+            instruction_set[opcode](mem, reg);
+            *cycles += instruction_cycles[opcode];
+        }
+        if(reg->program_counter == start){
+            *instructions = count + 1U;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Two register sets are the same, lazy flags compared as stored
+ */
+static uint8_t _same_state(const cpu_state_t* a, const cpu_state_t* b){
+    return (a->program_counter == b->program_counter &&
+            a->stack_pointer == b->stack_pointer &&
+            a->accumulator == b->accumulator &&
+            a->x == b->x &&
+            a->y == b->y &&
+            a->processor_status.carry == b->processor_status.carry &&
+            a->processor_status.irq_disable == b->processor_status.irq_disable &&
+            a->processor_status.decimal_mode == b->processor_status.decimal_mode &&
+            a->processor_status.overflow == b->processor_status.overflow &&
+            a->processor_status.zero_result == b->processor_status.zero_result &&
+            a->processor_status.negative_result == b->processor_status.negative_result) ? TRUE : FALSE;
+}
+
+uint64_t Z6502::_skip_idle(uint64_t cycle_budget) {
+    cpu_state_t first = _reg;
+    cpu_state_t second;
+    uint64_t lead;
+    uint64_t period;
+    uint64_t lead_instructions;
+    uint64_t period_instructions;
+
+    if(_idle_iteration(&_memory, &first, _timing, &lead, &lead_instructions) < 0){
+        return 0U;
+    }
+    second = first;
+    if(_idle_iteration(&_memory, &second, _timing, &period, &period_instructions) < 0 || _same_state(&first, &second) == FALSE){
+        return 0U;
+    }
+    if(lead + period > cycle_budget){
+        return 0U;
+    }
+
+    /*Whole iterations only, the rest of the budget is interpreted so that
+      the run ends on the instruction it would have ended on*/
+    _reg = first;
+    _instructions += lead_instructions + (cycle_budget - lead) / period * period_instructions;
+    return lead + (cycle_budget - lead) / period * period;
+}
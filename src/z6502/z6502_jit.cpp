@@ -0,0 +1,869 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Dynamic translation of hot basic blocks to x86-64 code.
+
+    Cold code runs through the interpreter, which counts how often each
+    address is reached. Once an address gets hot, the block starting there
+    is translated up to the first control flow instruction. Register moves,
+    flag changes, immediate/zero page/absolute loads, logic and stores are
+    emitted inline, the other instructions call their _execute_decoded<>
+    handler so both paths share the same semantics. Inline memory accesses
+    use the host address of the mapped page, remapping such a page drops
+    all blocks. Code is never translated from device pages.
+
+    Host registers while translated code runs:
+        rbx  cpu_state_t*           r12  memory_t*
+        r14  jit_context_t*         r15  cycles spent in the batch
+
+    Block exits also add the instructions run in the block to
+    jit_context_t::instructions.
+
+    Blocks jump straight into the next one by looking the new program counter
+    up in jit_context_t::block[]. A block is only entered when the interpreter
+    would have executed all of it within the cycle budget, so every core stops
+    on the same instruction. Stores to a page holding translated code drop the
+    blocks overlapping it and leave the current block right after the store.
+    Interpreter handlers can reach a device that raises an interrupt,
+    schedules an event or calls stop(): the block is left right after such
+    a handler when the stop flag is set, as the interpreters do.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <array>
+#include <utility>
+#include "z6502.h"
+#include "z6502_private.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define Z6502_JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+#if defined(Z6502_JIT_X86_64)
+
+/*Size of the executable code arena*/
+#define JIT_ARENA_SIZE_BYTES        (16U * 1024U * 1024U)
+/*Room kept free in the arena before translating a block*/
+#define JIT_MAX_BLOCK_CODE_BYTES    8192U
+/*Instructions per block*/
+#define JIT_MAX_BLOCK_INSTRUCTIONS  32U
+/*Guest bytes a block can span*/
+#define JIT_MAX_BLOCK_BYTES         (JIT_MAX_BLOCK_INSTRUCTIONS * 3U)
+/*Interpreted visits before the block at an address is translated*/
+#define JIT_HOT_THRESHOLD           32U
+
+/*State reached from translated code through r14*/
+typedef struct
+{
+    void* block[Z6502_MAX_MEMORY_SIZE_BYTES];   /* Native entry point per address, NULL if not translated */
+    uint64_t budget;                            /* Cycle budget of the current batch */
+    uint8_t* stop;                              /* Z6502 stop request flag */
+    uint64_t instructions;                      /* Instructions run by translated code in the current batch */
+    uint8_t invalidated;                        /* Some blocks were dropped since entering native code */
+} jit_context_t;
+
+/*Entry trampoline: saves host registers, jumps to code, returns spent cycles*/
+typedef uint64_t (*jit_enter_t)(cpu_state_t* reg, memory_t* mem, jit_context_t* context, uint64_t spent, void* code);
+
+typedef struct jit_s
+{
+    jit_context_t context;
+    uint8_t hot[Z6502_MAX_MEMORY_SIZE_BYTES];   /* Interpreted visits per address */
+    uint8_t direct_page[Z6502_PAGE_COUNT];      /* Blocks hold host addresses into the page */
+    uint8_t* arena;                             /* Executable memory */
+    uint8_t* blocks;                            /* First byte after the trampoline */
+    uint8_t* code;                              /* Next free byte */
+    uint8_t* epilogue;                          /* Return path of the trampoline */
+    uint32_t instructions;                      /* Instructions of the block being translated, up to the one emitted */
+    jit_enter_t enter;
+} jit_t;
+
+/*Host offsets of the guest state*/
+#define REG_PC          offsetof(cpu_state_t, program_counter)
+#define REG_SP          offsetof(cpu_state_t, stack_pointer)
+#define REG_A           offsetof(cpu_state_t, accumulator)
+#define REG_X           offsetof(cpu_state_t, x)
+#define REG_Y           offsetof(cpu_state_t, y)
+#define REG_C           offsetof(cpu_state_t, processor_status.carry)
+#define REG_I           offsetof(cpu_state_t, processor_status.irq_disable)
+#define REG_D           offsetof(cpu_state_t, processor_status.decimal_mode)
+#define REG_V           offsetof(cpu_state_t, processor_status.overflow)
+#define REG_ZR          offsetof(cpu_state_t, processor_status.zero_result)
+#define REG_NR          offsetof(cpu_state_t, processor_status.negative_result)
+
+#define CTX_BLOCK       offsetof(jit_context_t, block)
+#define CTX_BUDGET      offsetof(jit_context_t, budget)
+#define CTX_STOP        offsetof(jit_context_t, stop)
+#define CTX_INSTRUCTIONS offsetof(jit_context_t, instructions)
+#define CTX_INVALIDATED offsetof(jit_context_t, invalidated)
+
+static_assert(REG_PC == 0U, "program counter is addressed as [rbx]");
+static_assert(REG_NR == REG_ZR + 1U, "N and Z result bytes are stored as one word");
+
+//*****************************************************************************
+// Code emission
+//*****************************************************************************
+
+static inline void _emit8(uint8_t** code, uint8_t value){
+    *(*code)++ = value;
+}
+
+static inline void _emit16(uint8_t** code, uint16_t value){
+    memcpy(*code, &value, sizeof(value));
+    *code += sizeof(value);
+}
+
+static inline void _emit32(uint8_t** code, uint32_t value){
+    memcpy(*code, &value, sizeof(value));
+    *code += sizeof(value);
+}
+
+static inline void _emit64(uint8_t** code, uint64_t value){
+    memcpy(*code, &value, sizeof(value));
+    *code += sizeof(value);
+}
+
+/**
+ * @brief Emit a rel32 displacement to a target
+ */
+static inline void _emit_rel32(uint8_t** code, const uint8_t* target){
+    _emit32(code, (uint32_t)(target - (*code + 4)));
+}
+
+/**
+ * @brief Patch a rel32 displacement emitted earlier to point at the current position
+ */
+static inline void _patch_rel32(uint8_t* rel, const uint8_t* code){
+    uint32_t value = (uint32_t)(code - (rel + 4));
+    memcpy(rel, &value, sizeof(value));
+}
+
+/* jmp target */
+static inline void _emit_jmp(uint8_t** code, const uint8_t* target){
+    _emit8(code, 0xE9U);
+    _emit_rel32(code, target);
+}
+
+/* jcc target, cc is the low nibble of the condition code */
+static inline void _emit_jcc(uint8_t** code, uint8_t cc, const uint8_t* target){
+    _emit8(code, 0x0FU);
+    _emit8(code, 0x80U | cc);
+    _emit_rel32(code, target);
+}
+
+#define CC_AE   0x3U
+#define CC_E    0x4U
+#define CC_NE   0x5U
+
+/* movzx eax, byte [rbx + offset] */
+static inline void _emit_load_reg(uint8_t** code, uint8_t offset){
+    _emit8(code, 0x0FU); _emit8(code, 0xB6U); _emit8(code, 0x43U); _emit8(code, offset);
+}
+
+/* mov byte [rbx + offset], al */
+static inline void _emit_store_reg(uint8_t** code, uint8_t offset){
+    _emit8(code, 0x88U); _emit8(code, 0x43U); _emit8(code, offset);
+}
+
+/* mov byte [rbx + offset], value */
+static inline void _emit_set_reg(uint8_t** code, uint8_t offset, uint8_t value){
+    _emit8(code, 0xC6U); _emit8(code, 0x43U); _emit8(code, offset); _emit8(code, value);
+}
+
+/* mov ah, al ; mov word [rbx + zero_result], ax */
+static inline void _emit_update_nz(uint8_t** code){
+    _emit8(code, 0x88U); _emit8(code, 0xC4U);
+    _emit8(code, 0x66U); _emit8(code, 0x89U); _emit8(code, 0x43U); _emit8(code, REG_ZR);
+}
+
+/* mov word [rbx], pc */
+static inline void _emit_set_pc(uint8_t** code, uint16_t pc){
+    _emit8(code, 0x66U); _emit8(code, 0xC7U); _emit8(code, 0x03U);
+    _emit16(code, pc);
+}
+
+/* add r15, cycles */
+static inline void _emit_add_cycles(uint8_t** code, uint32_t cycles){
+    _emit8(code, 0x49U); _emit8(code, 0x81U); _emit8(code, 0xC7U);
+    _emit32(code, cycles);
+}
+
+/* add qword [r14 + instructions], count */
+static inline void _emit_add_instructions(uint8_t** code, uint32_t count){
+    _emit8(code, 0x49U); _emit8(code, 0x81U); _emit8(code, 0x86U);
+    _emit32(code, CTX_INSTRUCTIONS);
+    _emit32(code, count);
+}
+
+/* mov rcx, host */
+static inline void _emit_host_address(uint8_t** code, const uint8_t* host){
+    _emit8(code, 0x48U); _emit8(code, 0xB9U);
+    _emit64(code, (uint64_t)(uintptr_t)host);
+}
+
+/* mov rax, function ; call rax */
+static inline void _emit_call(uint8_t** code, const void* function){
+    _emit8(code, 0x48U); _emit8(code, 0xB8U);
+    _emit64(code, (uint64_t)(uintptr_t)function);
+    _emit8(code, 0xFFU); _emit8(code, 0xD0U);
+}
+
+/**
+ * @brief Call a decoded handler: handler(mem, reg, operand)
+ */
+static void _emit_handler_call(uint8_t** code, decoded_handler_t handler, uint16_t operand){
+    /* mov rdi, r12 ; mov rsi, rbx ; mov edx, operand */
+    _emit8(code, 0x4CU); _emit8(code, 0x89U); _emit8(code, 0xE7U);
+    _emit8(code, 0x48U); _emit8(code, 0x89U); _emit8(code, 0xDEU);
+    _emit8(code, 0xBAU); _emit32(code, operand);
+    _emit_call(code, (const void*)handler);
+}
+
+/**
+ * @brief Leave the block after a store if translated code was dropped
+ * @param jit Translation state
+ * @param code Emission pointer
+ * @param next Address of the next instruction
+ * @param cycles Cycles spent in the block up to here
+ */
+static void _emit_invalidation_check(jit_t* jit, uint8_t** code, uint16_t next, uint32_t cycles){
+    uint8_t* skip;
+
+    /* cmp byte [r14 + invalidated], 0 ; je skip */
+    _emit8(code, 0x41U); _emit8(code, 0x80U); _emit8(code, 0xBEU);
+    _emit32(code, CTX_INVALIDATED); _emit8(code, 0x00U);
+    _emit8(code, 0x74U); _emit8(code, 0x00U);
+    skip = *code;
+
+    _emit_set_pc(code, next);
+    _emit_add_cycles(code, cycles);
+    _emit_add_instructions(code, jit->instructions);
+    _emit_jmp(code, jit->epilogue);
+    skip[-1] = (uint8_t)(*code - skip);
+}
+
+/**
+ * @brief Leave the block after an interpreter handler call if the handler
+ *        reached a device that requested a stop (interrupt raised, earlier
+ *        event scheduled, stop() called), or if it dropped translated code
+ * @param jit Translation state
+ * @param code Emission pointer
+ * @param next Address of the next instruction
+ * @param cycles Cycles spent in the block up to here
+ * @param writes The handler writes memory and may drop translated code
+ */
+static void _emit_handler_check(jit_t* jit, uint8_t** code, uint16_t next, uint32_t cycles, uint8_t writes){
+    uint8_t* leave = NULL;
+    uint8_t* skip;
+
+    if(writes == TRUE){
+        /* cmp byte [r14 + invalidated], 0 ; jne leave */
+        _emit8(code, 0x41U); _emit8(code, 0x80U); _emit8(code, 0xBEU);
+        _emit32(code, CTX_INVALIDATED); _emit8(code, 0x00U);
+        _emit8(code, 0x75U); _emit8(code, 0x00U);
+        leave = *code;
+    }
+    /* mov rcx, [r14 + stop] ; cmp byte [rcx], 0 ; je skip */
+    _emit8(code, 0x49U); _emit8(code, 0x8BU); _emit8(code, 0x8EU); _emit32(code, CTX_STOP);
+    _emit8(code, 0x80U); _emit8(code, 0x39U); _emit8(code, 0x00U);
+    _emit8(code, 0x74U); _emit8(code, 0x00U);
+    skip = *code;
+
+    if(leave != NULL){
+        leave[-1] = (uint8_t)(*code - leave);
+    }
+    _emit_set_pc(code, next);
+    _emit_add_cycles(code, cycles);
+    _emit_add_instructions(code, jit->instructions);
+    _emit_jmp(code, jit->epilogue);
+    skip[-1] = (uint8_t)(*code - skip);
+}
+
+/**
+ * @brief Jump to the block whose entry point is in rax, or return to the
+ *        dispatcher if there is none, it would overrun the budget or a stop
+ *        was requested
+ */
+static void _emit_chain(jit_t* jit, uint8_t** code){
+    /* test rax, rax ; jz epilogue */
+    _emit8(code, 0x48U); _emit8(code, 0x85U); _emit8(code, 0xC0U);
+    _emit_jcc(code, CC_E, jit->epilogue);
+    /* mov rcx, [rax - 8] ; add rcx, r15 ; cmp rcx, [r14 + budget] ; jae epilogue */
+    _emit8(code, 0x48U); _emit8(code, 0x8BU); _emit8(code, 0x48U); _emit8(code, 0xF8U);
+    _emit8(code, 0x4CU); _emit8(code, 0x01U); _emit8(code, 0xF9U);
+    _emit8(code, 0x49U); _emit8(code, 0x3BU); _emit8(code, 0x8EU); _emit32(code, CTX_BUDGET);
+    _emit_jcc(code, CC_AE, jit->epilogue);
+    /* mov rcx, [r14 + stop] ; cmp byte [rcx], 0 ; jne epilogue */
+    _emit8(code, 0x49U); _emit8(code, 0x8BU); _emit8(code, 0x8EU); _emit32(code, CTX_STOP);
+    _emit8(code, 0x80U); _emit8(code, 0x39U); _emit8(code, 0x00U);
+    _emit_jcc(code, CC_NE, jit->epilogue);
+    /* mov byte [r14 + invalidated], 0 ; jmp rax */
+    _emit8(code, 0x41U); _emit8(code, 0xC6U); _emit8(code, 0x86U);
+    _emit32(code, CTX_INVALIDATED); _emit8(code, 0x00U);
+    _emit8(code, 0xFFU); _emit8(code, 0xE0U);
+}
+
+/**
+ * @brief Leave the block to a known address
+ */
+static void _emit_exit(jit_t* jit, uint8_t** code, uint16_t pc, uint32_t cycles){
+    _emit_set_pc(code, pc);
+    _emit_add_cycles(code, cycles);
+    _emit_add_instructions(code, jit->instructions);
+    /* mov rax, [r14 + block + pc * 8] */
+    _emit8(code, 0x49U); _emit8(code, 0x8BU); _emit8(code, 0x86U);
+    _emit32(code, (uint32_t)(CTX_BLOCK + pc * sizeof(void*)));
+    _emit_chain(jit, code);
+}
+
+/**
+ * @brief Leave the block to the address left in the program counter
+ */
+static void _emit_exit_indirect(jit_t* jit, uint8_t** code, uint32_t cycles){
+    _emit_add_cycles(code, cycles);
+    _emit_add_instructions(code, jit->instructions);
+    /* movzx eax, word [rbx] ; mov rax, [r14 + rax * 8 + block] */
+    _emit8(code, 0x0FU); _emit8(code, 0xB7U); _emit8(code, 0x03U);
+    _emit8(code, 0x49U); _emit8(code, 0x8BU); _emit8(code, 0x84U); _emit8(code, 0xC6U);
+    _emit32(code, CTX_BLOCK);
+    _emit_chain(jit, code);
+}
+
+/**
+ * @brief Emit the entry trampoline at the start of the arena
+ */
+static void _emit_trampoline(jit_t* jit){
+    uint8_t* code = jit->arena;
+
+    jit->enter = (jit_enter_t)(void*)code;
+    /* push rbx, r12, r14, r15 ; sub rsp, 8 */
+    _emit8(&code, 0x53U);
+    _emit8(&code, 0x41U); _emit8(&code, 0x54U);
+    _emit8(&code, 0x41U); _emit8(&code, 0x56U);
+    _emit8(&code, 0x41U); _emit8(&code, 0x57U);
+    _emit8(&code, 0x48U); _emit8(&code, 0x83U); _emit8(&code, 0xECU); _emit8(&code, 0x08U);
+    /* mov rbx, rdi ; mov r12, rsi ; mov r14, rdx ; mov r15, rcx */
+    _emit8(&code, 0x48U); _emit8(&code, 0x89U); _emit8(&code, 0xFBU);
+    _emit8(&code, 0x49U); _emit8(&code, 0x89U); _emit8(&code, 0xF4U);
+    _emit8(&code, 0x49U); _emit8(&code, 0x89U); _emit8(&code, 0xD6U);
+    _emit8(&code, 0x49U); _emit8(&code, 0x89U); _emit8(&code, 0xCFU);
+    /* jmp r8 */
+    _emit8(&code, 0x41U); _emit8(&code, 0xFFU); _emit8(&code, 0xE0U);
+
+    jit->epilogue = code;
+    /* mov rax, r15 ; add rsp, 8 ; pop r15, r14, r12, rbx ; ret */
+    _emit8(&code, 0x4CU); _emit8(&code, 0x89U); _emit8(&code, 0xF8U);
+    _emit8(&code, 0x48U); _emit8(&code, 0x83U); _emit8(&code, 0xC4U); _emit8(&code, 0x08U);
+    _emit8(&code, 0x41U); _emit8(&code, 0x5FU);
+    _emit8(&code, 0x41U); _emit8(&code, 0x5EU);
+    _emit8(&code, 0x41U); _emit8(&code, 0x5CU);
+    _emit8(&code, 0x5BU);
+    _emit8(&code, 0xC3U);
+
+    jit->blocks = code;
+    jit->code = code;
+}
+
+//*****************************************************************************
+// Translation
+//*****************************************************************************
+
+/**
+ * @brief Build the handler table called by translated code at compile time
+ * @return One specialized handler per opcode, NULL for undefined opcodes
+ */
+template<std::size_t... OPCODES>
+static constexpr std::array<decoded_handler_t, 256> _make_jit_handler_set(std::index_sequence<OPCODES...>){
+    return {{ (instruction_id[OPCODES] != OP___ ? &_execute_decoded<OPCODES> : (decoded_handler_t)NULL)... }};
+}
+
+static constexpr std::array<decoded_handler_t, 256> jit_handler_set = _make_jit_handler_set(std::make_index_sequence<256>());
+
+/**
+ * @brief Register holding the source of a load, store or transfer
+ */
+static uint8_t _register_offset(instruction_id_t id){
+    switch(id){
+        case OP_LDX: case OP_STX: case OP_TXA: case OP_TXS: case OP_INX: case OP_DEX:
+            return REG_X;
+        case OP_LDY: case OP_STY: case OP_TYA: case OP_INY: case OP_DEY:
+            return REG_Y;
+        default:
+            return REG_A;
+    }
+}
+
+/**
+ * @brief Instruction writes memory through its handler
+ */
+static uint8_t _writes_memory(instruction_id_t id, addressing_mode_t mode){
+    switch(id){
+        case OP_STA: case OP_STX: case OP_STY: case OP_INC: case OP_DEC: case OP_PHA: case OP_PHP:
+            return TRUE;
+        case OP_ASL: case OP_LSR: case OP_ROL: case OP_ROR:
+            return mode != ACC;
+        default:
+            return FALSE;
+    }
+}
+
+/**
+ * @brief Emit a conditional branch ending the block
+ */
+static void _emit_branch(jit_t* jit, uint8_t** code, instruction_id_t id, uint16_t next, uint8_t offset, uint32_t cycles){
+    uint8_t flag;
+    uint8_t value;
+    uint8_t not_taken;
+    uint8_t* fallthrough;
+
+    switch(id){
+        case OP_BCC: flag = REG_C;  value = 0U; not_taken = CC_NE; break;
+        case OP_BCS: flag = REG_C;  value = 1U; not_taken = CC_NE; break;
+        case OP_BVC: flag = REG_V;  value = 0U; not_taken = CC_NE; break;
+        case OP_BVS: flag = REG_V;  value = 1U; not_taken = CC_NE; break;
+        case OP_BEQ: flag = REG_ZR; value = 0U; not_taken = CC_NE; break;
+        case OP_BNE: flag = REG_ZR; value = 0U; not_taken = CC_E;  break;
+        case OP_BPL: flag = REG_NR; value = 0x80U; not_taken = CC_NE; break;
+        default:     flag = REG_NR; value = 0x80U; not_taken = CC_E;  break;
+    }
+
+    if(flag == REG_NR){
+        /* test byte [rbx + negative_result], 0x80 */
+        _emit8(code, 0xF6U); _emit8(code, 0x43U); _emit8(code, flag); _emit8(code, value);
+    }
+    else{
+        /* cmp byte [rbx + flag], value */
+        _emit8(code, 0x80U); _emit8(code, 0x7BU); _emit8(code, flag); _emit8(code, value);
+    }
+    _emit_jcc(code, not_taken, *code);
+    fallthrough = *code - 4;
+
+    _emit_exit(jit, code, (uint16_t)(next + (int8_t)offset), cycles);
+    _patch_rel32(fallthrough, *code);
+    _emit_exit(jit, code, next, cycles);
+}
+
+/**
+ * @brief Host address of a memory byte readable with a direct load
+ * @returns Host address, NULL if the page is a device or unmapped
+ */
+static const uint8_t* _direct_read(jit_t* jit, memory_t* mem, uint16_t addr){
+    uint8_t* page = mem->read_page[addr >> 8];
+
+    if(page == NULL){
+        return NULL;
+    }
+    jit->direct_page[addr >> 8] = TRUE;
+    return &page[addr & 0xFFU];
+}
+
+/**
+ * @brief Host address of a memory byte writable with a direct store
+ * @returns Host address, NULL for ROM, devices and unmapped pages
+ */
+static uint8_t* _direct_write(jit_t* jit, memory_t* mem, uint16_t addr){
+    if(_page_writable(mem, addr >> 8) == FALSE){
+        return NULL;
+    }
+    jit->direct_page[addr >> 8] = TRUE;
+    return &mem->page_map[addr >> 8].base[addr & 0xFFU];
+}
+
+/**
+ * @brief Emit one instruction
+ * @param jit Translation state
+ * @param code Emission pointer
+ * @param mem Pointer to memory space
+ * @param opcode Opcode
+ * @param operand Raw operand
+ * @param next Address of the next instruction
+ * @param cycles Cycles spent in the block including this instruction
+ * @returns TRUE if the instruction ends the block
+ */
+static uint8_t _emit_instruction(jit_t* jit, uint8_t** code, memory_t* mem, uint8_t opcode, uint16_t operand, uint16_t next, uint32_t cycles){
+    instruction_id_t id = instruction_id[opcode];
+    addressing_mode_t mode = instruction_mode[opcode];
+    const uint8_t* source = NULL;
+    uint8_t* target = NULL;
+    uint8_t* skip;
+
+    if(mode == ZP || mode == ABS){
+        source = _direct_read(jit, mem, operand);
+    }
+
+    switch(id){
+        case OP_LDA: case OP_LDX: case OP_LDY:
+        case OP_AND: case OP_ORA: case OP_EOR:
+            if(mode != IMM && source == NULL){
+                break;
+            }
+            if(source != NULL){
+                _emit_host_address(code, source);
+            }
+            if(id == OP_AND || id == OP_ORA || id == OP_EOR){
+                _emit_load_reg(code, REG_A);
+                /* and/or/xor al, imm8 or [rcx] */
+                if(mode == IMM){
+                    _emit8(code, id == OP_AND ? 0x24U : id == OP_ORA ? 0x0CU : 0x34U);
+                    _emit8(code, (uint8_t)operand);
+                }
+                else{
+                    _emit8(code, id == OP_AND ? 0x22U : id == OP_ORA ? 0x0AU : 0x32U);
+                    _emit8(code, 0x01U);
+                }
+            }
+            else if(mode == IMM){
+                /* mov eax, imm */
+                _emit8(code, 0xB8U); _emit32(code, (uint8_t)operand);
+            }
+            else{
+                /* movzx eax, byte [rcx] */
+                _emit8(code, 0x0FU); _emit8(code, 0xB6U); _emit8(code, 0x01U);
+            }
+            _emit_store_reg(code, _register_offset(id));
+            _emit_update_nz(code);
+            return FALSE;
+
+        case OP_STA: case OP_STX: case OP_STY:
+            if(mode == ZP || mode == ABS){
+                target = _direct_write(jit, mem, operand);
+            }
+            if(target == NULL){
+                break;
+            }
+            /* mov rcx, target ; mov byte [rcx], al */
+            _emit_host_address(code, target);
+            _emit_load_reg(code, _register_offset(id));
+            _emit8(code, 0x88U); _emit8(code, 0x01U);
+            /* cmp byte [r12 + code_page + page], 0 ; je skip */
+            _emit8(code, 0x41U); _emit8(code, 0x80U); _emit8(code, 0xBCU); _emit8(code, 0x24U);
+            _emit32(code, (uint32_t)(offsetof(memory_t, code_page) + (operand >> 8)));
+            _emit8(code, 0x00U);
+            _emit_jcc(code, CC_E, *code);
+            skip = *code - 4;
+            /* _invalidate_code_page(mem, page) */
+            _emit8(code, 0x4CU); _emit8(code, 0x89U); _emit8(code, 0xE7U);
+            _emit8(code, 0xBEU); _emit32(code, operand >> 8);
+            _emit_call(code, (const void*)&_invalidate_code_page);
+            _emit_invalidation_check(jit, code, next, cycles);
+            _patch_rel32(skip, *code);
+            return FALSE;
+
+        case OP_TAX: case OP_TAY: case OP_TXA: case OP_TYA: case OP_TSX:
+            _emit_load_reg(code, id == OP_TSX ? REG_SP : _register_offset(id));
+            _emit_store_reg(code, id == OP_TAX || id == OP_TSX ? REG_X : id == OP_TAY ? REG_Y : REG_A);
+            _emit_update_nz(code);
+            return FALSE;
+
+        case OP_TXS:
+            /* movzx eax, byte [rbx + x] ; mov word [rbx + stack_pointer], ax */
+            _emit_load_reg(code, REG_X);
+            _emit8(code, 0x66U); _emit8(code, 0x89U); _emit8(code, 0x43U); _emit8(code, REG_SP);
+            return FALSE;
+
+        case OP_INX: case OP_INY: case OP_DEX: case OP_DEY:
+            _emit_load_reg(code, _register_offset(id));
+            /* inc al / dec al */
+            _emit8(code, 0xFEU); _emit8(code, id == OP_INX || id == OP_INY ? 0xC0U : 0xC8U);
+            _emit_store_reg(code, _register_offset(id));
+            _emit_update_nz(code);
+            return FALSE;
+
+        case OP_CLC: _emit_set_reg(code, REG_C, 0U); return FALSE;
+        case OP_SEC: _emit_set_reg(code, REG_C, 1U); return FALSE;
+        case OP_CLI: _emit_set_reg(code, REG_I, 0U); return FALSE;
+        case OP_SEI: _emit_set_reg(code, REG_I, 1U); return FALSE;
+        case OP_CLD: _emit_set_reg(code, REG_D, 0U); return FALSE;
+        case OP_SED: _emit_set_reg(code, REG_D, 1U); return FALSE;
+        case OP_CLV: _emit_set_reg(code, REG_V, 0U); return FALSE;
+        case OP_NOP: return FALSE;
+
+        case OP_BCC: case OP_BCS: case OP_BEQ: case OP_BNE:
+        case OP_BMI: case OP_BPL: case OP_BVC: case OP_BVS:
+            _emit_branch(jit, code, id, next, (uint8_t)operand, cycles);
+            return TRUE;
+
+        case OP_JMP:
+            if(mode == ABS){
+                _emit_exit(jit, code, operand, cycles);
+                return TRUE;
+            }
+            /* Indirect jump through the handler */
+            _emit_handler_call(code, jit_handler_set[opcode], operand);
+            _emit_exit_indirect(jit, code, cycles);
+            return TRUE;
+
+        case OP_JSR:
+            _emit_set_pc(code, next);
+            _emit_handler_call(code, jit_handler_set[opcode], operand);
+            _emit_exit(jit, code, operand, cycles);
+            return TRUE;
+
+        case OP_RTS: case OP_RTI: case OP_BRK:
+            _emit_set_pc(code, next);
+            _emit_handler_call(code, jit_handler_set[opcode], operand);
+            _emit_exit_indirect(jit, code, cycles);
+            return TRUE;
+
+        default:
+            break;
+    }
+
+    /*Everything else goes through the interpreter handler, which may reach
+      a device on the bus slow path*/
+    _emit_handler_call(code, jit_handler_set[opcode], operand);
+    _emit_handler_check(jit, code, next, cycles, _writes_memory(id, mode));
+    return FALSE;
+}
+
+/**
+ * @brief Translate the block starting at an address
+ * @param jit Translation state
+ * @param mem Pointer to memory space
+ * @param start Guest address
+ * @returns Native entry point, NULL if the first instruction cannot be translated
+ */
+static uint8_t* _jit_translate(jit_t* jit, memory_t* mem, uint16_t start){
+    uint8_t* code;
+    uint8_t* entry;
+    uint16_t pc = start;
+    uint16_t next;
+    uint16_t operand;
+    uint8_t opcode;
+    uint8_t length;
+    uint8_t ended = FALSE;
+    uint32_t cycles = 0U;
+    uint32_t last_cycles = 0U;
+    uint64_t head;
+    unsigned int count;
+
+    if((size_t)(jit->arena + JIT_ARENA_SIZE_BYTES - jit->code) < JIT_MAX_BLOCK_CODE_BYTES){
+        _jit_flush(jit);
+    }
+
+    /*Cycles up to the last instruction are kept right before the entry point*/
+    code = (uint8_t*)(((uintptr_t)jit->code + sizeof(uint64_t) + 15U) & ~(uintptr_t)15U);
+    entry = code;
+
+    for(count = 0U; count < JIT_MAX_BLOCK_INSTRUCTIONS && ended == FALSE; count++){
+        /*Let the interpreter run undefined opcodes and code from devices*/
+        if(mem->read_page[pc >> 8] == NULL){
+            break;
+        }
+        opcode = _mem_read(mem, pc);
+        length = 1U + _operand_length(instruction_mode[opcode]);
+        next = (uint16_t)(pc + length);
+        if(instruction_id[opcode] == OP___ || mem->read_page[(uint16_t)(next - 1U) >> 8] == NULL){
+            break;
+        }
+        operand = 0U;
+        if(length >= 2U){
+            operand = _mem_read(mem, (uint16_t)(pc + 1U));
+        }
+        if(length == 3U){
+            operand |= _mem_read(mem, (uint16_t)(pc + 2U)) << 8;
+        }
+
+        /*Watch every page the instruction bytes come from*/
+        _watch_code_page(mem, pc >> 8);
+        _watch_code_page(mem, (uint16_t)(next - 1U) >> 8);
+
+        last_cycles = instruction_cycles[opcode];
+        cycles += last_cycles;
+        jit->instructions = count + 1U;
+        ended = _emit_instruction(jit, &code, mem, opcode, operand, next, cycles);
+        pc = next;
+    }
+    if(count == 0U){
+        return NULL;
+    }
+    if(ended == FALSE){
+        _emit_exit(jit, &code, pc, cycles);
+    }
+
+    head = cycles - last_cycles;
+    memcpy(entry - sizeof(uint64_t), &head, sizeof(head));
+    jit->code = code;
+    jit->context.block[start] = entry;
+    return entry;
+}
+
+//*****************************************************************************
+// Translation state
+//*****************************************************************************
+
+/**
+ * @brief Allocate translation state and its code arena
+ * @returns Translation state, NULL if executable memory is not available
+ */
+static jit_t* _jit_create(void){
+    jit_t* jit = (jit_t*)calloc(1, sizeof(jit_t));
+    void* arena;
+
+    if(jit == NULL){
+        return NULL;
+    }
+    arena = mmap(NULL, JIT_ARENA_SIZE_BYTES, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(arena == MAP_FAILED){
+        free(jit);
+        return NULL;
+    }
+    jit->arena = (uint8_t*)arena;
+    _emit_trampoline(jit);
+    return jit;
+}
+
+int _jit_prewarm(memory_t* mem, uint16_t address){
+    if(mem->jit == NULL){
+        mem->jit = _jit_create();
+        if(mem->jit == NULL){
+            return -1;
+        }
+    }
+    if(mem->jit->context.block[address] != NULL){
+        return 0;
+    }
+    return (_jit_translate(mem->jit, mem, address) != NULL) ? 1 : 0;
+}
+
+void _jit_invalidate_page(jit_t* jit, uint8_t page){
+    /*Blocks starting in this page or close enough before it to reach it*/
+    uint16_t addr = (uint16_t)((page << 8) - JIT_MAX_BLOCK_BYTES);
+
+    for(unsigned int i = 0U; i < 256U + JIT_MAX_BLOCK_BYTES; i++, addr++){
+        jit->context.block[addr] = NULL;
+        jit->hot[addr] = 0U;
+    }
+    jit->context.invalidated = TRUE;
+}
+
+void _jit_unmap_page(jit_t* jit, uint8_t page){
+    if(jit->direct_page[page] != FALSE){
+        _jit_flush(jit);
+    }
+}
+
+void _jit_flush(jit_t* jit){
+    if(jit == NULL){
+        return;
+    }
+    memset(jit->context.block, 0, sizeof(jit->context.block));
+    memset(jit->hot, 0, sizeof(jit->hot));
+    memset(jit->direct_page, 0, sizeof(jit->direct_page));
+    jit->context.invalidated = TRUE;
+    jit->code = jit->blocks;
+}
+
+void _jit_free(jit_t* jit){
+    if(jit == NULL){
+        return;
+    }
+    munmap(jit->arena, JIT_ARENA_SIZE_BYTES);
+    free(jit);
+}
+
+uint64_t Z6502::_run_jit(uint64_t cycle_budget) {
+    /*Work on local copies for the whole batch*/
+    cpu_state_t reg;
+    memory_t* mem = &_memory;
+    jit_t* jit = mem->jit;
+    uint64_t spent = 0U;
+    uint64_t executed = 0U;
+    uint64_t head;
+    uint8_t* code;
+    uint8_t opcode;
+
+    if(jit == NULL){
+        jit = _jit_create();
+        if(jit == NULL){
+            /*No executable memory, interpret*/
+            return _run_cached<timing_fast_t>(cycle_budget);
+        }
+        mem->jit = jit;
+    }
+
+    reg = _reg;
+    jit->context.budget = cycle_budget;
+    jit->context.stop = &_stop_requested;
+    jit->context.instructions = 0U;
+    while(spent < cycle_budget && _stop_requested == FALSE){
+        code = (uint8_t*)jit->context.block[reg.program_counter];
+        if(code == NULL && jit->hot[reg.program_counter] >= JIT_HOT_THRESHOLD){
+            code = _jit_translate(jit, mem, reg.program_counter);
+            if(code == NULL){
+                /*Not translatable now, count again*/
+                jit->hot[reg.program_counter] = 0U;
+            }
+        }
+        if(code != NULL){
+            /*Only enter blocks the interpreter would run to the end*/
+            memcpy(&head, code - sizeof(uint64_t), sizeof(head));
+            if(spent + head < cycle_budget){
+                jit->context.invalidated = FALSE;
+                spent = jit->enter(&reg, mem, &jit->context, spent, code);
+                continue;
+            }
+        }
+        else if(jit->hot[reg.program_counter] < JIT_HOT_THRESHOLD){
+            jit->hot[reg.program_counter]++;
+        }
+
+        /*Cold code, interpret one instruction*/
+        opcode = _mem_read(mem, reg.program_counter);
+        if(instruction_set[opcode] == NULL){
+            /*Unhandled opcode, stay on it*/
+            _halted = TRUE;
+            break;
+        }
+        reg.program_counter++;
+        instruction_set[opcode](mem, &reg);
+        spent += instruction_cycles[opcode];
+        executed++;
+    }
+
+    _reg = reg;
+    _cycles += spent;
+    _instructions += executed + jit->context.instructions;
+    return spent;
+}
+
+#else
+
+/*No translator for this host, the JIT core runs the predecoded cache*/
+
+int _jit_prewarm(memory_t* mem, uint16_t address){
+    return -1;
+}
+
+void _jit_invalidate_page(struct jit_s* jit, uint8_t page){
+}
+
+void _jit_flush(struct jit_s* jit){
+}
+
+void _jit_unmap_page(struct jit_s* jit, uint8_t page){
+}
+
+void _jit_free(struct jit_s* jit){
+}
+
+uint64_t Z6502::_run_jit(uint64_t cycle_budget) {
+    return _run_cached<timing_fast_t>(cycle_budget);
+}
+
+#endif
@@ -0,0 +1,315 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Instances running the same ROM in lockstep. Instances are packed into
+    groups of Z6502_LOCKSTEP_LANES that run on the AVX2 interpreter of
+    z6502_lockstep_avx2.cpp. An instance leaving its group gets a private
+    copy of its memory and a scalar Z6502, and runs on its own from then on.
+    Without AVX2 every instance leaves its group on the first run().
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "z6502.h"
+#include "z6502_lockstep.h"
+#include "z6502_private.h"
+
+/**
+ * @brief AVX2 interpreter built in and supported by the host
+ */
+static uint8_t _lockstep_simd_available(void){
+#if defined(Z6502_LOCKSTEP_AVX2)
+    return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * @brief Copy the registers of a lane to an architectural register set
+ */
+static void _lockstep_dump(const lockstep_group_t* group, unsigned int slot, register_set_t* register_set){
+    const register_set_soa_t* reg = &group->reg;
+
+    register_set->program_counter = reg->program_counter[slot];
+    register_set->stack_pointer = reg->stack_pointer[slot];
+    register_set->accumulator = reg->accumulator[slot];
+    register_set->x = reg->x[slot];
+    register_set->y = reg->y[slot];
+
+    register_set->processor_status.carry = reg->carry[slot];
+    register_set->processor_status.zero = (reg->zero_result[slot] == 0U) ? 1U : 0U;
+    register_set->processor_status.irq_disable = reg->irq_disable[slot];
+    register_set->processor_status.decimal_mode = reg->decimal_mode[slot];
+    register_set->processor_status.break_cmd = 0U;
+    register_set->processor_status.overflow = reg->overflow[slot];
+    register_set->processor_status.negative = (reg->negative_result[slot] >> 7) & 0x01;
+}
+
+/**
+ * @brief Release the memory of a group
+ */
+static void _lockstep_free_group(lockstep_group_t* group){
+    free(group->memory);
+    free(group->lane_memory);
+}
+
+/**
+ * @brief Set up a group with every lane in reset state
+ * @param group Group, zeroed
+ * @param lanes Number of lanes in use
+ * @param memory_image 64 KiB initial memory of every lane, NULL for zeros
+ * @returns 0 on success, -1 if out of memory
+ */
+static int _lockstep_init_group(lockstep_group_t* group, unsigned int lanes, const uint8_t* memory_image){
+    group->memory = (uint8_t (*)[Z6502_LOCKSTEP_LANES])aligned_alloc(32U, Z6502_MAX_MEMORY_SIZE_BYTES * Z6502_LOCKSTEP_LANES);
+    group->lane_memory = (memory_t*)calloc(Z6502_LOCKSTEP_LANES, sizeof(memory_t));
+    if(group->memory == NULL || group->lane_memory == NULL){
+        _lockstep_free_group(group);
+        return -1;
+    }
+
+    for(uint32_t addr = 0U; addr < Z6502_MAX_MEMORY_SIZE_BYTES; addr++){
+        memset(group->memory[addr], (memory_image != NULL) ? memory_image[addr] : 0U, Z6502_LOCKSTEP_LANES);
+    }
+    /*Z clear, see Z6502::reset()*/
+    memset(group->reg.zero_result, 1U, Z6502_LOCKSTEP_LANES);
+
+    group->active = (lanes < Z6502_LOCKSTEP_LANES) ? (1U << lanes) - 1U : 0xFFFFFFFFU;
+    group->lead = 0U;
+    group->halted = FALSE;
+    group->cycles = 0U;
+#if defined(Z6502_LOCKSTEP_AVX2)
+    _lockstep_attach(group);
+#endif
+    return 0;
+}
+
+Z6502Lockstep::Z6502Lockstep(unsigned int lane_count, const uint8_t* memory_image)
+{
+    int result;
+
+    _lane_count = lane_count;
+    _group_count = (lane_count + Z6502_LOCKSTEP_LANES - 1U) / Z6502_LOCKSTEP_LANES;
+    _simd = _lockstep_simd_available();
+    _core = Z6502_DEFAULT_CORE;
+
+    _lane = (lockstep_lane_t*)calloc(_lane_count, sizeof(lockstep_lane_t));
+    _group = (lockstep_group_t*)aligned_alloc(32U, _group_count * sizeof(lockstep_group_t));
+    if(_group != NULL){
+        memset(_group, 0, _group_count * sizeof(lockstep_group_t));
+    }
+
+    result = (_lane != NULL && _group != NULL) ? 0 : -1;
+    for(unsigned int i = 0U; i < _group_count && result == 0; i++){
+        result = _lockstep_init_group(&_group[i], lane_count - i * Z6502_LOCKSTEP_LANES, memory_image);
+        if(result < 0){
+            while(i > 0U){
+                _lockstep_free_group(&_group[--i]);
+            }
+        }
+    }
+    if(result < 0){
+        /*Out of memory, leave no instance*/
+        free(_lane);
+        free(_group);
+        _lane = NULL;
+        _group = NULL;
+        _lane_count = 0U;
+        _group_count = 0U;
+    }
+}
+
+int Z6502Lockstep::_leave(unsigned int lane){
+    lockstep_group_t* group = &_group[lane / Z6502_LOCKSTEP_LANES];
+    unsigned int slot = lane % Z6502_LOCKSTEP_LANES;
+    lockstep_lane_t* state = &_lane[lane];
+    register_set_t reg;
+
+    group->active &= ~(1U << slot);
+    if(group->active != 0U){
+        group->lead = __builtin_ctz(group->active);
+    }
+
+    state->memory_space = (uint8_t*)malloc(Z6502_MAX_MEMORY_SIZE_BYTES);
+    if(state->memory_space == NULL){
+        return -1;
+    }
+    for(uint32_t addr = 0U; addr < Z6502_MAX_MEMORY_SIZE_BYTES; addr++){
+        state->memory_space[addr] = group->memory[addr][slot];
+    }
+
+    state->cpu = new Z6502(state->memory_space);
+    state->cpu->set_core(_core);
+    _lockstep_dump(group, slot, &reg);
+    state->cpu->load_register(&reg);
+    return 0;
+}
+
+void Z6502Lockstep::set_core(core_t core){
+    _core = core;
+    for(unsigned int lane = 0U; lane < _lane_count; lane++){
+        if(_lane[lane].cpu != NULL){
+            _lane[lane].cpu->set_core(core);
+        }
+    }
+}
+
+uint8_t Z6502Lockstep::read_memory(unsigned int lane, uint16_t addr){
+    if(_lane[lane].memory_space != NULL){
+        return _lane[lane].memory_space[addr];
+    }
+    return _group[lane / Z6502_LOCKSTEP_LANES].memory[addr][lane % Z6502_LOCKSTEP_LANES];
+}
+
+void Z6502Lockstep::write_memory(unsigned int lane, uint16_t addr, uint8_t value){
+    if(_lane[lane].cpu != NULL){
+        _lane[lane].memory_space[addr] = value;
+        _lane[lane].cpu->invalidate_cache();
+    }
+    else{
+        _group[lane / Z6502_LOCKSTEP_LANES].memory[addr][lane % Z6502_LOCKSTEP_LANES] = value;
+    }
+}
+
+register_set_t* Z6502Lockstep::dump_register(unsigned int lane, register_set_t* register_set){
+    if(_lane[lane].cpu != NULL){
+        return _lane[lane].cpu->dump_register(register_set);
+    }
+    _lockstep_dump(&_group[lane / Z6502_LOCKSTEP_LANES], lane % Z6502_LOCKSTEP_LANES, register_set);
+    return register_set;
+}
+
+void Z6502Lockstep::load_register(unsigned int lane, const register_set_t* register_set){
+    register_set_soa_t* reg = &_group[lane / Z6502_LOCKSTEP_LANES].reg;
+    unsigned int slot = lane % Z6502_LOCKSTEP_LANES;
+
+    if(_lane[lane].cpu != NULL){
+        _lane[lane].cpu->load_register(register_set);
+        return;
+    }
+
+    reg->program_counter[slot] = register_set->program_counter;
+    reg->stack_pointer[slot] = register_set->stack_pointer % 256;
+    reg->accumulator[slot] = register_set->accumulator;
+    reg->x[slot] = register_set->x;
+    reg->y[slot] = register_set->y;
+
+    reg->carry[slot] = register_set->processor_status.carry & 0x01;
+    reg->irq_disable[slot] = register_set->processor_status.irq_disable & 0x01;
+    reg->decimal_mode[slot] = register_set->processor_status.decimal_mode & 0x01;
+    reg->overflow[slot] = register_set->processor_status.overflow & 0x01;
+    reg->zero_result[slot] = (register_set->processor_status.zero != 0U) ? 0U : 1U;
+    reg->negative_result[slot] = (register_set->processor_status.negative != 0U) ? 0x80U : 0U;
+}
+
+unsigned int Z6502Lockstep::run(uint64_t cycle_budget){
+    unsigned int in_lockstep = 0U;
+    lockstep_group_t* group;
+    uint64_t spent;
+    uint32_t leaving;
+    unsigned int lane;
+
+    /*Instances already on their own*/
+    for(lane = 0U; lane < _lane_count; lane++){
+        if(_lane[lane].cpu != NULL){
+            _lane[lane].cpu->run(cycle_budget);
+        }
+    }
+
+    for(unsigned int i = 0U; i < _group_count; i++){
+        group = &_group[i];
+        if(group->active == 0U || group->halted != FALSE){
+            in_lockstep += __builtin_popcount(group->active);
+            continue;
+        }
+
+        /*Lanes loaded with another program counter than the lead lane, or
+          every lane without vector unit, leave before the first instruction*/
+        leaving = 0U;
+        for(uint32_t left = group->active; left != 0U; left &= left - 1U){
+            unsigned int slot = __builtin_ctz(left);
+            if(_simd == FALSE || group->reg.program_counter[slot] != group->reg.program_counter[group->lead]){
+                leaving |= 1U << slot;
+            }
+        }
+        group->program_counter = group->reg.program_counter[group->lead];
+
+        spent = 0U;
+        for(;;){
+            /*Lanes leave at an instruction boundary with spent cycles in common
+              with the group, and finish the budget on their own*/
+            for(uint32_t left = leaving; left != 0U; left &= left - 1U){
+                lane = i * Z6502_LOCKSTEP_LANES + __builtin_ctz(left);
+                _lane[lane].cycles = group->cycles + spent;
+                if(_leave(lane) == 0 && spent < cycle_budget){
+                    _lane[lane].cpu->run(cycle_budget - spent);
+                }
+            }
+            if(group->active == 0U || group->halted != FALSE || spent >= cycle_budget){
+                break;
+            }
+#if defined(Z6502_LOCKSTEP_AVX2)
+            leaving = _lockstep_run(group, cycle_budget, &spent);
+#endif
+        }
+        group->cycles += spent;
+
+        for(uint32_t left = group->active; left != 0U; left &= left - 1U){
+            group->reg.program_counter[__builtin_ctz(left)] = group->program_counter;
+        }
+        in_lockstep += __builtin_popcount(group->active);
+    }
+    return in_lockstep;
+}
+
+uint64_t Z6502Lockstep::get_cycles(unsigned int lane){
+    if(_lane[lane].cpu != NULL){
+        return _lane[lane].cycles + _lane[lane].cpu->get_cycles();
+    }
+    if(in_lockstep(lane) == FALSE){
+        /*Could not leave its group*/
+        return _lane[lane].cycles;
+    }
+    return _group[lane / Z6502_LOCKSTEP_LANES].cycles;
+}
+
+uint8_t Z6502Lockstep::is_halted(unsigned int lane){
+    if(_lane[lane].cpu != NULL){
+        return _lane[lane].cpu->is_halted();
+    }
+    if(in_lockstep(lane) == FALSE){
+        /*Could not leave its group*/
+        return TRUE;
+    }
+    return _group[lane / Z6502_LOCKSTEP_LANES].halted;
+}
+
+uint8_t Z6502Lockstep::in_lockstep(unsigned int lane){
+    return (_lane[lane].cpu == NULL && ((_group[lane / Z6502_LOCKSTEP_LANES].active >> (lane % Z6502_LOCKSTEP_LANES)) & 0x01) != 0U) ? TRUE : FALSE;
+}
+
+Z6502Lockstep::~Z6502Lockstep()
+{
+    for(unsigned int lane = 0U; lane < _lane_count; lane++){
+        delete _lane[lane].cpu;
+        free(_lane[lane].memory_space);
+    }
+    for(unsigned int i = 0U; i < _group_count; i++){
+        _lockstep_free_group(&_group[i]);
+    }
+    free(_lane);
+    free(_group);
+}
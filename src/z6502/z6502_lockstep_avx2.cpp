@@ -0,0 +1,710 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    AVX2 lockstep interpreter. All lanes of a group share one program counter
+    and execute the same instruction, each on its own registers and memory.
+    Registers are one 32 byte vector each and memory is interleaved by lane,
+    so a load or store at an address common to all lanes is one vector
+    access. Indexed accesses whose address differs between lanes fall back
+    to one byte per lane.
+
+    Instructions without a vector form (BRK and decimal mode arithmetic) run
+    lane by lane through the scalar handlers, using a per lane view of the
+    interleaved memory. Whenever lanes would continue at different addresses,
+    or find different code bytes at the shared program counter, the minority
+    leaves the group and the caller moves it to a scalar Z6502.
+
+    This file is built with -mavx2 and only called once the CPU reported
+    AVX2 support (see z6502_lockstep.cpp).
+*/
+
+#include <immintrin.h>
+#include <array>
+#include <utility>
+#include "z6502.h"
+#include "z6502_lockstep.h"
+#include "z6502_private.h"
+
+/*Effective address of an instruction in every lane*/
+typedef struct
+{
+    uint8_t uniform;                            /* All active lanes access addr[0] */
+    uint16_t addr[Z6502_LOCKSTEP_LANES];        /* Address per lane when not uniform */
+} lane_address_t;
+
+/*Handler executing one instruction on all active lanes. Returns the lanes
+  leaving the group, their program counter is left in reg.program_counter[]*/
+typedef uint32_t (*lockstep_handler_t)(lockstep_group_t* group, uint16_t operand);
+
+//*****************************************************************************
+// Vectors
+//*****************************************************************************
+
+static inline __m256i _lanes_get(const uint8_t* lanes){
+    return _mm256_load_si256((const __m256i*)lanes);
+}
+
+static inline void _lanes_set(uint8_t* lanes, __m256i value){
+    _mm256_store_si256((__m256i*)lanes, value);
+}
+
+static inline __m256i _lanes_splat(uint8_t value){
+    return _mm256_set1_epi8((char)value);
+}
+
+/**
+ * @brief Lanes whose byte equals a value
+ * @return Lane bitmask
+ */
+static inline uint32_t _lanes_equal(__m256i value, uint8_t reference){
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(value, _lanes_splat(reference)));
+}
+
+/**
+ * @brief Lanes whose byte differs from the one of the lead lane
+ * @return Lane bitmask, active lanes only
+ */
+static inline uint32_t _lanes_differ(const lockstep_group_t* group, __m256i value){
+    alignas(32) uint8_t bytes[Z6502_LOCKSTEP_LANES];
+    _lanes_set(bytes, value);
+    return group->active & ~_lanes_equal(value, bytes[group->lead]);
+}
+
+/**
+ * @brief Bit 7 of every byte, as 0 or 1
+ */
+static inline __m256i _lanes_bit7(__m256i value){
+    return _mm256_and_si256(_mm256_srli_epi16(value, 7), _lanes_splat(0x01U));
+}
+
+/**
+ * @brief Unsigned a < b per byte, as 0 or 1
+ */
+static inline __m256i _lanes_below(__m256i a, __m256i b){
+    return _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a), _lanes_splat(0x01U));
+}
+
+/**
+ * @brief Logical shift right by one per byte
+ */
+static inline __m256i _lanes_shift_right(__m256i value){
+    return _mm256_and_si256(_mm256_srli_epi16(value, 1), _lanes_splat(0x7FU));
+}
+
+//*****************************************************************************
+// Memory access
+//*****************************************************************************
+
+/**
+ * @brief Lane view accessors backing lane_memory, context is the lane column
+ */
+static uint8_t _lane_device_read(void* context, uint16_t addr){
+    return ((uint8_t*)context)[addr * Z6502_LOCKSTEP_LANES];
+}
+
+static void _lane_device_write(void* context, uint16_t addr, uint8_t value){
+    ((uint8_t*)context)[addr * Z6502_LOCKSTEP_LANES] = value;
+}
+
+/**
+ * @brief Read the bytes of every lane at an address common to all lanes
+ */
+static inline __m256i _lanes_row(const lockstep_group_t* group, uint16_t addr){
+    return _mm256_load_si256((const __m256i*)group->memory[addr]);
+}
+
+/**
+ * @brief Read the bytes of every lane at an effective address
+ */
+static inline __m256i _lanes_load(const lockstep_group_t* group, const lane_address_t* ea){
+    alignas(32) uint8_t value[Z6502_LOCKSTEP_LANES];
+
+    if(Z6502_LIKELY(ea->uniform != FALSE)){
+        return _lanes_row(group, ea->addr[0]);
+    }
+    for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+        value[lane] = group->memory[ea->addr[lane]][lane];
+    }
+    return _lanes_get(value);
+}
+
+/**
+ * @brief Write the bytes of every lane at an effective address. Inactive
+ * lanes are written too, their memory is no longer used.
+ */
+static inline void _lanes_store(lockstep_group_t* group, const lane_address_t* ea, __m256i value){
+    alignas(32) uint8_t bytes[Z6502_LOCKSTEP_LANES];
+
+    if(Z6502_LIKELY(ea->uniform != FALSE)){
+        _mm256_store_si256((__m256i*)group->memory[ea->addr[0]], value);
+        return;
+    }
+    _lanes_set(bytes, value);
+    for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+        group->memory[ea->addr[lane]][lane] = bytes[lane];
+    }
+}
+
+/**
+ * @brief Address made of a low and a high byte per lane, plus an index
+ */
+static inline void _lanes_pointer(const lockstep_group_t* group, __m256i lo, __m256i hi, __m256i index, lane_address_t* ea){
+    alignas(32) uint8_t lo_bytes[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t hi_bytes[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t index_bytes[Z6502_LOCKSTEP_LANES];
+
+    _lanes_set(lo_bytes, lo);
+    _lanes_set(hi_bytes, hi);
+    _lanes_set(index_bytes, index);
+    ea->uniform = ((_lanes_differ(group, lo) | _lanes_differ(group, hi) | _lanes_differ(group, index)) == 0U) ? TRUE : FALSE;
+    if(ea->uniform != FALSE){
+        ea->addr[0] = (uint16_t)(((hi_bytes[group->lead] << 8) | lo_bytes[group->lead]) + index_bytes[group->lead]);
+        return;
+    }
+    for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+        ea->addr[lane] = (uint16_t)(((hi_bytes[lane] << 8) | lo_bytes[lane]) + index_bytes[lane]);
+    }
+}
+
+/**
+ * @brief Effective address in every lane, see _address()
+ */
+template<addressing_mode_t MODE>
+static inline void _lanes_address(const lockstep_group_t* group, uint16_t operand, lane_address_t* ea){
+    if constexpr (MODE == ZP || MODE == ABS){
+        ea->uniform = TRUE;
+        ea->addr[0] = operand;
+    }
+    else if constexpr (MODE == ZPX || MODE == ZPY || MODE == ABX || MODE == ABY){
+        const uint8_t* index = (MODE == ZPX || MODE == ABX) ? group->reg.x : group->reg.y;
+        /*Zero page modes wrap in zero page*/
+        const uint16_t wrap = (MODE == ZPX || MODE == ZPY) ? 0xFFU : 0xFFFFU;
+
+        ea->uniform = (_lanes_differ(group, _lanes_get(index)) == 0U) ? TRUE : FALSE;
+        if(ea->uniform != FALSE){
+            ea->addr[0] = (operand + index[group->lead]) & wrap;
+            return;
+        }
+        for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+            ea->addr[lane] = (operand + index[lane]) & wrap;
+        }
+    }
+    else if constexpr (MODE == INX){
+        lane_address_t ptr;
+        lane_address_t ptr_hi;
+
+        _lanes_address<ZPX>(group, operand, &ptr);
+        ptr_hi.uniform = ptr.uniform;
+        if(ptr.uniform != FALSE){
+            ptr_hi.addr[0] = (ptr.addr[0] + 1U) % 256;
+        }
+        else{
+            for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+                ptr_hi.addr[lane] = (ptr.addr[lane] + 1U) % 256;
+            }
+        }
+        _lanes_pointer(group, _lanes_load(group, &ptr), _lanes_load(group, &ptr_hi), _mm256_setzero_si256(), ea);
+    }
+    else{
+        static_assert(MODE == INY, "addressing mode has no effective address");
+        _lanes_pointer(group, _lanes_row(group, operand), _lanes_row(group, (operand + 1U) % 256), _lanes_get(group->reg.y), ea);
+    }
+}
+
+/**
+ * @brief Value designated by an operand in every lane, see _read()
+ */
+template<addressing_mode_t MODE>
+static inline __m256i _lanes_read(const lockstep_group_t* group, uint16_t operand){
+    lane_address_t ea;
+
+    if constexpr (MODE == IMM){
+        return _lanes_splat((uint8_t)operand);
+    }
+    else{
+        _lanes_address<MODE>(group, operand, &ea);
+        return _lanes_load(group, &ea);
+    }
+}
+
+/**
+ * @brief Stack slot of every lane, offset from the stack pointer
+ */
+static inline void _lanes_stack_address(const lockstep_group_t* group, unsigned int offset, lane_address_t* ea){
+    const uint8_t* sp = group->reg.stack_pointer;
+
+    ea->uniform = (_lanes_differ(group, _lanes_get(sp)) == 0U) ? TRUE : FALSE;
+    if(ea->uniform != FALSE){
+        ea->addr[0] = Z6502_STACK_BASE_ADDRESS + ((sp[group->lead] + offset) % 256);
+        return;
+    }
+    for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+        ea->addr[lane] = Z6502_STACK_BASE_ADDRESS + ((sp[lane] + offset) % 256);
+    }
+}
+
+static inline void _lanes_push(lockstep_group_t* group, __m256i value){
+    lane_address_t ea;
+
+    _lanes_stack_address(group, 0U, &ea);
+    _lanes_store(group, &ea, value);
+    _lanes_set(group->reg.stack_pointer, _mm256_sub_epi8(_lanes_get(group->reg.stack_pointer), _lanes_splat(1U)));
+}
+
+static inline __m256i _lanes_pull(lockstep_group_t* group){
+    lane_address_t ea;
+
+    _lanes_stack_address(group, 1U, &ea);
+    _lanes_set(group->reg.stack_pointer, _mm256_add_epi8(_lanes_get(group->reg.stack_pointer), _lanes_splat(1U)));
+    return _lanes_load(group, &ea);
+}
+
+//*****************************************************************************
+// Operations, same results as the scalar ones in z6502_private.h
+//*****************************************************************************
+
+static inline void _lanes_nz(lockstep_group_t* group, __m256i value){
+    _lanes_set(group->reg.zero_result, value);
+    _lanes_set(group->reg.negative_result, value);
+}
+
+static inline void _lanes_load_register(lockstep_group_t* group, uint8_t* target, __m256i value){
+    _lanes_set(target, value);
+    _lanes_nz(group, value);
+}
+
+/**
+ * @brief Add with carry, binary mode. SBC adds the inverted operand.
+ */
+static inline void _lanes_add(lockstep_group_t* group, __m256i value){
+    __m256i a = _lanes_get(group->reg.accumulator);
+    __m256i partial = _mm256_add_epi8(a, value);
+    __m256i sum = _mm256_add_epi8(partial, _lanes_get(group->reg.carry));
+    __m256i carry = _mm256_or_si256(_lanes_below(partial, a), _lanes_below(sum, partial));
+
+    _lanes_set(group->reg.overflow, _lanes_bit7(_mm256_and_si256(_mm256_xor_si256(a, sum), _mm256_xor_si256(value, sum))));
+    _lanes_set(group->reg.carry, carry);
+    _lanes_load_register(group, group->reg.accumulator, sum);
+}
+
+static inline void _lanes_compare(lockstep_group_t* group, const uint8_t* reg, __m256i value){
+    __m256i source = _lanes_get(reg);
+    _lanes_set(group->reg.carry, _mm256_xor_si256(_lanes_below(source, value), _lanes_splat(0x01U)));
+    _lanes_nz(group, _mm256_sub_epi8(source, value));
+}
+
+static inline void _lanes_bit(lockstep_group_t* group, __m256i value){
+    _lanes_set(group->reg.zero_result, _mm256_and_si256(_lanes_get(group->reg.accumulator), value));
+    _lanes_set(group->reg.negative_result, value);
+    _lanes_set(group->reg.overflow, _mm256_and_si256(_mm256_srli_epi16(value, 6), _lanes_splat(0x01U)));
+}
+
+/**
+ * @brief Shift or rotate, see _asl(), _lsr(), _rol() and _ror()
+ */
+template<instruction_id_t ID>
+static inline __m256i _lanes_shift(lockstep_group_t* group, __m256i value){
+    __m256i carry = _lanes_get(group->reg.carry);
+    __m256i result;
+
+    if constexpr (ID == OP_ASL || ID == OP_ROL){
+        result = _mm256_add_epi8(value, value);
+        if constexpr (ID == OP_ROL){
+            result = _mm256_or_si256(result, carry);
+        }
+        _lanes_set(group->reg.carry, _lanes_bit7(value));
+    }
+    else{
+        result = _lanes_shift_right(value);
+        if constexpr (ID == OP_ROR){
+            result = _mm256_or_si256(result, _mm256_slli_epi16(carry, 7));
+        }
+        _lanes_set(group->reg.carry, _mm256_and_si256(value, _lanes_splat(0x01U)));
+    }
+    _lanes_nz(group, result);
+    return result;
+}
+
+/**
+ * @brief Packed P register of every lane, see _pack_status()
+ */
+static inline __m256i _lanes_pack_status(const lockstep_group_t* group){
+    __m256i p = _mm256_and_si256(_lanes_get(group->reg.negative_result), _lanes_splat(0x80U));
+    p = _mm256_or_si256(p, _mm256_slli_epi16(_lanes_get(group->reg.overflow), 6));
+    p = _mm256_or_si256(p, _lanes_splat(0x30U));
+    p = _mm256_or_si256(p, _mm256_slli_epi16(_lanes_get(group->reg.decimal_mode), 3));
+    p = _mm256_or_si256(p, _mm256_slli_epi16(_lanes_get(group->reg.irq_disable), 2));
+    p = _mm256_or_si256(p, _mm256_and_si256(_mm256_cmpeq_epi8(_lanes_get(group->reg.zero_result), _mm256_setzero_si256()), _lanes_splat(0x02U)));
+    return _mm256_or_si256(p, _lanes_get(group->reg.carry));
+}
+
+/**
+ * @brief Unpack the P register of every lane, see _unpack_status()
+ */
+static inline void _lanes_unpack_status(lockstep_group_t* group, __m256i p){
+    __m256i one = _lanes_splat(0x01U);
+
+    _lanes_set(group->reg.negative_result, _mm256_and_si256(p, _lanes_splat(0x80U)));
+    _lanes_set(group->reg.overflow, _mm256_and_si256(_mm256_srli_epi16(p, 6), one));
+    _lanes_set(group->reg.decimal_mode, _mm256_and_si256(_mm256_srli_epi16(p, 3), one));
+    _lanes_set(group->reg.irq_disable, _mm256_and_si256(_mm256_srli_epi16(p, 2), one));
+    _lanes_set(group->reg.zero_result, _mm256_andnot_si256(_mm256_srli_epi16(p, 1), one));
+    _lanes_set(group->reg.carry, _mm256_and_si256(p, one));
+}
+
+//*****************************************************************************
+// Control flow
+//*****************************************************************************
+
+/**
+ * @brief Send lanes to another program counter
+ * @return lanes
+ */
+static inline uint32_t _lanes_leave(lockstep_group_t* group, uint32_t lanes, uint16_t pc){
+    for(uint32_t left = lanes; left != 0U; left &= left - 1U){
+        group->reg.program_counter[__builtin_ctz(left)] = pc;
+    }
+    return lanes;
+}
+
+/**
+ * @brief Relative branch. The larger side of a split stays in lockstep.
+ * @param taken Lanes taking the branch
+ * @return Lanes leaving the group
+ */
+static inline uint32_t _lanes_branch(lockstep_group_t* group, uint8_t offset, uint32_t taken){
+    uint16_t target = (uint16_t)(group->program_counter + (int8_t)offset);
+
+    taken &= group->active;
+    if(Z6502_LIKELY(taken == 0U)){
+        return 0U;
+    }
+    if(Z6502_LIKELY(taken == group->active)){
+        group->program_counter = target;
+        return 0U;
+    }
+    if(2 * __builtin_popcount(taken) < __builtin_popcount(group->active)){
+        return _lanes_leave(group, taken, target);
+    }
+    _lanes_leave(group, group->active & ~taken, group->program_counter);
+    group->program_counter = target;
+    return group->active & ~taken;
+}
+
+/**
+ * @brief Jump to an address read per lane, plus an offset. Lanes landing
+ * elsewhere than the lead lane leave the group.
+ * @return Lanes leaving the group
+ */
+static inline uint32_t _lanes_jump(lockstep_group_t* group, __m256i lo, __m256i hi, uint16_t offset){
+    alignas(32) uint8_t lo_bytes[Z6502_LOCKSTEP_LANES];
+    alignas(32) uint8_t hi_bytes[Z6502_LOCKSTEP_LANES];
+    uint32_t leaving = _lanes_differ(group, lo) | _lanes_differ(group, hi);
+
+    _lanes_set(lo_bytes, lo);
+    _lanes_set(hi_bytes, hi);
+    for(uint32_t left = leaving; left != 0U; left &= left - 1U){
+        unsigned int lane = __builtin_ctz(left);
+        group->reg.program_counter[lane] = (uint16_t)(((hi_bytes[lane] << 8) | lo_bytes[lane]) + offset);
+    }
+    group->program_counter = (uint16_t)(((hi_bytes[group->lead] << 8) | lo_bytes[group->lead]) + offset);
+    return leaving;
+}
+
+//*****************************************************************************
+// Lane by lane execution
+//*****************************************************************************
+
+/**
+ * @brief Execute an instruction with its scalar handler on each active lane
+ * @return Lanes leaving the group
+ */
+template<uint8_t OPCODE>
+static uint32_t _lanes_scalar(lockstep_group_t* group, uint16_t operand){
+    register_set_soa_t* soa = &group->reg;
+    cpu_state_t reg;
+
+    for(uint32_t left = group->active; left != 0U; left &= left - 1U){
+        unsigned int lane = __builtin_ctz(left);
+        reg.program_counter = group->program_counter;
+        reg.stack_pointer = soa->stack_pointer[lane];
+        reg.accumulator = soa->accumulator[lane];
+        reg.x = soa->x[lane];
+        reg.y = soa->y[lane];
+        reg.processor_status.carry = soa->carry[lane];
+        reg.processor_status.irq_disable = soa->irq_disable[lane];
+        reg.processor_status.decimal_mode = soa->decimal_mode[lane];
+        reg.processor_status.overflow = soa->overflow[lane];
+        reg.processor_status.zero_result = soa->zero_result[lane];
+        reg.processor_status.negative_result = soa->negative_result[lane];
+
+        _execute_decoded<OPCODE>(&group->lane_memory[lane], &reg, operand);
+
+        soa->program_counter[lane] = reg.program_counter;
+        soa->stack_pointer[lane] = (uint8_t)reg.stack_pointer;
+        soa->accumulator[lane] = reg.accumulator;
+        soa->x[lane] = reg.x;
+        soa->y[lane] = reg.y;
+        soa->carry[lane] = reg.processor_status.carry;
+        soa->irq_disable[lane] = reg.processor_status.irq_disable;
+        soa->decimal_mode[lane] = reg.processor_status.decimal_mode;
+        soa->overflow[lane] = reg.processor_status.overflow;
+        soa->zero_result[lane] = reg.processor_status.zero_result;
+        soa->negative_result[lane] = reg.processor_status.negative_result;
+    }
+
+    /*Lanes may have jumped through their own vectors*/
+    uint32_t leaving = 0U;
+    group->program_counter = soa->program_counter[group->lead];
+    for(uint32_t left = group->active; left != 0U; left &= left - 1U){
+        unsigned int lane = __builtin_ctz(left);
+        if(soa->program_counter[lane] != group->program_counter){
+            leaving |= 1U << lane;
+        }
+    }
+    return leaving;
+}
+
+//*****************************************************************************
+// Instructions
+//*****************************************************************************
+
+/**
+ * @brief Execute one instruction on all active lanes. Program counter
+ * points after the instruction.
+ * @return Lanes leaving the group
+ */
+template<uint8_t OPCODE>
+static uint32_t _execute_lanes(lockstep_group_t* group, uint16_t operand){
+    constexpr instruction_id_t id = instruction_id[OPCODE];
+    constexpr addressing_mode_t mode = instruction_mode[OPCODE];
+    register_set_soa_t* reg = &group->reg;
+    lane_address_t ea;
+
+    if constexpr (id == OP_LDA || id == OP_LDX || id == OP_LDY){
+        uint8_t* target = (id == OP_LDA) ? reg->accumulator : (id == OP_LDX) ? reg->x : reg->y;
+        _lanes_load_register(group, target, _lanes_read<mode>(group, operand));
+    }
+    else if constexpr (id == OP_STA || id == OP_STX || id == OP_STY){
+        const uint8_t* source = (id == OP_STA) ? reg->accumulator : (id == OP_STX) ? reg->x : reg->y;
+        _lanes_address<mode>(group, operand, &ea);
+        _lanes_store(group, &ea, _lanes_get(source));
+    }
+    else if constexpr (id == OP_AND){
+        _lanes_load_register(group, reg->accumulator, _mm256_and_si256(_lanes_get(reg->accumulator), _lanes_read<mode>(group, operand)));
+    }
+    else if constexpr (id == OP_ORA){
+        _lanes_load_register(group, reg->accumulator, _mm256_or_si256(_lanes_get(reg->accumulator), _lanes_read<mode>(group, operand)));
+    }
+    else if constexpr (id == OP_EOR){
+        _lanes_load_register(group, reg->accumulator, _mm256_xor_si256(_lanes_get(reg->accumulator), _lanes_read<mode>(group, operand)));
+    }
+    else if constexpr (id == OP_ADC || id == OP_SBC){
+        /*Decimal mode runs on the scalar handlers*/
+        if((_lanes_equal(_lanes_get(reg->decimal_mode), 0U) & group->active) != group->active){
+            return _lanes_scalar<OPCODE>(group, operand);
+        }
+        __m256i value = _lanes_read<mode>(group, operand);
+        if constexpr (id == OP_ADC){
+            _lanes_add(group, value);
+        }
+        else{
+            _lanes_add(group, _mm256_xor_si256(value, _lanes_splat(0xFFU)));
+        }
+    }
+    else if constexpr (id == OP_CMP || id == OP_CPX || id == OP_CPY){
+        const uint8_t* source = (id == OP_CMP) ? reg->accumulator : (id == OP_CPX) ? reg->x : reg->y;
+        _lanes_compare(group, source, _lanes_read<mode>(group, operand));
+    }
+    else if constexpr (id == OP_BIT){
+        _lanes_bit(group, _lanes_read<mode>(group, operand));
+    }
+    else if constexpr (id == OP_ASL || id == OP_LSR || id == OP_ROL || id == OP_ROR){
+        if constexpr (mode == ACC){
+            _lanes_set(reg->accumulator, _lanes_shift<id>(group, _lanes_get(reg->accumulator)));
+        }
+        else{
+            _lanes_address<mode>(group, operand, &ea);
+            _lanes_store(group, &ea, _lanes_shift<id>(group, _lanes_load(group, &ea)));
+        }
+    }
+    else if constexpr (id == OP_INC || id == OP_DEC){
+        __m256i value;
+        _lanes_address<mode>(group, operand, &ea);
+        value = _mm256_add_epi8(_lanes_load(group, &ea), _lanes_splat((id == OP_INC) ? 0x01U : 0xFFU));
+        _lanes_store(group, &ea, value);
+        _lanes_nz(group, value);
+    }
+    else if constexpr (id == OP_INX || id == OP_INY || id == OP_DEX || id == OP_DEY){
+        uint8_t* target = (id == OP_INX || id == OP_DEX) ? reg->x : reg->y;
+        _lanes_load_register(group, target, _mm256_add_epi8(_lanes_get(target), _lanes_splat((id == OP_INX || id == OP_INY) ? 0x01U : 0xFFU)));
+    }
+    else if constexpr (id == OP_TAX || id == OP_TAY || id == OP_TSX || id == OP_TXA || id == OP_TYA){
+        const uint8_t* source = (id == OP_TAX || id == OP_TAY) ? reg->accumulator : (id == OP_TSX) ? reg->stack_pointer :
+                                (id == OP_TXA) ? reg->x : reg->y;
+        uint8_t* target = (id == OP_TAX || id == OP_TSX) ? reg->x : (id == OP_TAY) ? reg->y : reg->accumulator;
+        _lanes_load_register(group, target, _lanes_get(source));
+    }
+    else if constexpr (id == OP_TXS){
+        _lanes_set(reg->stack_pointer, _lanes_get(reg->x));
+    }
+    else if constexpr (id == OP_CLC || id == OP_SEC){
+        _lanes_set(reg->carry, _lanes_splat((id == OP_SEC) ? 1U : 0U));
+    }
+    else if constexpr (id == OP_CLD || id == OP_SED){
+        _lanes_set(reg->decimal_mode, _lanes_splat((id == OP_SED) ? 1U : 0U));
+    }
+    else if constexpr (id == OP_CLI || id == OP_SEI){
+        _lanes_set(reg->irq_disable, _lanes_splat((id == OP_SEI) ? 1U : 0U));
+    }
+    else if constexpr (id == OP_CLV){
+        _lanes_set(reg->overflow, _mm256_setzero_si256());
+    }
+    else if constexpr (id == OP_BCC || id == OP_BCS){
+        uint32_t clear = _lanes_equal(_lanes_get(reg->carry), 0U);
+        return _lanes_branch(group, operand, (id == OP_BCC) ? clear : ~clear);
+    }
+    else if constexpr (id == OP_BEQ || id == OP_BNE){
+        uint32_t zero = _lanes_equal(_lanes_get(reg->zero_result), 0U);
+        return _lanes_branch(group, operand, (id == OP_BEQ) ? zero : ~zero);
+    }
+    else if constexpr (id == OP_BMI || id == OP_BPL){
+        uint32_t negative = (uint32_t)_mm256_movemask_epi8(_lanes_get(reg->negative_result));
+        return _lanes_branch(group, operand, (id == OP_BMI) ? negative : ~negative);
+    }
+    else if constexpr (id == OP_BVC || id == OP_BVS){
+        uint32_t clear = _lanes_equal(_lanes_get(reg->overflow), 0U);
+        return _lanes_branch(group, operand, (id == OP_BVC) ? clear : ~clear);
+    }
+    else if constexpr (id == OP_JMP && mode == ABS){
+        group->program_counter = operand;
+    }
+    else if constexpr (id == OP_JMP){
+        return _lanes_jump(group, _lanes_row(group, operand), _lanes_row(group, (uint16_t)(operand + 1U)), 0U);
+    }
+    else if constexpr (id == OP_JSR){
+        /*Return address is the last byte of the instruction*/
+        uint16_t ret = (uint16_t)(group->program_counter - 1U);
+        _lanes_push(group, _lanes_splat((uint8_t)(ret >> 8)));
+        _lanes_push(group, _lanes_splat((uint8_t)ret));
+        group->program_counter = operand;
+    }
+    else if constexpr (id == OP_RTS || id == OP_RTI){
+        if constexpr (id == OP_RTI){
+            _lanes_unpack_status(group, _lanes_pull(group));
+        }
+        __m256i lo = _lanes_pull(group);
+        __m256i hi = _lanes_pull(group);
+        return _lanes_jump(group, lo, hi, (id == OP_RTS) ? 1U : 0U);
+    }
+    else if constexpr (id == OP_PHA){
+        _lanes_push(group, _lanes_get(reg->accumulator));
+    }
+    else if constexpr (id == OP_PHP){
+        _lanes_push(group, _lanes_pack_status(group));
+    }
+    else if constexpr (id == OP_PLA){
+        _lanes_load_register(group, reg->accumulator, _lanes_pull(group));
+    }
+    else if constexpr (id == OP_PLP){
+        _lanes_unpack_status(group, _lanes_pull(group));
+    }
+    else if constexpr (id == OP_NOP){
+    }
+    else{
+        return _lanes_scalar<OPCODE>(group, operand);
+    }
+    return 0U;
+}
+
+/**
+ * @brief Build the lockstep handler table from instruction_id[] at compile time
+ * @return One specialized handler per opcode, NULL for undefined opcodes
+ */
+template<std::size_t... OPCODES>
+static constexpr std::array<lockstep_handler_t, 256> _make_lockstep_set(std::index_sequence<OPCODES...>){
+    return {{ (instruction_id[OPCODES] != OP___ ? &_execute_lanes<OPCODES> : (lockstep_handler_t)NULL)... }};
+}
+
+static constexpr std::array<lockstep_handler_t, 256> lockstep_instruction_set = _make_lockstep_set(std::make_index_sequence<256>());
+
+//*****************************************************************************
+// Run loop
+//*****************************************************************************
+
+void _lockstep_attach(lockstep_group_t* group){
+    for(unsigned int lane = 0U; lane < Z6502_LOCKSTEP_LANES; lane++){
+        memory_t* mem = &group->lane_memory[lane];
+        group->lane_device[lane].read = _lane_device_read;
+        group->lane_device[lane].write = _lane_device_write;
+        group->lane_device[lane].context = &group->memory[0][lane];
+        for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+            mem->read_page[page] = NULL;
+            mem->write_page[page] = NULL;
+            mem->page_map[page].base = NULL;
+            mem->page_map[page].device = &group->lane_device[lane];
+            mem->page_map[page].read_only = FALSE;
+            mem->code_page[page] = FALSE;
+            mem->shared[page] = NULL;
+        }
+        mem->decoded = NULL;
+        mem->jit = NULL;
+        mem->owned = NULL;
+        mem->replay = NULL;
+        mem->replaying = FALSE;
+        mem->debug = NULL;
+    }
+}
+
+uint32_t _lockstep_run(lockstep_group_t* group, uint64_t cycle_budget, uint64_t* spent){
+    uint32_t leaving = 0U;
+    uint16_t pc;
+    uint8_t opcode;
+    uint8_t length;
+    uint16_t operand;
+
+    while(*spent < cycle_budget && leaving == 0U){
+        /*Lanes whose code differs from the lead lane leave before executing it*/
+        pc = group->program_counter;
+        opcode = group->memory[pc][group->lead];
+        length = 1U + _operand_length(instruction_mode[opcode]);
+        for(uint8_t i = 0U; i < length; i++){
+            leaving |= _lanes_differ(group, _lanes_row(group, (uint16_t)(pc + i)));
+        }
+        if(leaving != 0U){
+            _lanes_leave(group, leaving, pc);
+            break;
+        }
+
+        if(lockstep_instruction_set[opcode] == NULL){
+            /*Unhandled opcode, stay on it*/
+            group->halted = TRUE;
+            break;
+        }
+        operand = (length == 1U) ? 0U :
+                  (length == 2U) ? group->memory[(uint16_t)(pc + 1U)][group->lead] :
+                  (group->memory[(uint16_t)(pc + 1U)][group->lead] | (group->memory[(uint16_t)(pc + 2U)][group->lead] << 8));
+
+        group->program_counter = pc + length;
+        leaving = lockstep_instruction_set[opcode](group, operand);
+        *spent += instruction_cycles[opcode];
+    }
+
+    group->active &= ~leaving;
+    if(group->active != 0U){
+        group->lead = __builtin_ctz(group->active);
+    }
+    return leaving;
+}
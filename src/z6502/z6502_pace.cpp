@@ -0,0 +1,156 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "z6502.h"
+#include "z6502_pace.h"
+
+/*Spin margin bounds and its starting value*/
+#define PACE_MIN_SPIN_NS 20000
+#define PACE_MAX_SPIN_NS 2000000
+#define PACE_INITIAL_SPIN_NS 100000
+
+static inline int64_t _now_ns(void){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Z6502Pacer::Z6502Pacer(){
+    _cpu = NULL;
+    _frequency = 0U;
+    _slice_cycles = 0U;
+    _stopping.store(FALSE);
+    _spin_ns = PACE_INITIAL_SPIN_NS;
+    memset(&_stats, 0, sizeof(_stats));
+    _waits = 0U;
+    _jitter_total_ns = 0U;
+}
+
+int Z6502Pacer::attach(Z6502* cpu, uint64_t frequency, uint32_t slice_microseconds){
+    uint64_t slice_cycles = frequency / 1000000U * slice_microseconds + frequency % 1000000U * slice_microseconds / 1000000U;
+
+    if(frequency == 0U || slice_cycles == 0U){
+        return -1;
+    }
+    _cpu = cpu;
+    _frequency = frequency;
+    _slice_cycles = slice_cycles;
+    memset(&_stats, 0, sizeof(_stats));
+    _waits = 0U;
+    _jitter_total_ns = 0U;
+    return 0;
+}
+
+int64_t Z6502Pacer::_cycles_to_ns(uint64_t cycles){
+    return (int64_t)(cycles / _frequency * 1000000000U + cycles % _frequency * 1000000000U / _frequency);
+}
+
+int64_t Z6502Pacer::_wait_until(int64_t deadline){
+    int64_t now = _now_ns();
+    int64_t wake;
+
+    /*Sleep most of the way, then learn how late this host wakes up*/
+    if(deadline - now > _spin_ns){
+        wake = deadline - _spin_ns;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wake - now));
+        now = _now_ns();
+        _spin_ns += ((now - wake) * 2 - _spin_ns) / 8;
+        if(_spin_ns < PACE_MIN_SPIN_NS){
+            _spin_ns = PACE_MIN_SPIN_NS;
+        }
+        else if(_spin_ns > PACE_MAX_SPIN_NS){
+            _spin_ns = PACE_MAX_SPIN_NS;
+        }
+    }
+    while(now < deadline){
+        now = _now_ns();
+    }
+    return now;
+}
+
+uint64_t Z6502Pacer::run(uint64_t cycle_budget){
+    int64_t start;
+    int64_t epoch;
+    int64_t now;
+    int64_t deadline;
+    uint64_t first;
+    uint64_t base;
+    uint64_t budget;
+    uint64_t spent;
+    uint64_t cycles;
+
+    if(_cpu == NULL){
+        return 0U;
+    }
+    start = _now_ns();
+    epoch = start;
+    now = start;
+    first = _cpu->get_cycles();
+    base = first;
+    _stopping.store(FALSE, std::memory_order_relaxed);
+    while(_stopping.load(std::memory_order_relaxed) == FALSE){
+        cycles = _cpu->get_cycles();
+        if(cycles - first >= cycle_budget){
+            break;
+        }
+        budget = cycle_budget - (cycles - first);
+        budget = (budget < _slice_cycles) ? budget : _slice_cycles;
+        spent = _cpu->run(budget);
+        _stats.slices++;
+
+        /*Where the slice should have ended*/
+        deadline = epoch + _cycles_to_ns(_cpu->get_cycles() - base);
+        now = _now_ns();
+        if(now > deadline){
+            _stats.overruns++;
+            if(now - deadline > (int64_t)Z6502_PACE_MAX_LAG_MICROSECONDS * 1000){
+                epoch = now;
+                base = _cpu->get_cycles();
+                _stats.resyncs++;
+            }
+        }
+        else{
+            now = _wait_until(deadline);
+            _waits++;
+            _jitter_total_ns += now - deadline;
+            if((uint64_t)(now - deadline) > _stats.jitter_max_ns){
+                _stats.jitter_max_ns = now - deadline;
+            }
+        }
+
+        /*Halted, breakpoint or stop()*/
+        if(spent < budget){
+            break;
+        }
+    }
+
+    spent = _cpu->get_cycles() - first;
+    _stats.cycles += spent;
+    _stats.seconds += (now - start) / 1e9;
+    _stats.achieved_frequency = (_stats.seconds > 0.0) ? _stats.cycles / _stats.seconds : 0.0;
+    _stats.drift_ns = now - (epoch + _cycles_to_ns(_cpu->get_cycles() - base));
+    _stats.jitter_mean_ns = (_waits > 0U) ? _jitter_total_ns / _waits : 0U;
+    return spent;
+}
+
+void Z6502Pacer::print_summary(FILE* out){
+    fprintf(out, "%llu cycles in %.3f s, %.0f Hz for %llu Hz (%.3f%%)\n",
+            (unsigned long long)_stats.cycles, _stats.seconds, _stats.achieved_frequency, (unsigned long long)_frequency,
+            (_frequency > 0U) ? (_stats.achieved_frequency - _frequency) * 100.0 / _frequency : 0.0);
+    fprintf(out, "%llu slices, %llu overruns, %llu resyncs, drift %lld us\n",
+            (unsigned long long)_stats.slices, (unsigned long long)_stats.overruns,
+            (unsigned long long)_stats.resyncs, (long long)(_stats.drift_ns / 1000));
+    fprintf(out, "wake up jitter: mean %.1f us, max %.1f us\n", _stats.jitter_mean_ns / 1e3, _stats.jitter_max_ns / 1e3);
+}
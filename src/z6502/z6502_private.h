@@ -0,0 +1,1357 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Helpers shared by the interpreter cores. Everything here is static inline
+    so that each core gets its own copy and the compiler can keep the register
+    set in host registers.
+*/
+
+#ifndef Z6502_PRIVATE_H_INCLUDED
+#define Z6502_PRIVATE_H_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include "z6502.h"
+
+/*Memory accessors and addressing modes are used by every handler and must
+  stay inlined even in the large switch core*/
+#if defined(__GNUC__)
+#define Z6502_ALWAYS_INLINE inline __attribute__((always_inline))
+#define Z6502_LIKELY(x) __builtin_expect(!!(x), 1)
+#define Z6502_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define Z6502_ALWAYS_INLINE inline
+#define Z6502_LIKELY(x) (x)
+#define Z6502_UNLIKELY(x) (x)
+#endif
+
+/*Core used by run() unless changed with set_core()*/
+#if defined(Z6502_DISPATCH_SWITCH)
+#define Z6502_DEFAULT_CORE CORE_SWITCH
+#elif defined(Z6502_DISPATCH_CACHE)
+#define Z6502_DEFAULT_CORE CORE_CACHE
+#elif defined(Z6502_DISPATCH_JIT)
+#define Z6502_DEFAULT_CORE CORE_JIT
+#else
+#define Z6502_DEFAULT_CORE CORE_TABLE
+#endif
+
+//*****************************************************************************
+// Memory access
+//*****************************************************************************
+
+/**
+ * @brief Drop predecoded instructions depending on a page (see z6502_cache.cpp)
+ * @param mem Pointer to memory space
+ * @param page Page that was written to
+ */
+void _invalidate_code_page(memory_t* mem, uint8_t page);
+
+/**
+ * @brief Drop translated blocks depending on a page (see z6502_jit.cpp)
+ * @param jit Translation state
+ * @param page Page that was written to
+ */
+void _jit_invalidate_page(struct jit_s* jit, uint8_t page);
+
+/**
+ * @brief Translate the block at an address ahead of run() (see z6502_jit.cpp)
+ * @param mem Pointer to memory space, its translation state is created if needed
+ * @param address Block address
+ * @returns 1 if translated, 0 if already translated or not translatable,
+ *          -1 if this host has no translator or no executable memory
+ */
+int _jit_prewarm(memory_t* mem, uint16_t address);
+
+/**
+ * @brief Drop all translated blocks
+ * @param jit Translation state, may be NULL
+ */
+void _jit_flush(struct jit_s* jit);
+
+/**
+ * @brief Drop translated blocks holding direct pointers into a remapped page
+ * @param jit Translation state
+ * @param page Page whose mapping changed
+ */
+void _jit_unmap_page(struct jit_s* jit, uint8_t page);
+
+/**
+ * @brief Release translation state and its code arena
+ * @param jit Translation state, may be NULL
+ */
+void _jit_free(struct jit_s* jit);
+
+struct lockstep_group_s;
+
+/**
+ * @brief Point the per lane memory views of a lockstep group at its
+ * interleaved memory (see z6502_lockstep_avx2.cpp)
+ * @param group Lockstep group
+ */
+void _lockstep_attach(struct lockstep_group_s* group);
+
+/**
+ * @brief Run the active lanes of a lockstep group with AVX2 until the budget
+ * is spent, the group halts or lanes leave it (see z6502_lockstep_avx2.cpp)
+ * @param group Lockstep group
+ * @param cycle_budget Number of clock cycles to execute
+ * @param spent Cycles already spent in this run, updated
+ * @return Lanes that left the group, 0 if none
+ */
+uint32_t _lockstep_run(struct lockstep_group_s* group, uint64_t cycle_budget, uint64_t* spent);
+
+/*Memory page saved by a snapshot, shared by snapshots and instances until
+  they write to it*/
+typedef struct snapshot_page_s
+{
+    std::atomic<uint32_t> refs;
+    uint8_t data[Z6502_PAGE_SIZE_BYTES];
+} snapshot_page_t;
+
+/**
+ * @brief Drop a reference to a snapshot page, freeing it with the last one
+ * (see z6502_snapshot.cpp)
+ * @param page Snapshot page, may be NULL
+ */
+void _release_snapshot_page(snapshot_page_t* page);
+
+/**
+ * @brief Stop sharing a page with snapshots before it is written. A page
+ * without memory of its own is copied to the instance first.
+ * (see z6502_snapshot.cpp)
+ * @param mem Pointer to memory space
+ * @param page Page number
+ * @returns 0 on success, -1 if out of memory
+ */
+int _unshare_page(memory_t* mem, uint8_t page);
+
+/**
+ * @brief Refresh the direct pointers of a page after its mapping or backing
+ * changed (see z6502_bus.cpp)
+ * @param mem Pointer to memory space
+ * @param page Page number
+ */
+void _remap_page(memory_t* mem, uint8_t page);
+
+/*Interrupt taken while recording*/
+typedef struct
+{
+    uint64_t cycles;            /* Cycle count the interrupt was taken at */
+    uint16_t vector;            /* Z6502_IRQ_VECTOR_ADDRESS or Z6502_NMI_VECTOR_ADDRESS */
+} replay_interrupt_t;
+
+/*Non-deterministic inputs of a recorded run, see Z6502Replay*/
+struct replay_s
+{
+    std::vector<uint8_t> read;                  /* Values returned by device reads, in order */
+    std::vector<replay_interrupt_t> interrupt;  /* Interrupts taken, in order */
+    size_t next_read;                           /* Next value served to the replaying instance */
+};
+
+/**
+ * @brief Device read while recording or replaying: log the value the device
+ * returns, or serve the logged one (see z6502_replay.cpp)
+ * @param mem Pointer to memory space
+ * @param device Device mapped at addr
+ * @param addr Address
+ * @return Value
+ */
+uint8_t _replay_read(memory_t* mem, const device_t* device, uint16_t addr);
+
+/**
+ * @brief Log an interrupt taken while recording (see z6502_replay.cpp)
+ * @param replay Log
+ * @param cycles Cycle count the interrupt is taken at
+ * @param vector Interrupt vector
+ */
+void _replay_log_interrupt(struct replay_s* replay, uint64_t cycles, uint16_t vector);
+
+/*Breakpoint condition set at an address*/
+typedef struct
+{
+    uint16_t address;
+    breakpoint_condition_t condition;
+} debug_condition_t;
+
+/*Breakpoints and watchpoints of a Z6502, one bit per address*/
+struct debug_s
+{
+    uint8_t execute[Z6502_MAX_MEMORY_SIZE_BYTES / 8U];
+    uint8_t read[Z6502_MAX_MEMORY_SIZE_BYTES / 8U];
+    uint8_t write[Z6502_MAX_MEMORY_SIZE_BYTES / 8U];
+    uint16_t read_count[Z6502_PAGE_COUNT];      /* Addresses watched for reads per page */
+    uint16_t write_count[Z6502_PAGE_COUNT];     /* Addresses watched for writes per page */
+    uint32_t breakpoint_count;
+    std::vector<debug_condition_t> condition;   /* Conditional breakpoints */
+    uint16_t program_counter;                   /* Instruction being executed */
+    uint8_t fetching;                           /* Instruction bytes are being read */
+    break_info_t hit;                           /* First watchpoint hit by the instruction */
+    uint16_t resume_address;                    /* Breakpoint passed over when resuming... */
+    uint64_t resume_cycles;                     /* ...at this cycle count */
+};
+
+/**
+ * @brief Address is set in a bitmap of one bit per address
+ * @param bitmap Bitmap
+ * @param addr Address
+ */
+static inline uint8_t _bitmap_test(const uint8_t* bitmap, uint16_t addr){
+    return (bitmap[addr >> 3] >> (addr & 7U)) & 1U;
+}
+
+/**
+ * @brief Memory access on the slow path while breakpoints or watchpoints
+ * are set: record the first watchpoint hit (see z6502_debug.cpp)
+ * @param mem Pointer to memory space
+ * @param addr Address
+ * @param value Value read or written
+ * @param kind BREAK_READ or BREAK_WRITE
+ */
+void _debug_access(memory_t* mem, uint16_t addr, uint8_t value, break_kind_t kind);
+
+/**
+ * @brief Read a byte from a page without direct pointer (see z6502_bus.cpp)
+ * @param mem Pointer to memory space
+ * @param addr Address
+ * @return Value
+ */
+uint8_t _bus_read(memory_t* mem, uint16_t addr);
+
+/**
+ * @brief Write a byte to a page without direct pointer (see z6502_bus.cpp)
+ * @param mem Pointer to memory space
+ * @param addr Address
+ * @param value Value
+ */
+void _bus_write(memory_t* mem, uint16_t addr, uint8_t value);
+
+/**
+ * @brief Read a byte from memory
+ * @param mem Pointer to memory space
+ * @param addr Address
+ * @return Value
+ */
+static Z6502_ALWAYS_INLINE uint8_t _mem_read(memory_t* mem, uint16_t addr){
+    uint8_t* page = mem->read_page[addr >> 8];
+    if(Z6502_LIKELY(page != NULL)){
+        return page[addr & 0xFFU];
+    }
+    return _bus_read(mem, addr);
+}
+
+/**
+ * @brief Write a byte to memory. ROM, devices and pages holding predecoded
+ * instructions have no direct write pointer and take the slow path.
+ * @param mem Pointer to memory space
+ * @param addr Address
+ * @param value Value
+ */
+static Z6502_ALWAYS_INLINE void _mem_write(memory_t* mem, uint16_t addr, uint8_t value){
+    uint8_t* page = mem->write_page[addr >> 8];
+    if(Z6502_LIKELY(page != NULL)){
+        page[addr & 0xFFU] = value;
+    }
+    else{
+        _bus_write(mem, addr, value);
+    }
+}
+
+/**
+ * @brief Page can be read with a direct load. Pages watched for reads take
+ * the slow path.
+ * @param mem Pointer to memory space
+ * @param page Page number
+ */
+static inline uint8_t _page_readable(memory_t* mem, uint8_t page){
+    return mem->page_map[page].base != NULL && (mem->debug == NULL || mem->debug->read_count[page] == 0U);
+}
+
+/**
+ * @brief Page can be written with a direct store. Pages shared with a
+ * snapshot take the slow path until their first write, pages watched for
+ * writes always do.
+ * @param mem Pointer to memory space
+ * @param page Page number
+ */
+static inline uint8_t _page_writable(memory_t* mem, uint8_t page){
+    return mem->page_map[page].base != NULL && mem->page_map[page].read_only == FALSE && mem->shared[page] == NULL &&
+           (mem->debug == NULL || mem->debug->write_count[page] == 0U);
+}
+
+/**
+ * @brief Send stores to a page through the slow path so that they drop the
+ * predecoded instructions and translated blocks made from it
+ * @param mem Pointer to memory space
+ * @param page Page number
+ */
+static inline void _watch_code_page(memory_t* mem, uint8_t page){
+    mem->code_page[page] = TRUE;
+    mem->write_page[page] = NULL;
+}
+
+/**
+ * @brief Stop watching a page, restoring its direct write pointer
+ * @param mem Pointer to memory space
+ * @param page Page number
+ */
+static inline void _unwatch_code_page(memory_t* mem, uint8_t page){
+    mem->code_page[page] = FALSE;
+    mem->write_page[page] = _page_writable(mem, page) ? mem->page_map[page].base : NULL;
+}
+
+//*****************************************************************************
+// Addressing modes
+//*****************************************************************************
+
+/**
+ * @brief Number of operand bytes following the opcode
+ * @param mode Addressing mode
+ */
+static constexpr uint8_t _operand_length(addressing_mode_t mode){
+    return (mode == ABS || mode == ABX || mode == ABY || mode == IND) ? 2U :
+           (mode == ___ || mode == IMP || mode == ACC) ? 0U : 1U;
+}
+
+/**
+ * @brief Fetch raw operand bytes at program counter
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @return Operand (8 bit value, zero page address, branch offset or 16 bit address)
+ */
+template<addressing_mode_t MODE>
+static Z6502_ALWAYS_INLINE uint16_t _fetch_operand(memory_t* mem, cpu_state_t* reg){
+    uint16_t operand = 0U;
+    if constexpr (_operand_length(MODE) == 1U){
+        operand = _mem_read(mem, reg->program_counter);
+    }
+    else if constexpr (_operand_length(MODE) == 2U){
+        operand = _mem_read(mem, reg->program_counter) |
+                  (_mem_read(mem, (uint16_t)(reg->program_counter + 1U)) << 8);
+    }
+    reg->program_counter += _operand_length(MODE);
+    return operand;
+}
+
+/**
+ * @brief Effective address for a statically known addressing mode
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @param operand Raw operand
+ * @return Operand address
+ */
+template<addressing_mode_t MODE>
+static Z6502_ALWAYS_INLINE uint16_t _address(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    static_assert(MODE != ___ && MODE != IMP && MODE != ACC && MODE != IMM && MODE != REL,
+                  "addressing mode has no effective address");
+    if constexpr (MODE == ZP || MODE == ABS){
+        return operand;
+    }
+    else if constexpr (MODE == ZPX){
+        /*Wraps in zero page*/
+        return (operand + reg->x) % 256;
+    }
+    else if constexpr (MODE == ZPY){
+        /*Wraps in zero page*/
+        return (operand + reg->y) % 256;
+    }
+    else if constexpr (MODE == ABX){
+        return (uint16_t)(operand + reg->x);
+    }
+    else if constexpr (MODE == ABY){
+        return (uint16_t)(operand + reg->y);
+    }
+    else if constexpr (MODE == IND){
+        /*JMP only*/
+        return _mem_read(mem, operand) | (_mem_read(mem, (uint16_t)(operand + 1U)) << 8);
+    }
+    else if constexpr (MODE == INX){
+        /*X-indexed indirect - aka (Indirect,X)*/
+        uint16_t ptr = (operand + reg->x) % 256;
+        return _mem_read(mem, ptr) | (_mem_read(mem, (ptr + 1) % 256) << 8);
+    }
+    else{
+        /*Indirect Y-indexed - aka (Indirect),Y*/
+        uint16_t base = _mem_read(mem, operand) | (_mem_read(mem, (operand + 1) % 256) << 8);
+        return (uint16_t)(base + reg->y);
+    }
+}
+
+/**
+ * @brief Read the value designated by an operand
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @param operand Raw operand
+ * @return Immediate value or value at operand address
+ */
+template<addressing_mode_t MODE>
+static Z6502_ALWAYS_INLINE uint8_t _read(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    if constexpr (MODE == IMM){
+        return (uint8_t)operand;
+    }
+    else{
+        return _mem_read(mem, _address<MODE>(mem, reg, operand));
+    }
+}
+
+//*****************************************************************************
+// Flags
+//*****************************************************************************
+
+/**
+ * @brief Update N and Z flags from a result byte. Both are evaluated lazily.
+ * @param reg Pointer to register set
+ * @param value Result byte
+ */
+static inline void _update_nz_flags(cpu_state_t* reg, uint8_t value){
+    reg->processor_status.zero_result = value;
+    reg->processor_status.negative_result = value;
+}
+
+/**
+ * @brief Materialize zero flag
+ * @param reg Pointer to register set
+ * @return 1 if set, 0 otherwise
+ */
+static inline uint8_t _zero_flag(const cpu_state_t* reg){
+    return (reg->processor_status.zero_result == 0U) ? 1U : 0U;
+}
+
+/**
+ * @brief Materialize negative flag
+ * @param reg Pointer to register set
+ * @return 1 if set, 0 otherwise
+ */
+static inline uint8_t _negative_flag(const cpu_state_t* reg){
+    return (reg->processor_status.negative_result >> 7) & 0x01;
+}
+
+/**
+ * @brief Update carry flag
+ * @param reg Pointer to register set
+ * @param value Value to check (uint16_t)
+ */
+static inline void _update_carry_flag(cpu_state_t* reg, uint16_t value){
+    reg->processor_status.carry = (value > 0xFF) ? 1U : 0U;
+}
+
+/**
+ * @brief Update overflow flag
+ * @param reg Pointer to register set
+ * @param a First operand
+ * @param b Second operand
+ * @param result Result of the operation
+ */
+static inline void _update_overflow_flag(cpu_state_t* reg, uint8_t a, uint8_t b, uint8_t result){
+    reg->processor_status.overflow = (((a ^ result) & (b ^ result) & 0x80) != 0U) ? 1U : 0U;
+}
+
+//*****************************************************************************
+// Stack
+//*****************************************************************************
+
+/**
+ * @brief Pull a byte from the stack
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @param value Pointer to store the pulled value
+ */
+static inline void _pull_stack(memory_t* mem, cpu_state_t* reg, uint8_t* value){
+    reg->stack_pointer = (reg->stack_pointer + 1U) % 256;
+    *value = _mem_read(mem, Z6502_STACK_BASE_ADDRESS + reg->stack_pointer);
+}
+
+/**
+ * @brief Push a byte onto the stack
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @param value Value to push onto the stack
+ */
+static inline void _push_stack(memory_t* mem, cpu_state_t* reg, uint8_t value){
+    _mem_write(mem, Z6502_STACK_BASE_ADDRESS + reg->stack_pointer, value);
+    reg->stack_pointer = (reg->stack_pointer - 1U) % 256;
+}
+
+/**
+ * @brief Pack processor status into the P register form
+ * @param reg Pointer to register set
+ * @return P register
+ */
+static inline uint8_t _pack_status(const cpu_state_t* reg){
+    return (uint8_t)(_negative_flag(reg) << 7 |
+                     reg->processor_status.overflow << 6 |
+                     1 << 5 |
+                     1 << 4 |
+                     reg->processor_status.decimal_mode << 3 |
+                     reg->processor_status.irq_disable << 2 |
+                     _zero_flag(reg) << 1 |
+                     reg->processor_status.carry);
+}
+
+/**
+ * @brief Unpack processor status from the P register form
+ * @param reg Pointer to register set
+ * @param p P register
+ */
+static inline void _unpack_status(cpu_state_t* reg, uint8_t p){
+    reg->processor_status.negative_result = p & 0x80;
+    reg->processor_status.overflow = (p >> 6) & 0x01;
+    reg->processor_status.decimal_mode = (p >> 3) & 0x01;
+    reg->processor_status.irq_disable = (p >> 2) & 0x01;
+    reg->processor_status.zero_result = (~p >> 1) & 0x01;
+    reg->processor_status.carry = p & 0x01;
+}
+
+/**
+ * @brief Pull processor status from the stack
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ */
+static inline void _pull_register_stack(memory_t* mem, cpu_state_t* reg){
+    uint8_t tmp;
+    _pull_stack(mem, reg, &tmp);
+    _unpack_status(reg, tmp);
+}
+
+/**
+ * @brief Push processor status onto the stack
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ */
+static inline void _push_register_stack(memory_t* mem, cpu_state_t* reg){
+    _push_stack(mem, reg, _pack_status(reg));
+}
+
+/**
+ * @brief Pull a 16 bit address from the stack (low byte first)
+ */
+static inline uint16_t _pull_address(memory_t* mem, cpu_state_t* reg){
+    uint8_t lo;
+    uint8_t hi;
+    _pull_stack(mem, reg, &lo);
+    _pull_stack(mem, reg, &hi);
+    return (uint16_t)((hi << 8) | lo);
+}
+
+/**
+ * @brief Push a 16 bit address onto the stack (high byte first)
+ */
+static inline void _push_address(memory_t* mem, cpu_state_t* reg, uint16_t addr){
+    _push_stack(mem, reg, (uint8_t)((addr >> 8) & 0x00FF));
+    _push_stack(mem, reg, (uint8_t)(addr & 0x00FF));
+}
+
+//*****************************************************************************
+// Operations
+//*****************************************************************************
+
+/**
+ * @brief Decimal mode ADC, table driven and kept out of line so that binary
+ * mode handlers stay small (see z6502_alu.cpp)
+ * @param reg Pointer to register set
+ * @param value Operand
+ */
+void _adc_decimal(cpu_state_t* reg, uint8_t value);
+
+/**
+ * @brief Decimal mode SBC (see z6502_alu.cpp)
+ * @param reg Pointer to register set
+ * @param value Operand
+ */
+void _sbc_decimal(cpu_state_t* reg, uint8_t value);
+
+/**
+ * @brief Load a register and update N/Z flags
+ */
+static inline void _load(cpu_state_t* reg, uint8_t* target, uint8_t value){
+    *target = value;
+    _update_nz_flags(reg, value);
+}
+
+/**
+ * @brief Add with carry, binary mode
+ */
+static inline void _add(cpu_state_t* reg, uint8_t value){
+    uint16_t res = reg->accumulator + value + reg->processor_status.carry;
+    _update_overflow_flag(reg, reg->accumulator, value, res);
+    _update_carry_flag(reg, res);
+    _load(reg, &reg->accumulator, (uint8_t)res);
+}
+
+/**
+ * @brief Add with carry
+ */
+static inline void _adc(cpu_state_t* reg, uint8_t value){
+    if(Z6502_UNLIKELY(reg->processor_status.decimal_mode != 0U)){
+        _adc_decimal(reg, value);
+        return;
+    }
+    _add(reg, value);
+}
+
+/**
+ * @brief Subtract with carry: A + ~value + C, carry set when nothing was borrowed
+ */
+static inline void _sbc(cpu_state_t* reg, uint8_t value){
+    if(Z6502_UNLIKELY(reg->processor_status.decimal_mode != 0U)){
+        _sbc_decimal(reg, value);
+        return;
+    }
+    _add(reg, (uint8_t)~value);
+}
+
+/**
+ * @brief Compare a register with a value (CMP, CPX, CPY)
+ */
+static inline void _compare(cpu_state_t* reg, uint8_t register_value, uint8_t value){
+    reg->processor_status.carry = (register_value >= value) ? 1U : 0U;
+    _update_nz_flags(reg, (uint8_t)(register_value - value));
+}
+
+/**
+ * @brief Bit test
+ */
+static inline void _bit(cpu_state_t* reg, uint8_t value){
+    reg->processor_status.zero_result = reg->accumulator & value;
+    reg->processor_status.negative_result = value;
+    reg->processor_status.overflow = (value >> 6) & 0x01;
+}
+
+/**
+ * @brief Arithmetic shift left
+ * @return Shifted value
+ */
+static inline uint8_t _asl(cpu_state_t* reg, uint8_t value){
+    reg->processor_status.carry = (value >> 7) & 0x01;
+    value = value << 1;
+    _update_nz_flags(reg, value);
+    return value;
+}
+
+/**
+ * @brief Logical shift right
+ * @return Shifted value
+ */
+static inline uint8_t _lsr(cpu_state_t* reg, uint8_t value){
+    reg->processor_status.carry = value & 0x01;
+    value = value >> 1;
+    _update_nz_flags(reg, value);
+    return value;
+}
+
+/**
+ * @brief Rotate left through carry
+ * @return Rotated value
+ */
+static inline uint8_t _rol(cpu_state_t* reg, uint8_t value){
+    uint8_t c = (value >> 7) & 0x01;
+    value = (value << 1) | reg->processor_status.carry;
+    reg->processor_status.carry = c;
+    _update_nz_flags(reg, value);
+    return value;
+}
+
+/**
+ * @brief Rotate right through carry
+ * @return Rotated value
+ */
+static inline uint8_t _ror(cpu_state_t* reg, uint8_t value){
+    uint8_t c = value & 0x01;
+    value = (value >> 1) | (reg->processor_status.carry << 7);
+    reg->processor_status.carry = c;
+    _update_nz_flags(reg, value);
+    return value;
+}
+
+/**
+ * @brief Relative branch. Program counter points after the instruction.
+ * @param offset Branch offset
+ * @param cond Branch taken if not zero
+ */
+static inline void _branch(cpu_state_t* reg, uint8_t offset, uint8_t cond){
+    if(cond != 0U){
+        reg->program_counter = (uint16_t)(reg->program_counter + (int8_t)offset);
+    }
+}
+
+/**
+ * @brief Software interrupt. Program counter points after the opcode.
+ */
+static inline void _brk(memory_t* mem, cpu_state_t* reg){
+    /*BRK has a padding byte, return after it*/
+    _push_address(mem, reg, (uint16_t)(reg->program_counter + 1U));
+    _push_register_stack(mem, reg);
+    reg->processor_status.irq_disable = 1U;
+    reg->program_counter = _mem_read(mem, Z6502_IRQ_VECTOR_ADDRESS) |
+                           (_mem_read(mem, Z6502_IRQ_VECTOR_ADDRESS + 1U) << 8);
+}
+
+/**
+ * @brief Hardware interrupt entry. Program counter points at the next instruction.
+ * @param vector Z6502_IRQ_VECTOR_ADDRESS or Z6502_NMI_VECTOR_ADDRESS
+ */
+static inline void _interrupt(memory_t* mem, cpu_state_t* reg, uint16_t vector){
+    _push_address(mem, reg, reg->program_counter);
+    /*B clear on the stack, unlike BRK*/
+    _push_stack(mem, reg, _pack_status(reg) & ~0x10U);
+    reg->processor_status.irq_disable = 1U;
+    reg->program_counter = _mem_read(mem, vector) | (_mem_read(mem, (uint16_t)(vector + 1U)) << 8);
+}
+
+/**
+ * @brief Jump to subroutine. Program counter points after the instruction.
+ */
+static inline void _jsr(memory_t* mem, cpu_state_t* reg, uint16_t target){
+    /*Return address is the last byte of the instruction*/
+    _push_address(mem, reg, (uint16_t)(reg->program_counter - 1U));
+    reg->program_counter = target;
+}
+
+/**
+ * @brief Return from interrupt
+ */
+static inline void _rti(memory_t* mem, cpu_state_t* reg){
+    _pull_register_stack(mem, reg);
+    reg->program_counter = _pull_address(mem, reg);
+}
+
+/**
+ * @brief Return from subroutine
+ */
+static inline void _rts(memory_t* mem, cpu_state_t* reg){
+    reg->program_counter = (uint16_t)(_pull_address(mem, reg) + 1U);
+}
+
+//*****************************************************************************
+// Instruction implementations, specialized per addressing mode
+//*****************************************************************************
+
+template<addressing_mode_t MODE>
+static inline void _op_ADC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _adc(reg, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_AND(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->accumulator, reg->accumulator & _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_ASL(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    if constexpr (MODE == ACC){
+        reg->accumulator = _asl(reg, reg->accumulator);
+    }
+    else{
+        uint16_t addr = _address<MODE>(mem, reg, operand);
+        _mem_write(mem, addr, _asl(reg, _mem_read(mem, addr)));
+    }
+}
+template<addressing_mode_t MODE>
+static inline void _op_BCC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, reg->processor_status.carry == 0U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BCS(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, reg->processor_status.carry == 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BEQ(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, _zero_flag(reg) == 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BIT(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _bit(reg, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_BMI(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, _negative_flag(reg) == 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BNE(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, _zero_flag(reg) == 0U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BPL(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, _negative_flag(reg) == 0U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BRK(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _brk(mem, reg);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BVC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, reg->processor_status.overflow == 0U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_BVS(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _branch(reg, operand, reg->processor_status.overflow == 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_CLC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.carry = 0U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_CLD(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.decimal_mode = 0U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_CLI(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.irq_disable = 0U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_CLV(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.overflow = 0U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_CMP(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _compare(reg, reg->accumulator, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_CPX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _compare(reg, reg->x, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_CPY(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _compare(reg, reg->y, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_DEC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    uint16_t addr = _address<MODE>(mem, reg, operand);
+    uint8_t value = _mem_read(mem, addr) - 1U;
+    _update_nz_flags(reg, value);
+    _mem_write(mem, addr, value);
+}
+template<addressing_mode_t MODE>
+static inline void _op_DEX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->x, reg->x - 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_DEY(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->y, reg->y - 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_EOR(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->accumulator, reg->accumulator ^ _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_INC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    uint16_t addr = _address<MODE>(mem, reg, operand);
+    uint8_t value = _mem_read(mem, addr) + 1U;
+    _update_nz_flags(reg, value);
+    _mem_write(mem, addr, value);
+}
+template<addressing_mode_t MODE>
+static inline void _op_INX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->x, reg->x + 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_INY(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->y, reg->y + 1U);
+}
+template<addressing_mode_t MODE>
+static inline void _op_JMP(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    if constexpr (MODE == ABS){
+        reg->program_counter = operand;
+    }
+    else{
+        reg->program_counter = _address<MODE>(mem, reg, operand);
+    }
+}
+template<addressing_mode_t MODE>
+static inline void _op_JSR(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _jsr(mem, reg, operand);
+}
+template<addressing_mode_t MODE>
+static inline void _op_LDA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->accumulator, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_LDX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->x, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_LDY(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->y, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_LSR(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    if constexpr (MODE == ACC){
+        reg->accumulator = _lsr(reg, reg->accumulator);
+    }
+    else{
+        uint16_t addr = _address<MODE>(mem, reg, operand);
+        _mem_write(mem, addr, _lsr(reg, _mem_read(mem, addr)));
+    }
+}
+template<addressing_mode_t MODE>
+static inline void _op_NOP(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+}
+template<addressing_mode_t MODE>
+static inline void _op_ORA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->accumulator, reg->accumulator | _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_PHA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _push_stack(mem, reg, reg->accumulator);
+}
+template<addressing_mode_t MODE>
+static inline void _op_PHP(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _push_register_stack(mem, reg);
+}
+template<addressing_mode_t MODE>
+static inline void _op_PLA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    uint8_t tmp;
+    _pull_stack(mem, reg, &tmp);
+    _load(reg, &reg->accumulator, tmp);
+}
+template<addressing_mode_t MODE>
+static inline void _op_PLP(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _pull_register_stack(mem, reg);
+}
+template<addressing_mode_t MODE>
+static inline void _op_ROL(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    if constexpr (MODE == ACC){
+        reg->accumulator = _rol(reg, reg->accumulator);
+    }
+    else{
+        uint16_t addr = _address<MODE>(mem, reg, operand);
+        _mem_write(mem, addr, _rol(reg, _mem_read(mem, addr)));
+    }
+}
+template<addressing_mode_t MODE>
+static inline void _op_ROR(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    if constexpr (MODE == ACC){
+        reg->accumulator = _ror(reg, reg->accumulator);
+    }
+    else{
+        uint16_t addr = _address<MODE>(mem, reg, operand);
+        _mem_write(mem, addr, _ror(reg, _mem_read(mem, addr)));
+    }
+}
+template<addressing_mode_t MODE>
+static inline void _op_RTI(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _rti(mem, reg);
+}
+template<addressing_mode_t MODE>
+static inline void _op_RTS(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _rts(mem, reg);
+}
+template<addressing_mode_t MODE>
+static inline void _op_SBC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _sbc(reg, _read<MODE>(mem, reg, operand));
+}
+template<addressing_mode_t MODE>
+static inline void _op_SEC(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.carry = 1U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_SED(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.decimal_mode = 1U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_SEI(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->processor_status.irq_disable = 1U;
+}
+template<addressing_mode_t MODE>
+static inline void _op_STA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _mem_write(mem, _address<MODE>(mem, reg, operand), reg->accumulator);
+}
+template<addressing_mode_t MODE>
+static inline void _op_STX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _mem_write(mem, _address<MODE>(mem, reg, operand), reg->x);
+}
+template<addressing_mode_t MODE>
+static inline void _op_STY(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _mem_write(mem, _address<MODE>(mem, reg, operand), reg->y);
+}
+template<addressing_mode_t MODE>
+static inline void _op_TAX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->x, reg->accumulator);
+}
+template<addressing_mode_t MODE>
+static inline void _op_TAY(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->y, reg->accumulator);
+}
+template<addressing_mode_t MODE>
+static inline void _op_TSX(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->x, (uint8_t)reg->stack_pointer);
+}
+template<addressing_mode_t MODE>
+static inline void _op_TXA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->accumulator, reg->x);
+}
+template<addressing_mode_t MODE>
+static inline void _op_TXS(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->stack_pointer = reg->x;
+}
+template<addressing_mode_t MODE>
+static inline void _op_TYA(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    _load(reg, &reg->accumulator, reg->y);
+}
+
+//*****************************************************************************
+// Opcode dispatch
+//*****************************************************************************
+
+typedef void (*instruction_t)(memory_t* mem, cpu_state_t* reg);
+
+/**
+ * @brief Execute one opcode whose operand is already fetched. Program
+ * counter points after the instruction. Mnemonic and addressing mode are
+ * taken from instruction_id[] and instruction_mode[] at compile time, so
+ * each instantiation only contains its own addressing logic.
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @param operand Raw operand
+ */
+template<uint8_t OPCODE>
+static inline void _execute_decoded(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    constexpr instruction_id_t id = instruction_id[OPCODE];
+    constexpr addressing_mode_t mode = instruction_mode[OPCODE];
+    if constexpr (id == OP_ADC){
+        _op_ADC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_AND){
+        _op_AND<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_ASL){
+        _op_ASL<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BCC){
+        _op_BCC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BCS){
+        _op_BCS<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BEQ){
+        _op_BEQ<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BIT){
+        _op_BIT<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BMI){
+        _op_BMI<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BNE){
+        _op_BNE<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BPL){
+        _op_BPL<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BRK){
+        _op_BRK<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BVC){
+        _op_BVC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_BVS){
+        _op_BVS<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CLC){
+        _op_CLC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CLD){
+        _op_CLD<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CLI){
+        _op_CLI<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CLV){
+        _op_CLV<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CMP){
+        _op_CMP<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CPX){
+        _op_CPX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_CPY){
+        _op_CPY<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_DEC){
+        _op_DEC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_DEX){
+        _op_DEX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_DEY){
+        _op_DEY<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_EOR){
+        _op_EOR<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_INC){
+        _op_INC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_INX){
+        _op_INX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_INY){
+        _op_INY<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_JMP){
+        _op_JMP<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_JSR){
+        _op_JSR<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_LDA){
+        _op_LDA<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_LDX){
+        _op_LDX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_LDY){
+        _op_LDY<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_LSR){
+        _op_LSR<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_NOP){
+        _op_NOP<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_ORA){
+        _op_ORA<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_PHA){
+        _op_PHA<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_PHP){
+        _op_PHP<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_PLA){
+        _op_PLA<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_PLP){
+        _op_PLP<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_ROL){
+        _op_ROL<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_ROR){
+        _op_ROR<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_RTI){
+        _op_RTI<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_RTS){
+        _op_RTS<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_SBC){
+        _op_SBC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_SEC){
+        _op_SEC<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_SED){
+        _op_SED<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_SEI){
+        _op_SEI<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_STA){
+        _op_STA<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_STX){
+        _op_STX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_STY){
+        _op_STY<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_TAX){
+        _op_TAX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_TAY){
+        _op_TAY<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_TSX){
+        _op_TSX<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_TXA){
+        _op_TXA<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_TXS){
+        _op_TXS<mode>(mem, reg, operand);
+    }
+    else if constexpr (id == OP_TYA){
+        _op_TYA<mode>(mem, reg, operand);
+    }
+}
+
+/**
+ * @brief Execute one opcode. Program counter points after the opcode.
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ */
+template<uint8_t OPCODE>
+static inline void _execute(memory_t* mem, cpu_state_t* reg){
+    uint16_t operand = _fetch_operand<instruction_mode[OPCODE]>(mem, reg);
+    _execute_decoded<OPCODE>(mem, reg, operand);
+}
+
+//*****************************************************************************
+// Timing
+//*****************************************************************************
+
+/*Timing policy of TIMING_FAST: base cycles of instruction_cycles[] only*/
+struct timing_fast_t
+{
+    static constexpr bool accurate = false;
+};
+
+/*Timing policy of TIMING_ACCURATE: base cycles plus branch and page crossing penalties*/
+struct timing_accurate_t
+{
+    static constexpr bool accurate = true;
+};
+
+/**
+ * @brief Instruction reading its operand, one cycle longer when indexing crosses a page
+ * @param id Instruction
+ */
+static constexpr bool _reads_operand(instruction_id_t id){
+    return id == OP_ADC || id == OP_AND || id == OP_CMP || id == OP_EOR || id == OP_LDA ||
+           id == OP_LDX || id == OP_LDY || id == OP_ORA || id == OP_SBC;
+}
+
+/**
+ * @brief Branch condition, evaluated after the branch since it leaves the flags untouched
+ * @param reg Pointer to register set
+ * @param id Branch instruction
+ */
+static inline uint8_t _branch_taken(const cpu_state_t* reg, instruction_id_t id){
+    switch(id){
+        case OP_BCC: return reg->processor_status.carry == 0U;
+        case OP_BCS: return reg->processor_status.carry == 1U;
+        case OP_BEQ: return _zero_flag(reg) == 1U;
+        case OP_BNE: return _zero_flag(reg) == 0U;
+        case OP_BMI: return _negative_flag(reg) == 1U;
+        case OP_BPL: return _negative_flag(reg) == 0U;
+        case OP_BVC: return reg->processor_status.overflow == 0U;
+        default: return reg->processor_status.overflow == 1U;
+    }
+}
+
+/**
+ * @brief Cycles an instruction takes beyond instruction_cycles[]: one for a
+ * taken branch, one more if it lands in another page, one for an indexed read
+ * crossing a page. Evaluated after execution, the index registers are left
+ * untouched by every instruction concerned.
+ * @param mem Pointer to memory space
+ * @param reg Register set after the instruction
+ * @param opcode Opcode
+ * @param operand Raw operand
+ * @param next Address of the following instruction
+ * @return Extra cycles, always 0 with the fast policy
+ */
+template<typename TIMING>
+static Z6502_ALWAYS_INLINE uint8_t _penalty_cycles(memory_t* mem, const cpu_state_t* reg, uint8_t opcode,
+                                                   uint16_t operand, uint16_t next){
+    if constexpr (!TIMING::accurate){
+        return 0U;
+    }
+    else{
+        addressing_mode_t mode = instruction_mode[opcode];
+        uint8_t* zero_page;
+
+        if(mode == REL){
+            if(_branch_taken(reg, instruction_id[opcode]) == 0U){
+                return 0U;
+            }
+            return ((reg->program_counter ^ next) & 0xFF00U) ? 2U : 1U;
+        }
+        if(!_reads_operand(instruction_id[opcode])){
+            return 0U;
+        }
+        if(mode == ABX){
+            return ((operand & 0xFFU) + reg->x) >> 8;
+        }
+        if(mode == ABY){
+            return ((operand & 0xFFU) + reg->y) >> 8;
+        }
+        if(mode == INY){
+            /*Pointer low byte, peeked without a bus access nor a watchpoint
+              hit. A device mapped over zero page is assumed not to cross.*/
+            zero_page = mem->page_map[0].base;
+            return (zero_page != NULL) ? (zero_page[operand & 0xFFU] + reg->y) >> 8 : 0U;
+        }
+        return 0U;
+    }
+}
+
+/**
+ * @brief Execute one opcode and count its cycles. Program counter points after the opcode.
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @return Cycles spent under the TIMING policy
+ */
+template<uint8_t OPCODE, typename TIMING>
+static inline uint8_t _execute_timed(memory_t* mem, cpu_state_t* reg){
+    uint16_t operand = _fetch_operand<instruction_mode[OPCODE]>(mem, reg);
+    uint16_t next = reg->program_counter;
+    _execute_decoded<OPCODE>(mem, reg, operand);
+    return instruction_cycles[OPCODE] + _penalty_cycles<TIMING>(mem, reg, OPCODE, operand, next);
+}
+
+/**
+ * @brief Build the dispatch table from instruction_id[] at compile time
+ * @return One specialized handler per opcode, NULL for undefined opcodes
+ */
+template<std::size_t... OPCODES>
+static constexpr std::array<instruction_t, 256> _make_instruction_set(std::index_sequence<OPCODES...>){
+    return {{ (instruction_id[OPCODES] != OP___ ? &_execute<OPCODES> : (instruction_t)NULL)... }};
+}
+
+static constexpr std::array<instruction_t, 256> instruction_set = _make_instruction_set(std::make_index_sequence<256>());
+
+/*Handler executing one opcode and returning the cycles it took*/
+typedef uint8_t (*timed_instruction_t)(memory_t* mem, cpu_state_t* reg);
+
+/**
+ * @brief Build the accurate timing dispatch table from instruction_id[] at compile time
+ * @return One specialized handler per opcode, NULL for undefined opcodes
+ */
+template<std::size_t... OPCODES>
+static constexpr std::array<timed_instruction_t, 256> _make_accurate_set(std::index_sequence<OPCODES...>){
+    return {{ (instruction_id[OPCODES] != OP___ ? &_execute_timed<OPCODES, timing_accurate_t> : (timed_instruction_t)NULL)... }};
+}
+
+static constexpr std::array<timed_instruction_t, 256> accurate_instruction_set = _make_accurate_set(std::make_index_sequence<256>());
+
+/**
+ * @brief Execute a predecoded instruction. The handler advances the program
+ * counter itself so that the next fetch never waits on the cache entry.
+ * @param mem Pointer to memory space
+ * @param reg Pointer to register set
+ * @param operand Raw operand
+ */
+template<uint8_t OPCODE>
+static void _execute_cached(memory_t* mem, cpu_state_t* reg, uint16_t operand){
+    reg->program_counter += 1U + _operand_length(instruction_mode[OPCODE]);
+    _execute_decoded<OPCODE>(mem, reg, operand);
+}
+
+/**
+ * @brief Build the predecoded handler table from instruction_id[] at compile time
+ * @return One specialized handler per opcode, NULL for undefined opcodes
+ */
+template<std::size_t... OPCODES>
+static constexpr std::array<decoded_handler_t, 256> _make_decoded_set(std::index_sequence<OPCODES...>){
+    return {{ (instruction_id[OPCODES] != OP___ ? &_execute_cached<OPCODES> : (decoded_handler_t)NULL)... }};
+}
+
+static constexpr std::array<decoded_handler_t, 256> decoded_instruction_set = _make_decoded_set(std::make_index_sequence<256>());
+
+#endif // Z6502_PRIVATE_H_INCLUDED
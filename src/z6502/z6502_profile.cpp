@@ -0,0 +1,191 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "z6502.h"
+#include "z6502_profile.h"
+
+Z6502Profiler::Z6502Profiler(){
+    clear();
+}
+
+void Z6502Profiler::clear(void){
+    memset(_opcode_count, 0, sizeof(_opcode_count));
+    memset(_opcode_cycles, 0, sizeof(_opcode_cycles));
+    memset(_address_count, 0, sizeof(_address_count));
+    memset(_address_cycles, 0, sizeof(_address_cycles));
+    memset(_address_opcode, 0, sizeof(_address_opcode));
+}
+
+uint64_t Z6502Profiler::get_instruction_count(void){
+    uint64_t total = 0U;
+    for(unsigned int opcode = 0U; opcode < 256U; opcode++){
+        total += _opcode_count[opcode];
+    }
+    return total;
+}
+
+uint64_t Z6502Profiler::get_cycle_count(void){
+    uint64_t total = 0U;
+    for(unsigned int opcode = 0U; opcode < 256U; opcode++){
+        total += _opcode_cycles[opcode];
+    }
+    return total;
+}
+
+void Z6502Profiler::get_opcode(uint8_t opcode, profile_entry_t* entry){
+    entry->address = 0U;
+    entry->opcode = opcode;
+    entry->count = _opcode_count[opcode];
+    entry->cycles = _opcode_cycles[opcode];
+}
+
+void Z6502Profiler::get_address(uint16_t address, profile_entry_t* entry){
+    entry->address = address;
+    entry->opcode = _address_opcode[address];
+    entry->count = _address_count[address];
+    entry->cycles = _address_cycles[address];
+}
+
+unsigned int Z6502Profiler::_top(profile_entry_t* entries, unsigned int count, unsigned int max){
+    auto hotter = [](const profile_entry_t& a, const profile_entry_t& b){
+        return (a.cycles != b.cycles) ? a.cycles > b.cycles : a.address < b.address;
+    };
+
+    if(max > count){
+        max = count;
+    }
+    std::partial_sort(entries, entries + max, entries + count, hotter);
+    return max;
+}
+
+unsigned int Z6502Profiler::get_hot_opcodes(profile_entry_t* entries, unsigned int max){
+    profile_entry_t ran[256];
+    unsigned int count = 0U;
+
+    for(unsigned int opcode = 0U; opcode < 256U; opcode++){
+        if(_opcode_count[opcode] > 0U){
+            get_opcode(opcode, &ran[count++]);
+        }
+    }
+    max = _top(ran, count, max);
+    memcpy(entries, ran, max * sizeof(profile_entry_t));
+    return max;
+}
+
+unsigned int Z6502Profiler::get_hot_spots(profile_entry_t* entries, unsigned int max){
+    std::vector<profile_entry_t> ran;
+
+    for(unsigned int address = 0U; address < Z6502_MAX_MEMORY_SIZE_BYTES; address++){
+        if(_address_count[address] > 0U){
+            ran.emplace_back();
+            get_address(address, &ran.back());
+        }
+    }
+    max = _top(ran.data(), ran.size(), max);
+    memcpy(entries, ran.data(), max * sizeof(profile_entry_t));
+    return max;
+}
+
+void Z6502Profiler::print_summary(FILE* out, unsigned int max){
+    std::vector<profile_entry_t> top(max);
+    uint64_t cycles = get_cycle_count();
+    double scale = (cycles > 0U) ? 100.0 / cycles : 0.0;
+    unsigned int count;
+
+    fprintf(out, "%llu instructions, %llu cycles\n", (unsigned long long)get_instruction_count(), (unsigned long long)cycles);
+
+    count = get_hot_spots(top.data(), max);
+    fprintf(out, "Hot spots:\n   address  opcode  %%cycles          cycles      executions\n");
+    for(unsigned int i = 0U; i < count; i++){
+        fprintf(out, "   $%04X    %02X %s  %6.2f  %14llu  %14llu\n", top[i].address, top[i].opcode,
+                instruction_mnemonic[instruction_id[top[i].opcode]], top[i].cycles * scale,
+                (unsigned long long)top[i].cycles, (unsigned long long)top[i].count);
+    }
+
+    count = get_hot_opcodes(top.data(), max);
+    fprintf(out, "Hot opcodes:\n   opcode  %%cycles          cycles      executions\n");
+    for(unsigned int i = 0U; i < count; i++){
+        fprintf(out, "   %02X %s  %6.2f  %14llu  %14llu\n", top[i].opcode,
+                instruction_mnemonic[instruction_id[top[i].opcode]], top[i].cycles * scale,
+                (unsigned long long)top[i].cycles, (unsigned long long)top[i].count);
+    }
+}
+
+int Z6502Profiler::export_csv(const char* filename){
+    FILE* file = fopen(filename, "w");
+    int result;
+
+    if(file == NULL){
+        return -1;
+    }
+    fprintf(file, "kind,address,opcode,mnemonic,count,cycles\n");
+    for(unsigned int opcode = 0U; opcode < 256U; opcode++){
+        if(_opcode_count[opcode] > 0U){
+            fprintf(file, "opcode,,%02X,%s,%llu,%llu\n", opcode, instruction_mnemonic[instruction_id[opcode]],
+                    (unsigned long long)_opcode_count[opcode], (unsigned long long)_opcode_cycles[opcode]);
+        }
+    }
+    for(unsigned int address = 0U; address < Z6502_MAX_MEMORY_SIZE_BYTES; address++){
+        if(_address_count[address] > 0U){
+            fprintf(file, "address,%04X,%02X,%s,%llu,%llu\n", address, _address_opcode[address],
+                    instruction_mnemonic[instruction_id[_address_opcode[address]]],
+                    (unsigned long long)_address_count[address], (unsigned long long)_address_cycles[address]);
+        }
+    }
+    result = (ferror(file) != 0) ? -1 : 0;
+    if(fclose(file) != 0){
+        result = -1;
+    }
+    return result;
+}
+
+int Z6502Profiler::export_json(const char* filename){
+    FILE* file = fopen(filename, "w");
+    const char* separator = "";
+    int result;
+
+    if(file == NULL){
+        return -1;
+    }
+    fprintf(file, "{\n  \"instructions\": %llu,\n  \"cycles\": %llu,\n  \"opcodes\": [",
+            (unsigned long long)get_instruction_count(), (unsigned long long)get_cycle_count());
+    for(unsigned int opcode = 0U; opcode < 256U; opcode++){
+        if(_opcode_count[opcode] > 0U){
+            fprintf(file, "%s\n    {\"opcode\": %u, \"mnemonic\": \"%s\", \"count\": %llu, \"cycles\": %llu}",
+                    separator, opcode, instruction_mnemonic[instruction_id[opcode]],
+                    (unsigned long long)_opcode_count[opcode], (unsigned long long)_opcode_cycles[opcode]);
+            separator = ",";
+        }
+    }
+    fprintf(file, "\n  ],\n  \"addresses\": [");
+    separator = "";
+    for(unsigned int address = 0U; address < Z6502_MAX_MEMORY_SIZE_BYTES; address++){
+        if(_address_count[address] > 0U){
+            fprintf(file, "%s\n    {\"address\": %u, \"opcode\": %u, \"mnemonic\": \"%s\", \"count\": %llu, \"cycles\": %llu}",
+                    separator, address, _address_opcode[address], instruction_mnemonic[instruction_id[_address_opcode[address]]],
+                    (unsigned long long)_address_count[address], (unsigned long long)_address_cycles[address]);
+            separator = ",";
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+    result = (ferror(file) != 0) ? -1 : 0;
+    if(fclose(file) != 0){
+        result = -1;
+    }
+    return result;
+}
@@ -0,0 +1,289 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Record and replay. The recorded instance and the replaying one share a
+    replay_s log through memory_t::replay. Device reads only happen on the
+    bus slow path, so RAM accesses cost nothing more while recording.
+    Interrupts are logged by Z6502::_take_interrupt() with the cycle count
+    they were taken at, and the replaying instance takes them again at the
+    same count: running to that count always stops on the same instruction
+    boundary since execution up to it is the same.
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include "z6502.h"
+#include "z6502_private.h"
+#include "z6502_replay.h"
+
+uint8_t _replay_read(memory_t* mem, const device_t* device, uint16_t addr){
+    struct replay_s* replay = mem->replay;
+    uint8_t value;
+
+    if(mem->replaying == TRUE){
+        /*Past the end of the recording devices read as open bus*/
+        if(replay->next_read < replay->read.size()){
+            return replay->read[replay->next_read++];
+        }
+        return Z6502_OPEN_BUS_VALUE;
+    }
+    value = device->read(device->context, addr);
+    replay->read.push_back(value);
+    return value;
+}
+
+void _replay_log_interrupt(struct replay_s* replay, uint64_t cycles, uint16_t vector){
+    replay_interrupt_t interrupt;
+
+    interrupt.cycles = cycles;
+    interrupt.vector = vector;
+    replay->interrupt.push_back(interrupt);
+}
+
+Z6502Replay::Z6502Replay(){
+    _log = NULL;
+    _interval = Z6502_REPLAY_DEFAULT_INTERVAL;
+    _recorded = NULL;
+    _end = 0U;
+    _cpu = NULL;
+    _next_interrupt = 0U;
+}
+
+void Z6502Replay::_clear(void){
+    for(replay_checkpoint_t& checkpoint : _checkpoint){
+        snapshot_free(checkpoint.snapshot);
+    }
+    _checkpoint.clear();
+    delete _cpu;
+    _cpu = NULL;
+    delete _log;
+    _log = NULL;
+    _end = 0U;
+}
+
+int Z6502Replay::_take_checkpoint(void){
+    replay_checkpoint_t checkpoint;
+
+    checkpoint.snapshot = _recorded->snapshot();
+    if(checkpoint.snapshot == NULL){
+        return -1;
+    }
+    checkpoint.cycles = _recorded->get_cycles();
+    checkpoint.instructions = _recorded->get_instructions();
+    checkpoint.read = _log->read.size();
+    checkpoint.interrupt = _log->interrupt.size();
+    _checkpoint.push_back(checkpoint);
+    return 0;
+}
+
+int Z6502Replay::record(Z6502* cpu, uint64_t checkpoint_interval){
+    if(_recorded != NULL || cpu->_memory.replay != NULL || checkpoint_interval == 0U){
+        return -1;
+    }
+    _clear();
+
+    _log = new (std::nothrow) replay_s();
+    _cpu = new (std::nothrow) Z6502(NULL);
+    if(_log == NULL || _cpu == NULL){
+        _clear();
+        return -1;
+    }
+    _log->next_read = 0U;
+    _interval = checkpoint_interval;
+    _recorded = cpu;
+    if(_take_checkpoint() < 0){
+        _recorded = NULL;
+        _clear();
+        return -1;
+    }
+    cpu->_memory.replay = _log;
+    cpu->_memory.replaying = FALSE;
+
+    /*The replaying instance runs like the recorded one, from the first checkpoint*/
+    _cpu->set_core(cpu->get_core());
+    _cpu->set_timing(cpu->get_timing());
+    _cpu->set_idle_skip(cpu->_idle_skip);
+    _cpu->_memory.replay = _log;
+    _cpu->_memory.replaying = TRUE;
+    _cpu->restore(_checkpoint.front().snapshot);
+    _next_interrupt = 0U;
+    return 0;
+}
+
+uint64_t Z6502Replay::run(uint64_t cycle_budget){
+    uint64_t spent = 0U;
+    uint64_t next;
+    uint64_t chunk;
+    uint64_t ran;
+
+    if(_recorded == NULL){
+        return 0U;
+    }
+    while(spent < cycle_budget){
+        next = _checkpoint.back().cycles + _interval;
+        if(_recorded->get_cycles() >= next){
+            if(_take_checkpoint() < 0){
+                /*Out of memory, seeking gets slower but the log stays complete*/
+                _interval *= 2U;
+            }
+            continue;
+        }
+        chunk = std::min(cycle_budget - spent, next - _recorded->get_cycles());
+        ran = _recorded->run(chunk);
+        spent += ran;
+        if(ran < chunk){
+            /*Halted or stopped*/
+            break;
+        }
+    }
+    return spent;
+}
+
+void Z6502Replay::stop(void){
+    if(_recorded != NULL){
+        _end = _recorded->get_cycles();
+        _recorded->_memory.replay = NULL;
+        _recorded = NULL;
+    }
+}
+
+uint64_t Z6502Replay::get_end(void){
+    return (_recorded != NULL) ? _recorded->get_cycles() : _end;
+}
+
+void Z6502Replay::_advance(uint64_t cycles){
+    const replay_interrupt_t* interrupt;
+    uint64_t limit;
+
+    while(_cpu->_cycles < cycles && _cpu->_halted == FALSE){
+        limit = cycles;
+        if(_next_interrupt < _log->interrupt.size()){
+            interrupt = &_log->interrupt[_next_interrupt];
+            if(interrupt->cycles <= _cpu->_cycles){
+                _cpu->_take_interrupt(interrupt->vector);
+                _next_interrupt++;
+                continue;
+            }
+            limit = std::min(limit, interrupt->cycles);
+        }
+        _cpu->run(limit - _cpu->_cycles);
+    }
+}
+
+int Z6502Replay::seek(uint64_t cycles){
+    const replay_checkpoint_t* checkpoint;
+
+    if(_cpu == NULL){
+        return -1;
+    }
+    cycles = std::min(std::max(cycles, get_start()), get_end());
+
+    /*Last checkpoint at or before the target*/
+    checkpoint = &*(std::upper_bound(_checkpoint.begin(), _checkpoint.end(), cycles,
+                                     [](uint64_t value, const replay_checkpoint_t& entry){
+                                         return value < entry.cycles;
+                                     }) - 1);
+
+    /*Replay forward from where the instance is when it is in the same interval*/
+    if(_cpu->_cycles > cycles || _cpu->_cycles < checkpoint->cycles){
+        _cpu->restore(checkpoint->snapshot);
+        _log->next_read = checkpoint->read;
+        _next_interrupt = checkpoint->interrupt;
+    }
+    _advance(cycles);
+    return 0;
+}
+
+int Z6502Replay::seek_instruction(uint64_t instructions){
+    const replay_checkpoint_t* checkpoint;
+
+    if(_cpu == NULL){
+        return -1;
+    }
+    if(instructions <= _checkpoint.front().instructions){
+        return seek(get_start());
+    }
+
+    /*Last checkpoint before the target count: one with the same count may
+      follow an interrupt entry taken after the first boundary with it*/
+    checkpoint = &*(std::lower_bound(_checkpoint.begin(), _checkpoint.end(), instructions,
+                                     [](const replay_checkpoint_t& entry, uint64_t value){
+                                         return entry.instructions < value;
+                                     }) - 1);
+
+    if(_cpu->_instructions >= instructions || _cpu->_cycles < checkpoint->cycles){
+        _cpu->restore(checkpoint->snapshot);
+        _log->next_read = checkpoint->read;
+        _next_interrupt = checkpoint->interrupt;
+    }
+
+    /*Instructions take at least two cycles, so replaying twice the count
+      left minus one in cycles stays before the target. The last instruction
+      is stepped alone, so no interrupt entry after it is taken*/
+    while(_cpu->_instructions < instructions && _cpu->_halted == FALSE && _cpu->_cycles < get_end()){
+        if(instructions - _cpu->_instructions > 1U){
+            _advance(std::min(get_end(), _cpu->_cycles + 2U * (instructions - _cpu->_instructions - 1U)));
+        }
+        else if(step() < 0){
+            break;
+        }
+    }
+    return 0;
+}
+
+int Z6502Replay::step(void){
+    uint64_t start;
+
+    if(_cpu == NULL || _cpu->_halted == TRUE || _cpu->_cycles >= get_end()){
+        return -1;
+    }
+    start = _cpu->_cycles;
+    if(_next_interrupt < _log->interrupt.size() && _log->interrupt[_next_interrupt].cycles <= start){
+        _cpu->_take_interrupt(_log->interrupt[_next_interrupt].vector);
+        _next_interrupt++;
+    }
+    else{
+        _cpu->step();
+    }
+    return (int)(_cpu->_cycles - start);
+}
+
+int Z6502Replay::step_back(void){
+    uint64_t target;
+    uint64_t previous;
+
+    if(_cpu == NULL || _cpu->_cycles <= get_start()){
+        return -1;
+    }
+    target = _cpu->_cycles;
+
+    /*No instruction or interrupt entry takes more than Z6502_INTERRUPT_CYCLES,
+      the previous boundary is after target - Z6502_INTERRUPT_CYCLES - 1*/
+    seek(target - std::min(target, (uint64_t)Z6502_INTERRUPT_CYCLES + 1U));
+    previous = _cpu->_cycles;
+    while(_cpu->_cycles < target){
+        previous = _cpu->_cycles;
+        if(step() <= 0){
+            break;
+        }
+    }
+    return seek(previous);
+}
+
+Z6502Replay::~Z6502Replay(){
+    stop();
+    _clear();
+}
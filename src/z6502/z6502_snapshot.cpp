@@ -0,0 +1,211 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Snapshots and copy-on-write forks. A snapshot holds reference counted
+    copies of the memory pages. An instance page that still matches its
+    snapshot page points at it in memory_t.shared[] and has no direct write
+    pointer, so the first store to it takes the bus slow path:
+
+    - a page backed by memory of the instance (the memory space given to the
+      constructor or map_memory()) still holds the same bytes and only stops
+      sharing;
+    - a page that lives in the snapshot (forked instances, restored pages
+      without memory of their own) is copied to memory owned by the instance.
+
+    Pages never written after a snapshot are shared by the next snapshot
+    without copying, and restoring skips them.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "z6502.h"
+#include "z6502_private.h"
+
+/*Saved registers and memory*/
+struct z6502_snapshot_s
+{
+    cpu_state_t reg;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint8_t halted;
+    page_map_t page_map[Z6502_PAGE_COUNT];      /* Mapping of ROM, devices and unmapped pages */
+    snapshot_page_t* page[Z6502_PAGE_COUNT];    /* Saved memory page, NULL for ROM, devices and unmapped pages */
+};
+
+void _release_snapshot_page(snapshot_page_t* page){
+    if(page != NULL && page->refs.fetch_sub(1U) == 1U){
+        delete page;
+    }
+}
+
+int _unshare_page(memory_t* mem, uint8_t page){
+    snapshot_page_t* shared = mem->shared[page];
+    page_map_t* map = &mem->page_map[page];
+
+    if(map->base == shared->data){
+        /*Page lives in the snapshot, copy it to the instance*/
+        if(mem->owned == NULL){
+            mem->owned = (uint8_t*)malloc(Z6502_MAX_MEMORY_SIZE_BYTES);
+            if(mem->owned == NULL){
+                return -1;
+            }
+        }
+        map->base = &mem->owned[page * Z6502_PAGE_SIZE_BYTES];
+        memcpy(map->base, shared->data, Z6502_PAGE_SIZE_BYTES);
+        mem->shared[page] = NULL;
+        _remap_page(mem, page);
+    }
+    else{
+        /*Memory of its own still holds the same bytes*/
+        mem->shared[page] = NULL;
+        if(mem->code_page[page] == FALSE && _page_writable(mem, page)){
+            mem->write_page[page] = map->base;
+        }
+    }
+
+    _release_snapshot_page(shared);
+    return 0;
+}
+
+/**
+ * @brief Page is backed by memory of the instance
+ * @param mem Pointer to memory space
+ * @param page Page number
+ */
+static uint8_t _page_backed(memory_t* mem, uint8_t page){
+    const page_map_t* map = &mem->page_map[page];
+    return map->base != NULL && map->read_only == FALSE &&
+           (mem->shared[page] == NULL || map->base != mem->shared[page]->data);
+}
+
+z6502_snapshot_t* Z6502::snapshot(void){
+    z6502_snapshot_t* snapshot = (z6502_snapshot_t*)calloc(1, sizeof(z6502_snapshot_t));
+    page_map_t* map;
+    snapshot_page_t* saved;
+
+    if(snapshot == NULL){
+        return NULL;
+    }
+    snapshot->reg = _reg;
+    snapshot->cycles = _cycles;
+    snapshot->instructions = _instructions;
+    snapshot->halted = _halted;
+
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        map = &_memory.page_map[page];
+        snapshot->page_map[page] = *map;
+        if(map->base == NULL || map->read_only != FALSE){
+            continue;
+        }
+
+        /*Pages written since the previous snapshot are copied*/
+        if(_memory.shared[page] == NULL){
+            saved = new (std::nothrow) snapshot_page_t;
+            if(saved == NULL){
+                snapshot_free(snapshot);
+                return NULL;
+            }
+            saved->refs = 1U;
+            memcpy(saved->data, map->base, Z6502_PAGE_SIZE_BYTES);
+            _memory.shared[page] = saved;
+            _memory.write_page[page] = NULL;
+            if(_memory.jit != NULL){
+                _jit_unmap_page(_memory.jit, page);
+            }
+        }
+        saved = _memory.shared[page];
+        saved->refs++;
+        snapshot->page[page] = saved;
+        snapshot->page_map[page].base = NULL;
+    }
+    return snapshot;
+}
+
+void Z6502::restore(const z6502_snapshot_t* snapshot){
+    const page_map_t* map;
+    snapshot_page_t* saved;
+
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        saved = snapshot->page[page];
+        if(saved != NULL && _memory.shared[page] == saved){
+            /*Not written since*/
+            continue;
+        }
+
+        if(saved != NULL && _page_backed(&_memory, page)){
+            /*Refresh memory of the instance in place*/
+            memcpy(_memory.page_map[page].base, saved->data, Z6502_PAGE_SIZE_BYTES);
+            _release_snapshot_page(_memory.shared[page]);
+            saved->refs++;
+            _memory.shared[page] = saved;
+            _remap_page(&_memory, page);
+            continue;
+        }
+
+        _release_snapshot_page(_memory.shared[page]);
+        _memory.shared[page] = NULL;
+        map = &snapshot->page_map[page];
+        if(saved != NULL){
+            /*Share the snapshot page until written*/
+            saved->refs++;
+            _memory.shared[page] = saved;
+            _memory.page_map[page].base = saved->data;
+            _memory.page_map[page].device = NULL;
+            _memory.page_map[page].read_only = FALSE;
+        }
+        else{
+            _memory.page_map[page] = *map;
+        }
+        _remap_page(&_memory, page);
+    }
+
+    _reg = snapshot->reg;
+    _cycles = snapshot->cycles;
+    _instructions = snapshot->instructions;
+    _halted = snapshot->halted;
+    _stop_requested = FALSE;
+    if(_memory.debug != NULL){
+        /*A breakpoint at the restored position stops again*/
+        _memory.debug->resume_cycles = UINT64_MAX;
+    }
+}
+
+Z6502* Z6502::fork(void){
+    z6502_snapshot_t* state = snapshot();
+    Z6502* child;
+
+    if(state == NULL){
+        return NULL;
+    }
+    child = new (std::nothrow) Z6502(NULL);
+    if(child != NULL){
+        child->set_core(_core);
+        child->set_timing(_timing);
+        child->restore(state);
+    }
+    snapshot_free(state);
+    return child;
+}
+
+void snapshot_free(z6502_snapshot_t* snapshot){
+    if(snapshot == NULL){
+        return;
+    }
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        _release_snapshot_page(snapshot->page[page]);
+    }
+    free(snapshot);
+}
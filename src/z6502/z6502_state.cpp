@@ -0,0 +1,372 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Save-states. A state holds the registers and the RAM pages that differ
+    from a reference image, so a state of a machine that only touched a few
+    pages takes a few hundred bytes. Layout, little-endian:
+
+        header      Z6502_STATE_MAGIC, version, flags, zero padding
+        reference   u64 FNV-1a of the reference image
+        counters    u64 cycles, u64 instructions
+        registers   u16 PC, u16 SP, u8 A, X, Y, P, halted, NMI pending, u32 IRQ lines
+        pages       u16 count, then per page: u8 page number, u8 encoding, payload
+                    STATE_PAGE_RAW:   256 bytes
+                    STATE_PAGE_DELTA: u16 length, run-length coded XOR with the reference
+        checksum    u64 FNV-1a of everything after the header
+
+    Delta code: a byte c below 0x80 is followed by c + 1 literal bytes, a
+    byte c from 0x80 stands for c - 0x7F zero bytes. A page is stored raw
+    when its delta is not smaller.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "z6502.h"
+#include "z6502_private.h"
+
+/*Page encodings*/
+#define STATE_PAGE_RAW 0U
+#define STATE_PAGE_DELTA 1U
+
+/*Longest delta code of a page: alternating zero and non zero bytes*/
+#define STATE_DELTA_MAX_BYTES (Z6502_PAGE_SIZE_BYTES * 3U / 2U)
+
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+/*Stream being written or read, with the checksum of what went through*/
+typedef struct
+{
+    FILE* file;
+    uint64_t checksum;
+    uint8_t error;
+} state_stream_t;
+
+static const uint8_t zero_page[Z6502_PAGE_SIZE_BYTES] = {0};
+
+static uint64_t _fnv(uint64_t hash, const uint8_t* data, size_t length){
+    for(size_t i = 0U; i < length; i++){
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Page of the reference image, all zero without reference
+ */
+static inline const uint8_t* _reference_page(const uint8_t* reference, unsigned int page){
+    return (reference != NULL) ? &reference[page * Z6502_PAGE_SIZE_BYTES] : zero_page;
+}
+
+static uint64_t _reference_hash(const uint8_t* reference){
+    uint64_t hash = FNV_OFFSET;
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        hash = _fnv(hash, _reference_page(reference, page), Z6502_PAGE_SIZE_BYTES);
+    }
+    return hash;
+}
+
+static void _put(state_stream_t* stream, const uint8_t* data, size_t length){
+    stream->checksum = _fnv(stream->checksum, data, length);
+    if(fwrite(data, 1U, length, stream->file) != length){
+        stream->error = TRUE;
+    }
+}
+
+static void _put_value(state_stream_t* stream, uint64_t value, unsigned int bytes){
+    uint8_t data[8];
+    for(unsigned int i = 0U; i < bytes; i++){
+        data[i] = (uint8_t)(value >> (i * 8U));
+    }
+    _put(stream, data, bytes);
+}
+
+static void _get(state_stream_t* stream, uint8_t* data, size_t length){
+    if(stream->error == FALSE && fread(data, 1U, length, stream->file) == length){
+        stream->checksum = _fnv(stream->checksum, data, length);
+        return;
+    }
+    memset(data, 0, length);
+    stream->error = TRUE;
+}
+
+static uint64_t _get_value(state_stream_t* stream, unsigned int bytes){
+    uint8_t data[8];
+    uint64_t value = 0U;
+
+    _get(stream, data, bytes);
+    for(unsigned int i = 0U; i < bytes; i++){
+        value |= (uint64_t)data[i] << (i * 8U);
+    }
+    return value;
+}
+
+/**
+ * @brief Run-length code the XOR of a page with its reference
+ * @param page Page
+ * @param reference Reference page
+ * @param code Output, STATE_DELTA_MAX_BYTES long
+ * @returns Code length
+ */
+static unsigned int _encode_delta(const uint8_t* page, const uint8_t* reference, uint8_t* code){
+    unsigned int length = 0U;
+    unsigned int i = 0U;
+    unsigned int run;
+
+    while(i < Z6502_PAGE_SIZE_BYTES){
+        run = 0U;
+        if(page[i] == reference[i]){
+            while(i + run < Z6502_PAGE_SIZE_BYTES && run < 128U && page[i + run] == reference[i + run]){
+                run++;
+            }
+            code[length++] = (uint8_t)(0x7FU + run);
+        }
+        else{
+            while(i + run < Z6502_PAGE_SIZE_BYTES && run < 128U && page[i + run] != reference[i + run]){
+                run++;
+            }
+            code[length++] = (uint8_t)(run - 1U);
+            for(unsigned int j = 0U; j < run; j++){
+                code[length++] = page[i + j] ^ reference[i + j];
+            }
+        }
+        i += run;
+    }
+    return length;
+}
+
+/**
+ * @brief Rebuild a page from its delta code
+ * @returns 0 on success, -1 if the code does not make exactly one page
+ */
+static int _decode_delta(const uint8_t* code, unsigned int length, const uint8_t* reference, uint8_t* page){
+    unsigned int position = 0U;
+    unsigned int i = 0U;
+    unsigned int run;
+
+    while(position < length){
+        if(code[position] >= 0x80U){
+            run = code[position++] - 0x7FU;
+            if(i + run > Z6502_PAGE_SIZE_BYTES){
+                return -1;
+            }
+            memcpy(&page[i], &reference[i], run);
+        }
+        else{
+            run = code[position++] + 1U;
+            if(i + run > Z6502_PAGE_SIZE_BYTES || position + run > length){
+                return -1;
+            }
+            for(unsigned int j = 0U; j < run; j++){
+                page[i + j] = code[position + j] ^ reference[i + j];
+            }
+            position += run;
+        }
+        i += run;
+    }
+    return (i == Z6502_PAGE_SIZE_BYTES) ? 0 : -1;
+}
+
+/**
+ * @brief Page is RAM: memory that is not read only
+ */
+static inline uint8_t _page_ram(const memory_t* mem, unsigned int page){
+    return (mem->page_map[page].base != NULL && mem->page_map[page].read_only == FALSE) ? TRUE : FALSE;
+}
+
+int Z6502::save_state(FILE* file, const uint8_t* reference, uint8_t flags){
+    uint8_t header[Z6502_STATE_HEADER_BYTES] = {0};
+    uint8_t code[STATE_DELTA_MAX_BYTES];
+    state_stream_t stream = {file, FNV_OFFSET, FALSE};
+    unsigned int count = 0U;
+    unsigned int length;
+    const uint8_t* base;
+    const uint8_t* source;
+
+    memcpy(header, Z6502_STATE_MAGIC, sizeof(Z6502_STATE_MAGIC) - 1U);
+    header[sizeof(Z6502_STATE_MAGIC) - 1U] = Z6502_STATE_VERSION;
+    header[sizeof(Z6502_STATE_MAGIC)] = flags & Z6502_STATE_COMPRESSED;
+    if(fwrite(header, sizeof(header), 1, file) != 1){
+        return -1;
+    }
+
+    _put_value(&stream, _reference_hash(reference), 8U);
+    _put_value(&stream, _cycles, 8U);
+    _put_value(&stream, _instructions, 8U);
+    _put_value(&stream, _reg.program_counter, 2U);
+    _put_value(&stream, _reg.stack_pointer, 2U);
+    _put_value(&stream, _reg.accumulator, 1U);
+    _put_value(&stream, _reg.x, 1U);
+    _put_value(&stream, _reg.y, 1U);
+    _put_value(&stream, _pack_status(&_reg), 1U);
+    _put_value(&stream, _halted, 1U);
+    _put_value(&stream, _nmi_pending, 1U);
+    _put_value(&stream, _irq_lines, 4U);
+
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        if(_page_ram(&_memory, page) == TRUE &&
+           memcmp(_memory.page_map[page].base, _reference_page(reference, page), Z6502_PAGE_SIZE_BYTES) != 0){
+            count++;
+        }
+    }
+    _put_value(&stream, count, 2U);
+    for(unsigned int page = 0U; page < Z6502_PAGE_COUNT; page++){
+        if(_page_ram(&_memory, page) == FALSE){
+            continue;
+        }
+        base = _memory.page_map[page].base;
+        source = _reference_page(reference, page);
+        if(memcmp(base, source, Z6502_PAGE_SIZE_BYTES) == 0){
+            continue;
+        }
+        _put_value(&stream, page, 1U);
+        length = ((flags & Z6502_STATE_COMPRESSED) != 0U) ? _encode_delta(base, source, code) : Z6502_PAGE_SIZE_BYTES;
+        if(length < Z6502_PAGE_SIZE_BYTES){
+            _put_value(&stream, STATE_PAGE_DELTA, 1U);
+            _put_value(&stream, length, 2U);
+            _put(&stream, code, length);
+        }
+        else{
+            _put_value(&stream, STATE_PAGE_RAW, 1U);
+            _put(&stream, base, Z6502_PAGE_SIZE_BYTES);
+        }
+    }
+    _put_value(&stream, stream.checksum, 8U);
+    return (stream.error == FALSE && ferror(file) == 0) ? 0 : -1;
+}
+
+int Z6502::load_state(FILE* file, const uint8_t* reference){
+    uint8_t header[Z6502_STATE_HEADER_BYTES];
+    uint8_t code[STATE_DELTA_MAX_BYTES];
+    uint8_t present[Z6502_PAGE_COUNT] = {0};
+    uint8_t changed[Z6502_PAGE_COUNT] = {0};
+    state_stream_t stream = {file, FNV_OFFSET, FALSE};
+    cpu_state_t reg = _reg;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint8_t halted;
+    uint8_t nmi_pending;
+    uint32_t irq_lines;
+    unsigned int count;
+    unsigned int page;
+    unsigned int encoding;
+    unsigned int length;
+    uint8_t* memory;
+    const uint8_t* source;
+    int result = 0;
+
+    if(fread(header, sizeof(header), 1, file) != 1 ||
+       memcmp(header, Z6502_STATE_MAGIC, sizeof(Z6502_STATE_MAGIC) - 1U) != 0 ||
+       header[sizeof(Z6502_STATE_MAGIC) - 1U] != Z6502_STATE_VERSION ||
+       (header[sizeof(Z6502_STATE_MAGIC)] & ~Z6502_STATE_COMPRESSED) != 0U){
+        return -1;
+    }
+    for(unsigned int i = sizeof(Z6502_STATE_MAGIC) + 1U; i < Z6502_STATE_HEADER_BYTES; i++){
+        if(header[i] != 0U){
+            return -1;
+        }
+    }
+    if(_get_value(&stream, 8U) != _reference_hash(reference)){
+        return -1;
+    }
+    cycles = _get_value(&stream, 8U);
+    instructions = _get_value(&stream, 8U);
+    reg.program_counter = (uint16_t)_get_value(&stream, 2U);
+    reg.stack_pointer = (uint16_t)_get_value(&stream, 2U);
+    reg.accumulator = (uint8_t)_get_value(&stream, 1U);
+    reg.x = (uint8_t)_get_value(&stream, 1U);
+    reg.y = (uint8_t)_get_value(&stream, 1U);
+    _unpack_status(&reg, (uint8_t)_get_value(&stream, 1U));
+    halted = (_get_value(&stream, 1U) != 0U) ? TRUE : FALSE;
+    nmi_pending = (_get_value(&stream, 1U) != 0U) ? TRUE : FALSE;
+    irq_lines = (uint32_t)_get_value(&stream, 4U);
+
+    /*Read every page before touching the instance*/
+    memory = (uint8_t*)malloc(Z6502_MAX_MEMORY_SIZE_BYTES);
+    if(memory == NULL){
+        return -1;
+    }
+    count = (unsigned int)_get_value(&stream, 2U);
+    for(unsigned int i = 0U; i < count && stream.error == FALSE && result == 0; i++){
+        page = (unsigned int)_get_value(&stream, 1U);
+        if(present[page] == TRUE || _page_ram(&_memory, page) == FALSE){
+            result = -1;
+            break;
+        }
+        present[page] = TRUE;
+        encoding = (unsigned int)_get_value(&stream, 1U);
+        if(encoding == STATE_PAGE_DELTA){
+            length = (unsigned int)_get_value(&stream, 2U);
+            if(length > sizeof(code)){
+                result = -1;
+                break;
+            }
+            _get(&stream, code, length);
+            result = _decode_delta(code, length, _reference_page(reference, page), &memory[page * Z6502_PAGE_SIZE_BYTES]);
+        }
+        else if(encoding == STATE_PAGE_RAW){
+            _get(&stream, &memory[page * Z6502_PAGE_SIZE_BYTES], Z6502_PAGE_SIZE_BYTES);
+        }
+        else{
+            result = -1;
+        }
+    }
+    if(result == 0 && stream.error == FALSE){
+        uint64_t checksum = stream.checksum;
+        result = (_get_value(&stream, 8U) == checksum && stream.error == FALSE) ? 0 : -1;
+    }
+    else{
+        result = -1;
+    }
+
+    /*Unshare every page that changes first, running out of memory then
+      leaves the contents as they were*/
+    for(page = 0U; page < Z6502_PAGE_COUNT && result == 0; page++){
+        if(_page_ram(&_memory, page) == FALSE){
+            continue;
+        }
+        source = (present[page] == TRUE) ? &memory[page * Z6502_PAGE_SIZE_BYTES] : _reference_page(reference, page);
+        changed[page] = (memcmp(_memory.page_map[page].base, source, Z6502_PAGE_SIZE_BYTES) != 0) ? TRUE : FALSE;
+        if(changed[page] == TRUE && _memory.shared[page] != NULL && _unshare_page(&_memory, page) < 0){
+            result = -1;
+        }
+    }
+
+    /*Apply, only pages that change*/
+    for(page = 0U; page < Z6502_PAGE_COUNT && result == 0; page++){
+        if(changed[page] == TRUE){
+            source = (present[page] == TRUE) ? &memory[page * Z6502_PAGE_SIZE_BYTES] : _reference_page(reference, page);
+            memcpy(_memory.page_map[page].base, source, Z6502_PAGE_SIZE_BYTES);
+        }
+    }
+    free(memory);
+    if(result < 0){
+        return -1;
+    }
+
+    invalidate_cache();
+    _reg = reg;
+    _cycles = cycles;
+    _instructions = instructions;
+    _halted = halted;
+    _nmi_pending = nmi_pending;
+    _irq_lines = irq_lines;
+    _stop_requested = FALSE;
+    if(_memory.debug != NULL){
+        /*A breakpoint at the loaded position stops again*/
+        _memory.debug->resume_cycles = UINT64_MAX;
+    }
+    return 0;
+}
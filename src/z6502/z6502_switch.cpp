@@ -0,0 +1,83 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Switch dispatch core. Every opcode has its own case with the addressing
+    mode resolved statically, so the compiler can inline the whole instruction
+    and keep the register set in host registers for the batch.
+*/
+
+#include "z6502.h"
+#include "z6502_private.h"
+
+/*One case per opcode, undefined opcodes fall to the unhandled path*/
+#define Z6502_CASE(n) \
+    case (n): \
+        if constexpr (instruction_id[(n)] == OP___){ \
+            goto unhandled; \
+        } \
+        if constexpr (TIMING::accurate){ \
+            spent += _execute_timed<(n), TIMING>(mem, &reg); \
+        } \
+        else{ \
+            _execute<(n)>(mem, &reg); \
+        } \
+        break;
+#define Z6502_CASE4(n) Z6502_CASE(n) Z6502_CASE((n) + 1) Z6502_CASE((n) + 2) Z6502_CASE((n) + 3)
+#define Z6502_CASE16(n) Z6502_CASE4(n) Z6502_CASE4((n) + 4) Z6502_CASE4((n) + 8) Z6502_CASE4((n) + 12)
+
+template<typename TIMING>
+uint64_t Z6502::_run_switch(uint64_t cycle_budget) {
+    /*Work on local copies for the whole batch*/
+    cpu_state_t reg = _reg;
+    memory_t* mem = &_memory;
+    uint64_t spent = 0U;
+    uint64_t executed = 0U;
+    uint8_t opcode;
+
+    while(spent < cycle_budget && _stop_requested == FALSE){
+        /*Read instruction*/
+        opcode = _mem_read(mem, reg.program_counter);
+        reg.program_counter++;
+
+        /*Execute instruction*/
+        switch(opcode){
+            Z6502_CASE16(0x00) Z6502_CASE16(0x10) Z6502_CASE16(0x20) Z6502_CASE16(0x30)
+            Z6502_CASE16(0x40) Z6502_CASE16(0x50) Z6502_CASE16(0x60) Z6502_CASE16(0x70)
+            Z6502_CASE16(0x80) Z6502_CASE16(0x90) Z6502_CASE16(0xA0) Z6502_CASE16(0xB0)
+            Z6502_CASE16(0xC0) Z6502_CASE16(0xD0) Z6502_CASE16(0xE0) Z6502_CASE16(0xF0)
+            default:
+            unhandled:
+                /*Unhandled opcode, stay on it*/
+                reg.program_counter--;
+                _halted = TRUE;
+                _reg = reg;
+                _cycles += spent;
+                _instructions += executed;
+                return spent;
+        }
+        if constexpr (!TIMING::accurate){
+            spent += instruction_cycles[opcode];
+        }
+        executed++;
+    }
+
+    _reg = reg;
+    _cycles += spent;
+    _instructions += executed;
+    return spent;
+}
+
+template uint64_t Z6502::_run_switch<timing_fast_t>(uint64_t cycle_budget);
+template uint64_t Z6502::_run_switch<timing_accurate_t>(uint64_t cycle_budget);
@@ -0,0 +1,396 @@
+/*
+     _____ ___ ___ ___ ___
+    |__   |  _|  _|   |_  |     Z6502 CPU Emulator
+    |   __| . |_  | | |  _|     Copyright (C) 2025 - Arnaud LE COSSEC
+    |_____|___|___|___|___|     version 1.0.0
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the MIT License.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    MIT License for more details.
+*/
+
+/*
+    Instruction trace. The file holds a 16 byte header then one record per
+    instruction, each coded against the previous one:
+
+    flags                   TRACE_* bits below
+    [pc]                    zigzag varint of pc - (previous pc + previous length)
+    [opcode operands]       instruction bytes, only when they differ from the
+                            ones last seen at this address
+    [cycles]                varint of the cycles the previous instruction took,
+                            only when not its base count
+    [a] [x] [y] [sp] [p]    registers that changed
+
+    A loop that already ran once costs one or two bytes per instruction.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include "z6502.h"
+#include "z6502_private.h"
+#include "z6502_trace.h"
+
+/*Record flags*/
+#define TRACE_JUMP 0x01U    /* Program counter does not follow the previous instruction */
+#define TRACE_CODE 0x02U    /* Instruction bytes follow */
+#define TRACE_CYCLES 0x04U  /* Cycles of the previous instruction follow */
+#define TRACE_A 0x08U
+#define TRACE_X 0x10U
+#define TRACE_Y 0x20U
+#define TRACE_SP 0x40U
+#define TRACE_P 0x80U
+
+/*Longest encoded record*/
+#define TRACE_MAX_RECORD_BYTES 24U
+
+/*Encoded bytes collected before each fwrite()*/
+#define TRACE_BUFFER_BYTES 262144U
+
+/*Writer poll period while the ring is empty*/
+#define TRACE_IDLE_MICROSECONDS 200
+
+//*****************************************************************************
+// Encoding
+//*****************************************************************************
+
+/**
+ * @brief Instruction bytes packed as in trace_codec_t::code
+ */
+static inline uint32_t _trace_code(const trace_record_t* record){
+    return 0x01000000U | record->opcode | (record->operand[0] << 8) | (record->operand[1] << 16);
+}
+
+/**
+ * @brief Encode a record
+ * @param codec Codec state, updated
+ * @param record Record
+ * @param out Output, at least TRACE_MAX_RECORD_BYTES long
+ * @returns End of the encoded record
+ */
+static uint8_t* _trace_encode(trace_codec_t* codec, const trace_record_t* record, uint8_t* out){
+    const trace_record_t* previous = &codec->previous;
+    uint8_t* flags = out++;
+    uint16_t expected = previous->program_counter + 1U + _operand_length(instruction_mode[previous->opcode]);
+    uint32_t code = _trace_code(record);
+    uint64_t value;
+
+    *flags = 0U;
+    if(record->program_counter != expected){
+        *flags |= TRACE_JUMP;
+        value = (uint16_t)(record->program_counter - expected);
+        value = (value & 0x8000U) ? ((~value & 0x7FFFU) << 1) | 1U : value << 1;
+        for(; value >= 0x80U; value >>= 7){
+            *out++ = (uint8_t)value | 0x80U;
+        }
+        *out++ = (uint8_t)value;
+    }
+    if(codec->code[record->program_counter] != code){
+        *flags |= TRACE_CODE;
+        codec->code[record->program_counter] = code;
+        *out++ = record->opcode;
+        for(unsigned int i = 0U; i < _operand_length(instruction_mode[record->opcode]); i++){
+            *out++ = record->operand[i];
+        }
+    }
+    value = record->cycles - previous->cycles;
+    if(value != (uint64_t)instruction_cycles[previous->opcode]){
+        *flags |= TRACE_CYCLES;
+        for(; value >= 0x80U; value >>= 7){
+            *out++ = (uint8_t)value | 0x80U;
+        }
+        *out++ = (uint8_t)value;
+    }
+    if(record->accumulator != previous->accumulator){
+        *flags |= TRACE_A;
+        *out++ = record->accumulator;
+    }
+    if(record->x != previous->x){
+        *flags |= TRACE_X;
+        *out++ = record->x;
+    }
+    if(record->y != previous->y){
+        *flags |= TRACE_Y;
+        *out++ = record->y;
+    }
+    if(record->stack_pointer != previous->stack_pointer){
+        *flags |= TRACE_SP;
+        *out++ = record->stack_pointer;
+    }
+    if(record->status != previous->status){
+        *flags |= TRACE_P;
+        *out++ = record->status;
+    }
+
+    codec->previous = *record;
+    return out;
+}
+
+//*****************************************************************************
+// Tracer
+//*****************************************************************************
+
+Z6502Tracer::Z6502Tracer(){
+    _ring = NULL;
+    _ring_mask = 0U;
+    _head = 0U;
+    _free_until = 0U;
+    _tail = 0U;
+    _closing = FALSE;
+    _file = NULL;
+    _codec = NULL;
+    _buffer = NULL;
+    _error = FALSE;
+}
+
+int Z6502Tracer::open(const char* filename, uint32_t ring_records){
+    uint8_t header[Z6502_TRACE_HEADER_BYTES] = {0};
+    uint64_t size = 1U;
+
+    if(_file != NULL){
+        return -1;
+    }
+    while(size < ring_records){
+        size <<= 1;
+    }
+
+    _ring = new (std::nothrow) trace_record_t[size];
+    _codec = (trace_codec_t*)calloc(1, sizeof(trace_codec_t));
+    _buffer = (uint8_t*)malloc(TRACE_BUFFER_BYTES);
+    _file = fopen(filename, "wb");
+    memcpy(header, Z6502_TRACE_MAGIC, sizeof(Z6502_TRACE_MAGIC) - 1U);
+    header[sizeof(Z6502_TRACE_MAGIC) - 1U] = Z6502_TRACE_VERSION;
+    if(_ring == NULL || _codec == NULL || _buffer == NULL || _file == NULL ||
+       fwrite(header, sizeof(header), 1, _file) != 1){
+        if(_file != NULL){
+            fclose(_file);
+            _file = NULL;
+        }
+        delete[] _ring;
+        free(_codec);
+        free(_buffer);
+        _ring = NULL;
+        _codec = NULL;
+        _buffer = NULL;
+        return -1;
+    }
+
+    _ring_mask = size - 1U;
+    _head = 0U;
+    _tail = 0U;
+    _free_until = size;
+    _closing = FALSE;
+    _error = FALSE;
+    _writer = std::thread(&Z6502Tracer::_write_loop, this);
+    return 0;
+}
+
+void Z6502Tracer::_write_loop(void){
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    uint64_t head;
+    uint8_t* out;
+
+    for(;;){
+        head = _head.load(std::memory_order_acquire);
+        if(tail == head){
+            /*The CPU no longer pushes once closing, a last look at head
+              catches what it pushed before*/
+            if(_closing.load(std::memory_order_acquire) == TRUE){
+                if(_head.load(std::memory_order_acquire) == tail){
+                    return;
+                }
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(TRACE_IDLE_MICROSECONDS));
+            continue;
+        }
+
+        out = _buffer;
+        while(tail != head && out <= &_buffer[TRACE_BUFFER_BYTES - TRACE_MAX_RECORD_BYTES]){
+            out = _trace_encode(_codec, &_ring[tail & _ring_mask], out);
+            tail++;
+        }
+        _tail.store(tail, std::memory_order_release);
+        if(_error == FALSE && fwrite(_buffer, sizeof(uint8_t), out - _buffer, _file) != (size_t)(out - _buffer)){
+            _error = TRUE;
+        }
+    }
+}
+
+int Z6502Tracer::close(void){
+    if(_file == NULL){
+        return 0;
+    }
+    _closing.store(TRUE, std::memory_order_release);
+    _writer.join();
+    if(fclose(_file) != 0){
+        _error = TRUE;
+    }
+    _file = NULL;
+    delete[] _ring;
+    free(_codec);
+    free(_buffer);
+    _ring = NULL;
+    _codec = NULL;
+    _buffer = NULL;
+    return (_error == TRUE) ? -1 : 0;
+}
+
+Z6502Tracer::~Z6502Tracer(){
+    close();
+}
+
+//*****************************************************************************
+// Decoding
+//*****************************************************************************
+
+trace_reader_t* trace_reader_open(const char* filename){
+    uint8_t header[Z6502_TRACE_HEADER_BYTES];
+    trace_reader_t* reader = (trace_reader_t*)calloc(1, sizeof(trace_reader_t));
+
+    if(reader == NULL){
+        return NULL;
+    }
+    reader->file = fopen(filename, "rb");
+    if(reader->file == NULL || fread(header, sizeof(header), 1, reader->file) != 1 ||
+       memcmp(header, Z6502_TRACE_MAGIC, sizeof(Z6502_TRACE_MAGIC) - 1U) != 0 ||
+       header[sizeof(Z6502_TRACE_MAGIC) - 1U] != Z6502_TRACE_VERSION){
+        trace_reader_close(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+/**
+ * @brief Read one byte of the trace
+ * @returns Byte, -1 at the end of the file
+ */
+static inline int _trace_byte(trace_reader_t* reader){
+    if(reader->position == reader->length){
+        reader->length = fread(reader->buffer, sizeof(uint8_t), sizeof(reader->buffer), reader->file);
+        reader->position = 0U;
+        if(reader->length == 0U){
+            return -1;
+        }
+    }
+    return reader->buffer[reader->position++];
+}
+
+/**
+ * @brief Read a varint of the trace
+ * @returns 0 on success, -1 if truncated or too long
+ */
+static int _trace_varint(trace_reader_t* reader, uint64_t* value){
+    int byte;
+
+    *value = 0U;
+    for(unsigned int shift = 0U; shift < 64U; shift += 7U){
+        byte = _trace_byte(reader);
+        if(byte < 0){
+            return -1;
+        }
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0){
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Read a register byte if its flag is set
+ * @returns 0 on success, -1 if truncated
+ */
+static inline int _trace_register(trace_reader_t* reader, uint8_t flags, uint8_t flag, uint8_t* value){
+    int byte;
+
+    if((flags & flag) == 0U){
+        return 0;
+    }
+    byte = _trace_byte(reader);
+    if(byte < 0){
+        return -1;
+    }
+    *value = byte;
+    return 0;
+}
+
+int trace_reader_next(trace_reader_t* reader, trace_record_t* record){
+    trace_codec_t* codec = &reader->codec;
+    const trace_record_t* previous = &codec->previous;
+    uint32_t code;
+    uint64_t value;
+    int flags;
+    int byte;
+
+    flags = _trace_byte(reader);
+    if(flags < 0){
+        return 0;
+    }
+
+    *record = *previous;
+    record->program_counter = previous->program_counter + 1U + _operand_length(instruction_mode[previous->opcode]);
+    if(flags & TRACE_JUMP){
+        if(_trace_varint(reader, &value) < 0 || value > 0xFFFFU){
+            return -1;
+        }
+        record->program_counter += (value & 1U) ? ~(value >> 1) : (value >> 1);
+    }
+
+    if(flags & TRACE_CODE){
+        code = 0x01000000U;
+        byte = _trace_byte(reader);
+        if(byte < 0){
+            return -1;
+        }
+        code |= byte;
+        for(unsigned int i = 0U; i < _operand_length(instruction_mode[byte]); i++){
+            int operand = _trace_byte(reader);
+            if(operand < 0){
+                return -1;
+            }
+            code |= operand << (8U * (i + 1U));
+        }
+        codec->code[record->program_counter] = code;
+    }
+    code = codec->code[record->program_counter];
+    if(code == 0U){
+        /*Instruction bytes never given for this address*/
+        return -1;
+    }
+    record->opcode = code & 0xFFU;
+    record->operand[0] = (code >> 8) & 0xFFU;
+    record->operand[1] = (code >> 16) & 0xFFU;
+
+    value = instruction_cycles[previous->opcode];
+    if((flags & TRACE_CYCLES) && _trace_varint(reader, &value) < 0){
+        return -1;
+    }
+    record->cycles = previous->cycles + value;
+
+    if(_trace_register(reader, flags, TRACE_A, &record->accumulator) < 0 ||
+       _trace_register(reader, flags, TRACE_X, &record->x) < 0 ||
+       _trace_register(reader, flags, TRACE_Y, &record->y) < 0 ||
+       _trace_register(reader, flags, TRACE_SP, &record->stack_pointer) < 0 ||
+       _trace_register(reader, flags, TRACE_P, &record->status) < 0){
+        return -1;
+    }
+
+    codec->previous = *record;
+    reader->count++;
+    return 1;
+}
+
+void trace_reader_close(trace_reader_t* reader){
+    if(reader == NULL){
+        return;
+    }
+    if(reader->file != NULL){
+        fclose(reader->file);
+    }
+    free(reader);
+}